@@ -0,0 +1,1084 @@
+//Name:			Budget Benchmarks
+//Description:	BudgetBench times the core operations on synthetic budgets and writes the results as JSON
+
+#include "Budget.h"
+
+//Benchmark mode times the core operations on a synthetic budget and writes the results as JSON, in the same
+//layout as Google Benchmark, so results can be compared between releases.
+const double BENCH_MIN_SECONDS = 0.2; //Each benchmark repeats until it has run at least this long
+const int BENCH_LAYOUT_SIZES[] = { 10, 10000, 1000000 }; //Categories in the budgets the two layouts are compared on
+const int BENCH_LOOKUP_CATEGORIES = 100000; //Categories in the budget IDs are looked up in
+const int BENCH_NAME_CATEGORIES = 100000; //Categories in the budget names are looked up in and displayed
+const int BENCH_RENDER_CATEGORIES = 1000000; //Categories in the budget each kind of report is rendered from
+const int BENCH_ALLOCATION_CATEGORIES = 10000; //Categories in the budget the allocations of each command are counted on
+const int BENCH_KERNEL_CATEGORIES = 100000; //Length of the columns the balance kernels are timed on
+const int BENCH_PARSE_ROWS[] = { 1000, 100000 }; //Rows in the saved text budgets that are parsed
+const int BENCH_LARGE_PARSE_ROWS = 10000000; //Rows in the largest text budget parsed, only with --large
+const int BENCH_FORMAT_CATEGORIES = 1000000; //Categories in the budget saved and loaded in each file format
+const int BENCH_SYNC_BATCH_SIZES[] = { 1, 16, 256, 4096 }; //Journal entries to each flush to disk while changes are timed
+const int BENCH_UPDATE_SIZES[] = { 100, 10000, 1000000 }; //Categories in the budgets single changes are timed on
+const int BENCH_TREE_CATEGORIES = 100000; //Categories in the wide and deep trees
+const int BENCH_TREE_DEPTH = 64; //Categories in each chain of the deep tree
+const long long BENCH_HISTORY_ENTRIES = 10000000; //Changes in the balance history that is queried
+const long long BENCH_LARGE_HISTORY_ENTRIES = 100000000; //Changes in the balance history with --large
+const int BENCH_HISTORY_CATEGORIES = 1000; //Categories the changes in the balance history are spread over
+const int BENCH_HISTORY_DAYS = 5 * 365; //Time the changes in the balance history are spread over
+const int BENCH_UNDO_CHANGES = 1000000; //Changes held in the undo history while undo is timed
+const int BENCH_SCHEDULES = 1000000; //Schedules advanced through while the schedules are timed
+const int BENCH_FORECAST_RUNS = 1024; //Runs in each forecast while the forecasts are timed
+const int BENCH_SOLVER_CATEGORIES = 50000; //Categories in the budget the percentage solver is timed on
+const int BENCH_SAVE_CATEGORIES = 1000000; //Categories in the budget saved after each change
+const long long BENCH_BATCH_OPERATIONS = 200000; //Commands in the file run through batch mode
+const long long BENCH_BATCH_SCALING_OPERATIONS = 1000000; //Commands in the file batch mode reads on more and more threads
+
+//The timing of one benchmark
+struct BenchmarkResult {
+	string name;
+	long long iterations;
+	double nanosecondsPerIteration;
+	double itemsPerIteration; //Categories handled by each iteration, for items_per_second
+	double allocationsPerIteration; //Only measured when BUDGET_COUNT_ALLOCATIONS is defined
+	vector<pair<string, double>> counters; //Other measurements, written out like Google Benchmark's user counters
+};
+
+//This function times an operation, repeating it until it has run for long enough to measure
+//The number of repeats doubles each round, the same way Google Benchmark picks its iterations
+//Parameters:	const string& name - The name of the benchmark
+//				double itemsPerIteration - The categories each call handles
+//				const function<void(long long)>& operation - The operation, given how many times it has run
+//Returns:		The timing
+BenchmarkResult static timeBenchmark(const string& name, double itemsPerIteration,
+	const function<void(long long)>& operation) {
+	long long iterations = 1;
+	long long done = 0;
+	while (true)
+	{
+		long long allocationsBefore = allocationCount();
+		auto start = chrono::steady_clock::now();
+		for (long long i = 0; i < iterations; i++)
+			operation(done + i);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		long long allocations = allocationCount() - allocationsBefore;
+		done += iterations;
+		if (seconds >= BENCH_MIN_SECONDS || iterations >= (1LL << 40))
+			return { name, iterations, seconds * 1e9 / iterations, itemsPerIteration,
+				(double)allocations / iterations, {} };
+		iterations *= seconds < BENCH_MIN_SECONDS / 10 ? 10 : 2;
+	}
+}
+
+//A category the way the budget stored it before the column store, every value of a category together with its
+//name, kept only to compare the two layouts
+struct InterleavedCategory {
+	string name;
+	double balance;
+	double budgetPercentage; //0-1
+	int idNumber;
+};
+
+//A stream buffer that throws away everything written to it, so reports can be timed without the screen or a file
+//It counts the bytes written, so the speed of a report can be given in bytes per second
+class DiscardBuffer : public streambuf {
+public:
+	long long written = 0;
+protected:
+	int_type overflow(int_type character) override {
+		written++;
+		return traits_type::not_eof(character);
+	}
+	streamsize xsputn(const char*, streamsize count) override {
+		written += count;
+		return count;
+	}
+};
+
+//This function times splitting a deposit and totalling the balances with the categories interleaved in one array
+//of objects, as they used to be, and with them in separate columns, at each of BENCH_LAYOUT_SIZES categories.
+//The interleaved and column runs do the same floating point arithmetic, so only the layout differs. The store's
+//own split, which also rounds every share to the cent, is timed at each size as well.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkLayouts(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	for (int size : BENCH_LAYOUT_SIZES)
+	{
+		SyntheticOptions options;
+		options.categoryCount = size;
+		options.nestedPercent = 0;
+		CategoryStore store;
+		generateSyntheticBudget(store, options, random);
+		vector<InterleavedCategory> interleaved(store.size());
+		vector<double> balances(store.size());
+		vector<double> percentages(store.size());
+		for (int i = 0; i < store.size(); i++)
+		{
+			interleaved[i] = { string(store.getName(i)), store.getBalance(i) / 100.0,
+				store.getPercentOfBudget(i) / (double)ONE_HUNDRED_PERCENT, store.getIDNumber(i) };
+			balances[i] = interleaved[i].balance;
+			percentages[i] = interleaved[i].budgetPercentage;
+		}
+		string suffix = "/" + to_string(size);
+
+		results.push_back(timeBenchmark("layout/modifyBalance/interleaved" + suffix, size, [&](long long i) {
+			double amount = i % 2 == 0 ? 1234.56 : -1234.56;
+			for (size_t j = 1; j < interleaved.size(); j++)
+				interleaved[j].balance += amount * interleaved[j].budgetPercentage;
+		}));
+		double interleavedTime = results.back().nanosecondsPerIteration;
+		results.push_back(timeBenchmark("layout/modifyBalance/columns" + suffix, size, [&](long long i) {
+			double amount = i % 2 == 0 ? 1234.56 : -1234.56;
+			for (size_t j = 1; j < balances.size(); j++)
+				balances[j] += amount * percentages[j];
+		}));
+		results.back().counters.emplace_back("speedup", interleavedTime / results.back().nanosecondsPerIteration);
+		results.push_back(timeBenchmark("layout/modifyBalance/store" + suffix, size, [&](long long i) {
+			modifyBalance(i % 2 == 0 ? 123456 : -123456, store);
+		}));
+
+		//Each total is stored somewhere volatile, so the sums cannot be left out
+		volatile double totalKept = 0;
+		results.push_back(timeBenchmark("layout/totalValue/interleaved" + suffix, size, [&](long long) {
+			double total = 0;
+			for (size_t j = 1; j < interleaved.size(); j++)
+				total += interleaved[j].balance;
+			totalKept = total;
+		}));
+		interleavedTime = results.back().nanosecondsPerIteration;
+		results.push_back(timeBenchmark("layout/totalValue/columns" + suffix, size, [&](long long) {
+			totalKept = (double)balanceKernels.sumMoney(store.balanceData() + 1, store.size() - 1);
+		}));
+		results.back().counters.emplace_back("speedup", interleavedTime / results.back().nanosecondsPerIteration);
+	}
+}
+
+//This function times a random mix of creating, removing and looking up categories by ID at BENCH_LOOKUP_CATEGORIES
+//categories, in the store and the way the budget used to do it: guessing that the ID is one more than the index,
+//scanning the array when it is not, and shifting every later category down to fill a removed one. Both run the
+//same operations, one in ten a create, one in ten a removal and the rest lookups. Creating and removing a
+//category at the end of the store and in the middle of it is timed as well.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkIDLookups(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	SyntheticOptions options;
+	options.categoryCount = BENCH_LOOKUP_CATEGORIES;
+	options.nestedPercent = 0;
+	CategoryStore store;
+	generateSyntheticBudget(store, options, random);
+	vector<InterleavedCategory> interleaved;
+	for (int i = 0; i < store.size(); i++)
+		interleaved.push_back({ string(store.getName(i)), store.getBalance(i) / 100.0,
+			store.getPercentOfBudget(i) / (double)ONE_HUNDRED_PERCENT, store.getIDNumber(i) });
+	int nextID = store.getNextIDNumber();
+	uint64_t seed = random.next();
+	string suffix = "/" + to_string(BENCH_LOOKUP_CATEGORIES);
+
+	//Returns the index of the ID in the array, or -1, the same way addToCategory used to find it
+	auto scanForID = [&](int id) {
+		if (id - 1 < (int)interleaved.size() && interleaved[id - 1].idNumber == id)
+			return id - 1;
+		for (int i = 0; i < (int)interleaved.size(); i++)
+			if (interleaved[i].idNumber == id)
+				return i;
+		return -1;
+	};
+	volatile int indexKept = 0;
+	SyntheticRandom scanRandom(seed);
+	results.push_back(timeBenchmark("idLookup/mix/scanAndShift" + suffix, 1, [&](long long i) {
+		int roll = (int)scanRandom.between(0, 9);
+		int id = interleaved[scanRandom.between(1, interleaved.size() - 1)].idNumber;
+		if (roll == 0)
+			interleaved.push_back({ "Mix" + to_string(i), 0, 0, ++nextID });
+		else if (roll == 1 && interleaved.size() > 2)
+			interleaved.erase(interleaved.begin() + scanForID(id));
+		else
+			indexKept = scanForID(id);
+	}));
+	double scanTime = results.back().nanosecondsPerIteration;
+	SyntheticRandom storeRandom(seed);
+	results.push_back(timeBenchmark("idLookup/mix/store" + suffix, 1, [&](long long i) {
+		int roll = (int)storeRandom.between(0, 9);
+		int id = pickSyntheticCategory(store, storeRandom);
+		if (roll == 0)
+			createCategory("Mix" + to_string(i), 0, store);
+		else if (roll == 1 && store.liveCount() > 2)
+			deleteCategory(id, store);
+		else
+			indexKept = store.indexOf(id);
+	}));
+	results.back().counters.emplace_back("speedup", scanTime / results.back().nanosecondsPerIteration);
+
+	//The store is kept in tree order, so a sub-category created under a category in the middle moves every
+	//category after its parent's branch up a slot. A category created under main only adds to the end.
+	CategoryStore tree;
+	generateSyntheticBudget(tree, options, random);
+	results.push_back(timeBenchmark("idLookup/createRemove/end" + suffix, 1, [&](long long i) {
+		deleteCategory(createCategory("End" + to_string(i), 0, tree), tree);
+	}));
+	results.push_back(timeBenchmark("idLookup/createRemove/middle" + suffix, 1, [&](long long i) {
+		deleteCategory(createCategory("Middle" + to_string(i), 0, tree, 0, pickSyntheticCategory(tree, random)), tree);
+	}));
+}
+
+//This function times finding categories by name and displaying every category at BENCH_NAME_CATEGORIES categories,
+//in the store and the way the budget used to do it. Names used to be found by comparing against each category in
+//turn, and the display copied each name and formatted its row with printf. Both displays are written to a stream
+//that throws the text away, so only the formatting is timed.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkNames(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	SyntheticOptions options;
+	options.categoryCount = BENCH_NAME_CATEGORIES;
+	options.nestedPercent = 0;
+	CategoryStore store;
+	generateSyntheticBudget(store, options, random);
+	vector<InterleavedCategory> interleaved;
+	for (int i = 0; i < store.size(); i++)
+		interleaved.push_back({ string(store.getName(i)), store.getBalance(i) / 100.0,
+			store.getPercentOfBudget(i) / (double)ONE_HUNDRED_PERCENT, store.getIDNumber(i) });
+	string suffix = "/" + to_string(BENCH_NAME_CATEGORIES);
+
+	volatile int indexKept = 0;
+	results.push_back(timeBenchmark("names/lookup/scan" + suffix, 1, [&](long long) {
+		string name = interleaved[random.between(1, interleaved.size() - 1)].name;
+		int found = -1;
+		for (int j = 0; j < (int)interleaved.size() && found == -1; j++)
+			if (interleaved[j].name == name)
+				found = j;
+		indexKept = found;
+	}));
+	double scanTime = results.back().nanosecondsPerIteration;
+	results.push_back(timeBenchmark("names/lookup/store" + suffix, 1, [&](long long) {
+		indexKept = store.indexOfName(store.getName((int)random.between(1, store.size() - 1)));
+	}));
+	results.back().counters.emplace_back("speedup", scanTime / results.back().nanosecondsPerIteration);
+
+	DiscardBuffer discard;
+	ostream output(&discard);
+	results.push_back(timeBenchmark("names/display/printf" + suffix, store.size(), [&](long long) {
+		char line[256];
+		int length = snprintf(line, sizeof(line), "%2s | %14s %14s %14s\n", "ID", "Category    |", "Balance    |",
+			"Percentage   |");
+		output.write(line, length);
+		for (const InterleavedCategory& category : interleaved) {
+			string name = category.name; //getName used to return a copy
+			length = snprintf(line, sizeof(line), "%-2d | %-12s | %-12.2f | %-12.2f |\n", category.idNumber,
+				name.data(), category.balance, category.budgetPercentage * 100);
+			output.write(line, length);
+		}
+	}));
+	double printfTime = results.back().nanosecondsPerIteration;
+	results.push_back(timeBenchmark("names/display/report" + suffix, store.size(), [&](long long) {
+		ReportWriter writer(output);
+		renderReport(store, ReportOptions(), writer);
+	}));
+	results.back().counters.emplace_back("speedup", printfTime / results.back().nanosecondsPerIteration);
+}
+
+//This function times rendering every kind of report from a budget of BENCH_RENDER_CATEGORIES nested categories,
+//along with a page of the table, the largest balances and only the negative balances. The reports are written to
+//a stream that throws the text away, and each result includes the megabytes rendered per second.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkRendering(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	SyntheticOptions options;
+	options.categoryCount = BENCH_RENDER_CATEGORIES;
+	CategoryStore store;
+	generateSyntheticBudget(store, options, random);
+	string suffix = "/" + to_string(BENCH_RENDER_CATEGORIES);
+	DiscardBuffer discard;
+	ostream output(&discard);
+
+	vector<pair<string, ReportOptions>> reports;
+	for (pair<const char*, ReportFormat> format : { make_pair("table", REPORT_TABLE), make_pair("save", REPORT_SAVE),
+		make_pair("idList", REPORT_ID_LIST), make_pair("percentList", REPORT_PERCENT_LIST),
+		make_pair("csv", REPORT_CSV), make_pair("json", REPORT_JSON) })
+	{
+		ReportOptions report;
+		report.format = format.second;
+		reports.push_back({ format.first, report });
+	}
+	ReportOptions page;
+	page.firstRow = BENCH_RENDER_CATEGORIES / 2;
+	page.rowLimit = 50;
+	reports.push_back({ "table:page", page });
+	ReportOptions top;
+	top.topCount = 100;
+	reports.push_back({ "table:top100", top });
+	ReportOptions negative;
+	negative.onlyNegative = true;
+	reports.push_back({ "table:negative", negative });
+
+	for (const pair<string, ReportOptions>& report : reports)
+	{
+		auto render = [&](long long) {
+			ReportWriter writer(output);
+			renderReport(store, report.second, writer);
+		};
+		discard.written = 0;
+		render(0);
+		double bytes = (double)discard.written;
+		results.push_back(timeBenchmark("render/" + report.first + suffix, store.size(), render));
+		results.back().counters.emplace_back("megabytes_per_second", bytes * 1e3 / results.back().nanosecondsPerIteration);
+	}
+}
+
+//This function times commands on a budget of BENCH_ALLOCATION_CATEGORIES categories in the store and the way the
+//budget used to run them, so that with BUDGET_COUNT_ALLOCATIONS the allocations of each can be compared. The old
+//way read each command into new strings, added a category by copying a temporary one into the array and removed
+//one by copying every later category down. The store copies names into its arena and takes the entries of its
+//indexes from a pool, where removed entries are reused. Deposits and additions are applied to the store both ways, so only the
+//handling of the command differs.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkAllocations(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	SyntheticOptions options;
+	options.categoryCount = BENCH_ALLOCATION_CATEGORIES;
+	options.nestedPercent = 0; //So removing a category never removes a branch
+	CategoryStore store;
+	generateSyntheticBudget(store, options, random);
+	vector<InterleavedCategory> interleaved;
+	for (int i = 0; i < store.size(); i++)
+		interleaved.push_back({ string(store.getName(i)), store.getBalance(i) / 100.0,
+			store.getPercentOfBudget(i) / (double)ONE_HUNDRED_PERCENT, store.getIDNumber(i) });
+	vector<string> commands;
+	for (int i = 0; i < 1000; i++)
+		if (i % 2 == 0)
+			commands.push_back("deposit " + to_string(random.between(1, 100000)) + ".25");
+		else
+			commands.push_back("add " + to_string(pickSyntheticCategory(store, random)) + " -1.50");
+	string suffix = "/" + to_string(BENCH_ALLOCATION_CATEGORIES);
+
+	results.push_back(timeBenchmark("allocations/command/strings" + suffix, 1, [&](long long i) {
+		string line = commands[i % commands.size()];
+		istringstream fields(line);
+		string command, first, second;
+		fields >> command >> first >> second;
+		if (command == "deposit")
+			modifyBalance(llround(stod(first) * 100), store);
+		else
+			applyToCategory(stoi(first), llround(stod(second) * 100), store);
+	}));
+	vector<string_view> fields;
+	results.push_back(timeBenchmark("allocations/command/views" + suffix, 1, [&](long long i) {
+		const string& line = commands[i % commands.size()];
+		splitBatchFields(line.data(), line.data() + line.size(), fields);
+		int id;
+		long long amount;
+		if (fields[0] == "deposit" && parseBatchHundredths(fields[1], amount))
+			modifyBalance(amount, store);
+		else if (parseBatchID(fields[1], id) && parseBatchHundredths(fields[2], amount))
+			applyToCategory(id, amount, store);
+	}));
+
+	//Each pass adds one category and removes another, so the budget stays the same size
+	int nextID = store.getNextIDNumber();
+	results.push_back(timeBenchmark("allocations/createRemove/interleaved" + suffix, 1, [&](long long i) {
+		InterleavedCategory added = { "Allocation category " + to_string(i), 0, 0, nextID++ };
+		interleaved.push_back(added);
+		for (size_t j = random.between(1, interleaved.size() - 1); j + 1 < interleaved.size(); j++)
+			interleaved[j] = interleaved[j + 1];
+		interleaved.pop_back();
+	}));
+	results.push_back(timeBenchmark("allocations/createRemove/store" + suffix, 1, [&](long long i) {
+		char name[40]; //The store copies the name, so it does not need a string of its own
+		createCategory(string_view(name, snprintf(name, sizeof(name), "Allocation category %lld", i)), 0, store);
+		deleteCategory(pickSyntheticCategory(store, random), store);
+	}));
+}
+
+//This function times each version of the balance kernels the CPU can run, over columns of
+//BENCH_KERNEL_CATEGORIES categories, with the speedup of each over the plain x86 version
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkKernels(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	vector<pair<string, BalanceKernels>> versions = { { "scalar", BalanceKernels() } };
+#ifdef BUDGET_X86_KERNELS
+	if (__builtin_cpu_supports("avx2"))
+		versions.push_back({ "avx2", { distributeSharesAVX2, sumMoneyAVX2, sumPercentAVX2 } });
+	if (__builtin_cpu_supports("avx512f"))
+		versions.push_back({ "avx512", { distributeSharesAVX512, sumMoneyAVX512, sumPercentAVX512 } });
+#endif
+	vector<Money> balances(BENCH_KERNEL_CATEGORIES);
+	vector<BasisPoints> percentages(BENCH_KERNEL_CATEGORIES);
+	vector<int> remainders(BENCH_KERNEL_CATEGORIES);
+	for (int i = 0; i < BENCH_KERNEL_CATEGORIES; i++)
+	{
+		balances[i] = random.between(0, 1000000);
+		percentages[i] = (BasisPoints)random.between(0, 2 * ONE_HUNDRED_PERCENT / BENCH_KERNEL_CATEGORIES);
+	}
+	string suffix = "/" + to_string(BENCH_KERNEL_CATEGORIES);
+	volatile long long totalKept = 0;
+	double scalarTimes[3] = {};
+	for (const pair<string, BalanceKernels>& version : versions)
+	{
+		const BalanceKernels& kernels = version.second;
+		//Deposits and withdrawals take turns, as in modifyBalance/flat
+		results.push_back(timeBenchmark("kernels/distributeShares/" + version.first + suffix, BENCH_KERNEL_CATEGORIES,
+			[&](long long i) {
+			kernels.distributeShares(balances.data(), percentages.data(), remainders.data(), BENCH_KERNEL_CATEGORIES,
+				12, 3456, i % 2 == 0 ? 1 : -1);
+		}));
+		results.push_back(timeBenchmark("kernels/sumMoney/" + version.first + suffix, BENCH_KERNEL_CATEGORIES,
+			[&](long long) {
+			totalKept = kernels.sumMoney(balances.data(), BENCH_KERNEL_CATEGORIES);
+		}));
+		results.push_back(timeBenchmark("kernels/sumPercent/" + version.first + suffix, BENCH_KERNEL_CATEGORIES,
+			[&](long long) {
+			totalKept = kernels.sumPercent(percentages.data(), BENCH_KERNEL_CATEGORIES);
+		}));
+		for (int kernel = 0; kernel < 3; kernel++)
+		{
+			BenchmarkResult& result = results[results.size() - 3 + kernel];
+			if (scalarTimes[kernel] == 0)
+				scalarTimes[kernel] = result.nanosecondsPerIteration;
+			result.counters.emplace_back("speedup", scalarTimes[kernel] / result.nanosecondsPerIteration);
+		}
+	}
+}
+
+//This function times parsing saved text budgets of each of BENCH_PARSE_ROWS rows, and of BENCH_LARGE_PARSE_ROWS
+//rows as well when large is set. Each file is read into memory first, so only the parsing is timed.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				const SyntheticOptions& options - The share of nested categories
+//				SyntheticRandom& random - The random numbers to use
+//				bool large - true to include the largest file
+void static benchmarkParser(vector<BenchmarkResult>& results, const SyntheticOptions& options,
+	SyntheticRandom& random, bool large) {
+	vector<int> sizes(begin(BENCH_PARSE_ROWS), end(BENCH_PARSE_ROWS));
+	if (large)
+		sizes.push_back(BENCH_LARGE_PARSE_ROWS);
+	string fileName = (filesystem::temp_directory_path() / "BudgetProgramParse").string();
+	for (int rows : sizes)
+	{
+		SyntheticOptions parseOptions = options;
+		parseOptions.categoryCount = rows;
+		vector<char> buffer;
+		{
+			CategoryStore categories;
+			generateSyntheticBudget(categories, parseOptions, random);
+			saveTextFile(fileName, categories);
+		}
+		readWholeFile(fileName, buffer);
+		CategoryStore loaded;
+		results.push_back(timeBenchmark("parse/text/" + to_string(rows), rows, [&](long long) {
+			parseTextBudget(buffer, fileName, loaded);
+		}));
+		results.back().counters.emplace_back("megabytes_per_second",
+			buffer.size() / 1e6 * 1e9 / results.back().nanosecondsPerIteration);
+	}
+	error_code removeError;
+	filesystem::remove(fileName, removeError);
+}
+
+//This function times saving and loading a budget of BENCH_FORMAT_CATEGORIES categories in each file format,
+//through a file in the temporary directory. Unlike load/text and load/snapshot, loading includes reading the
+//file. The snapshot timings include their speedup over the same step with the text format.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				const SyntheticOptions& options - The share of nested categories
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkFileFormats(vector<BenchmarkResult>& results, const SyntheticOptions& options,
+	SyntheticRandom& random) {
+	SyntheticOptions formatOptions = options;
+	formatOptions.categoryCount = BENCH_FORMAT_CATEGORIES;
+	CategoryStore categories;
+	generateSyntheticBudget(categories, formatOptions, random);
+	string fileName = (filesystem::temp_directory_path() / "BudgetProgramFormat").string();
+	string suffix = "/" + to_string(BENCH_FORMAT_CATEGORIES);
+	double count = categories.liveCount();
+	vector<char> buffer;
+	CategoryStore loaded;
+	double textSave = 0;
+	double textLoad = 0;
+	for (bool snapshot : { false, true })
+	{
+		string format = snapshot ? "snapshot" : "text";
+		results.push_back(timeBenchmark("fileFormat/save/" + format + suffix, count, [&](long long) {
+			saveBudgetFile(fileName, categories, snapshot);
+		}));
+		if (snapshot)
+			results.back().counters.emplace_back("speedup", textSave / results.back().nanosecondsPerIteration);
+		else
+			textSave = results.back().nanosecondsPerIteration;
+		results.push_back(timeBenchmark("fileFormat/load/" + format + suffix, count, [&](long long) {
+			readWholeFile(fileName, buffer);
+			if (snapshot)
+				parseSnapshot(buffer, fileName, loaded);
+			else
+				parseTextBudget(buffer, fileName, loaded);
+		}));
+		if (snapshot)
+			results.back().counters.emplace_back("speedup", textLoad / results.back().nanosecondsPerIteration);
+		else
+			textLoad = results.back().nanosecondsPerIteration;
+		results.back().counters.emplace_back("file_bytes", (double)filesystem::file_size(fileName));
+	}
+	error_code removeError;
+	filesystem::remove(fileName, removeError);
+}
+
+//This function times changes made to a budget with its journal open, at each of BENCH_SYNC_BATCH_SIZES changes
+//to a flush to disk. Each change adds to one category, and the journal is folded into the budget file whenever it
+//gets long, as the menu does, so the rate can be kept up for as long as changes keep coming.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				const SyntheticOptions& options - The size of the budget
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkJournal(vector<BenchmarkResult>& results, const SyntheticOptions& options,
+	SyntheticRandom& random) {
+	CategoryStore categories;
+	generateSyntheticBudget(categories, options, random);
+	string fileName = (filesystem::temp_directory_path() / "BudgetProgramJournal").string();
+	string suffix = "/" + to_string(options.categoryCount);
+	for (int batchSize : BENCH_SYNC_BATCH_SIZES)
+	{
+		Journal journal;
+		saveBudgetChanges(fileName, categories, journal, true);
+		journal.setSyncBatchSize(batchSize);
+		results.push_back(timeBenchmark("journal/syncEvery:" + to_string(batchSize) + suffix, 1, [&](long long i) {
+			int id = pickSyntheticCategory(categories, random);
+			applyToCategory(id, i % 2 == 0 ? 2500 : -2500, categories);
+			journal.recordAddToCategory(id, i % 2 == 0 ? 2500 : -2500);
+			if (journal.needsCompaction())
+				saveBudgetChanges(fileName, categories, journal, true);
+		}));
+		journal.close();
+	}
+	error_code removeError;
+	for (const char* extension : { "", ".journal", ".history" })
+		filesystem::remove(fileName + extension, removeError);
+}
+
+//This function times batch mode reading and applying a file of BENCH_BATCH_SCALING_OPERATIONS commands on one
+//thread, then on twice as many each time up to one per core, with the speedup over one thread. Each run starts
+//from the same budget, loaded from memory, and the journal is left closed, so the time is the reading, summing
+//and applying of the file. Most of the commands are adds, so the file is quick to make and large enough to be
+//cut into a chunk for every thread.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				const SyntheticOptions& options - The size of the budget
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkBatchScaling(vector<BenchmarkResult>& results, const SyntheticOptions& options,
+	SyntheticRandom& random) {
+	SyntheticOptions scalingOptions = options;
+	scalingOptions.operationCount = BENCH_BATCH_SCALING_OPERATIONS;
+	scalingOptions.depositWeight = 10;
+	scalingOptions.addWeight = 85;
+	scalingOptions.createWeight = 2;
+	scalingOptions.removeWeight = 2;
+	scalingOptions.percentWeight = 1;
+	CategoryStore budget;
+	generateSyntheticBudget(budget, scalingOptions, random);
+	string fileName = (filesystem::temp_directory_path() / "BudgetProgramScaling").string();
+	string commandsName = fileName + ".commands";
+	vector<char> budgetBuffer;
+	saveSnapshot(fileName, budget);
+	readWholeFile(fileName, budgetBuffer);
+	{
+		fstream commandsFile(commandsName, ios::out | ios::binary | ios::trunc);
+		writeSyntheticCommands(commandsFile, budget, scalingOptions, random);
+	}
+
+	string suffix = "/" + to_string(BENCH_BATCH_SCALING_OPERATIONS);
+	int cores = max(1, (int)thread::hardware_concurrency());
+	double singleThreadTime = 0;
+	for (int threads = 1; threads <= cores; threads = threads == cores || threads * 2 <= cores ? threads * 2 : cores)
+	{
+		ThreadPool pool(threads);
+		results.push_back(timeBenchmark("batch/threads:" + to_string(threads) + suffix,
+			(double)BENCH_BATCH_SCALING_OPERATIONS, [&](long long) {
+			CategoryStore categories;
+			Journal journal;
+			parseSnapshot(budgetBuffer, fileName, categories);
+			BatchApplier applier(categories, journal);
+			applyBatchFile(commandsName, pool, applier, categories);
+				}));
+		if (threads == 1)
+			singleThreadTime = results.back().nanosecondsPerIteration;
+		results.back().counters.emplace_back("speedup", singleThreadTime / results.back().nanosecondsPerIteration);
+	}
+	error_code removeError;
+	for (const string& name : { fileName, commandsName })
+		filesystem::remove(name, removeError);
+}
+
+//This function times adding to one category at each of BENCH_UPDATE_SIZES categories, keeping main's totals up
+//to date the way the store does, and the way the budget used to by recounting every balance after each change.
+//With running totals the time should stay the same at every size.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				const SyntheticOptions& options - The share of nested categories
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkUpdates(vector<BenchmarkResult>& results, const SyntheticOptions& options,
+	SyntheticRandom& random) {
+	for (int size : BENCH_UPDATE_SIZES)
+	{
+		SyntheticOptions updateOptions = options;
+		updateOptions.categoryCount = size;
+		CategoryStore categories;
+		generateSyntheticBudget(categories, updateOptions, random);
+		string suffix = "/" + to_string(size);
+		results.push_back(timeBenchmark("update/runningTotals" + suffix, 1, [&](long long i) {
+			applyToCategory(pickSyntheticCategory(categories, random), i % 2 == 0 ? 2500 : -2500, categories);
+		}));
+		double runningTime = results.back().nanosecondsPerIteration;
+		results.push_back(timeBenchmark("update/recount" + suffix, 1, [&](long long i) {
+			applyToCategory(pickSyntheticCategory(categories, random), i % 2 == 0 ? 2500 : -2500, categories);
+			categories.setBalance(0, balanceKernels.sumMoney(categories.balanceData() + 1, categories.size() - 1));
+		}));
+		results.back().counters.emplace_back("running_totals_speedup",
+			results.back().nanosecondsPerIteration / runningTime);
+	}
+}
+
+//This function times splitting a deposit down the tree and adding to one category in a wide tree, with every one
+//of BENCH_TREE_CATEGORIES categories directly under main, and in a deep one, made of chains BENCH_TREE_DEPTH
+//categories long. A split visits every category either way, while adding to a category updates the running
+//totals of each category above it, so it costs more the deeper the tree.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+void static benchmarkTreeShapes(vector<BenchmarkResult>& results, SyntheticRandom& random) {
+	for (int depth : { 1, BENCH_TREE_DEPTH })
+	{
+		CategoryStore categories;
+		categories.reserve(BENCH_TREE_CATEGORIES + 1);
+		categories.add("main", 0, ONE_HUNDRED_PERCENT);
+		int parentID = 1;
+		for (int i = 0; i < BENCH_TREE_CATEGORIES; i++)
+		{
+			if (i % depth == 0)
+				parentID = 1; //Start the next chain
+			parentID = createCategory("Category" + to_string(i + 1), random.between(0, 1000000), categories, 0,
+				parentID);
+		}
+		balanceSyntheticPercentages(categories, random);
+		string shape = depth == 1 ? "wide" : "deep:" + to_string(depth);
+		string suffix = "/" + to_string(BENCH_TREE_CATEGORIES);
+		results.push_back(timeBenchmark("tree/modifyBalance/" + shape + suffix, BENCH_TREE_CATEGORIES, [&](long long i) {
+			modifyBalance(i % 2 == 0 ? 123456 : -123456, categories);
+		}));
+		results.push_back(timeBenchmark("tree/addToCategory/" + shape + suffix, 1, [&](long long i) {
+			applyToCategory(pickSyntheticCategory(categories, random), i % 2 == 0 ? 2500 : -2500, categories);
+		}));
+	}
+}
+
+//This function times the balance history of BENCH_HISTORY_CATEGORIES categories, filled with BENCH_HISTORY_ENTRIES
+//changes, or BENCH_LARGE_HISTORY_ENTRIES when large is set, spread over BENCH_HISTORY_DAYS. Filling it is timed
+//as it happens, a change at a time. Then balances on random dates, and the money in and out of a random category
+//over a random month and over every month of a year as the menu shows them, are looked up.
+//Parameters:	vector<BenchmarkResult>& results - The timings are added to the end
+//				SyntheticRandom& random - The random numbers to use
+//				bool large - true to use the larger history
+void static benchmarkHistory(vector<BenchmarkResult>& results, SyntheticRandom& random, bool large) {
+	long long entries = large ? BENCH_LARGE_HISTORY_ENTRIES : BENCH_HISTORY_ENTRIES;
+	int64_t startTime = daysFromCivil(2020, 1, 1) * 86400;
+	int64_t span = (int64_t)BENCH_HISTORY_DAYS * 86400;
+	int64_t largestStep = max((int64_t)1, (int64_t)(2 * span / entries));
+	BalanceHistory history; //Never opened, so nothing is written to a file
+	string suffix = "/" + to_string(entries);
+
+	int64_t time = startTime;
+	auto fillStart = chrono::steady_clock::now();
+	for (long long i = 0; i < entries; i++)
+	{
+		time += random.between(0, largestStep);
+		history.recordAt((int)random.between(1, BENCH_HISTORY_CATEGORIES), time, random.between(-50000, 100000));
+	}
+	double fillSeconds = chrono::duration<double>(chrono::steady_clock::now() - fillStart).count();
+	results.push_back({ "history/record" + suffix, entries, fillSeconds * 1e9 / entries, 1, 0, {} });
+
+	volatile long long kept = 0;
+	results.push_back(timeBenchmark("history/balanceAt" + suffix, 1, [&](long long) {
+		kept = history.balanceAt((int)random.between(1, BENCH_HISTORY_CATEGORIES), startTime + random.between(0, span));
+	}));
+	results.push_back(timeBenchmark("history/monthFlows" + suffix, 1, [&](long long) {
+		int64_t from = startTime + random.between(0, span);
+		kept = history.flowsBetween((int)random.between(1, BENCH_HISTORY_CATEGORIES), from, from + 30 * 86400).inflow;
+	}));
+	results.push_back(timeBenchmark("history/yearByMonth" + suffix, 12, [&](long long) {
+		int id = (int)random.between(1, BENCH_HISTORY_CATEGORIES);
+		int year = 2020 + (int)random.between(0, BENCH_HISTORY_DAYS / 365 - 1);
+		for (int month = 1; month <= 12; month++)
+		{
+			int64_t from = daysFromCivil(year, month, 1) * 86400;
+			int64_t to = daysFromCivil(month == 12 ? year + 1 : year, month == 12 ? 1 : month + 1, 1) * 86400;
+			kept = history.flowsBetween(id, from, to).inflow;
+		}
+	}));
+}
+
+//This function runs benchmark mode, timing the core operations on synthetic budgets
+//Parameters:	const SyntheticOptions& options - The size of the budgets and the seed
+//				const string& outputName - The file to write the JSON results to, or - for the screen
+//				bool largeSizes - true to also time the largest sizes, which take minutes and gigabytes of memory
+//Returns:		0 if the results were written, otherwise 1
+int static runBenchmarks(const SyntheticOptions& options, const string& outputName, bool largeSizes) {
+	vector<BenchmarkResult> results;
+	SyntheticRandom random(options.seed);
+	SyntheticOptions flatOptions = options;
+	flatOptions.nestedPercent = 0;
+	CategoryStore flat;
+	CategoryStore nested;
+	generateSyntheticBudget(flat, flatOptions, random);
+	generateSyntheticBudget(nested, options, random);
+	double count = nested.liveCount();
+	string budgetSuffix = "/" + to_string(options.categoryCount);
+
+	//Deposits and withdrawals take turns, so the balances stay about the same however long it runs
+	results.push_back(timeBenchmark("modifyBalance/flat" + budgetSuffix, flat.liveCount(), [&](long long i) {
+		modifyBalance(i % 2 == 0 ? 123456 : -123456, flat);
+	}));
+	//The split balances used before they were kept in cents: each category's balance was a double, given the
+	//amount times its percentage as a fraction, with nothing rounded and nothing handed back out
+	vector<double> doubleBalances(flat.size());
+	vector<double> doublePercentages(flat.size());
+	for (int i = 1; i < flat.size(); i++)
+	{
+		doubleBalances[i] = flat.getBalance(i) / 100.0;
+		doublePercentages[i] = flat.isLive(i) ? flat.getPercentOfBudget(i) / (double)ONE_HUNDRED_PERCENT : 0;
+	}
+	results.push_back(timeBenchmark("modifyBalance/double" + budgetSuffix, flat.liveCount(), [&](long long i) {
+		double amount = i % 2 == 0 ? 1234.56 : -1234.56;
+		double total = 0;
+		for (int j = 1; j < (int)doubleBalances.size(); j++)
+		{
+			doubleBalances[j] += amount * doublePercentages[j];
+			total += doubleBalances[j];
+		}
+		doubleBalances[0] = total;
+	}));
+	results.push_back(timeBenchmark("modifyBalance/nested" + budgetSuffix, count, [&](long long i) {
+		modifyBalance(i % 2 == 0 ? 123456 : -123456, nested);
+	}));
+	results.push_back(timeBenchmark("addToCategory" + budgetSuffix, 1, [&](long long i) {
+		applyToCategory(pickSyntheticCategory(nested, random), i % 2 == 0 ? 2500 : -2500, nested);
+	}));
+	results.push_back(timeBenchmark("createAndRemoveCategory" + budgetSuffix, 1, [&](long long) {
+		deleteCategory(createCategory("BenchmarkCategory", 100, nested, 0,
+			pickSyntheticCategory(nested, random)), nested);
+	}));
+	//Two categories in one group swap percentages, then every group is checked, as option 4 does
+	results.push_back(timeBenchmark("setNewPercentages" + budgetSuffix, count, [&](long long) {
+		int first = nested.indexOf(pickSyntheticCategory(nested, random));
+		int parent = nested.getParentIndex(first);
+		int second = nested.branchEnd(first); //The next category in the group, or else the first one
+		if (second >= nested.branchEnd(parent))
+			second = parent + 1;
+		if (!nested.isLive(second))
+			second = first;
+		BasisPoints firstPercent = nested.getPercentOfBudget(first);
+		assignPercentage(nested.getIDNumber(first), nested.getPercentOfBudget(second), nested);
+		assignPercentage(nested.getIDNumber(second), firstPercent, nested);
+		if (findUnbalancedGroup(nested) == -1)
+			updateMainPercentage(nested);
+	}));
+
+	benchmarkLayouts(results, random);
+	benchmarkIDLookups(results, random);
+	benchmarkNames(results, random);
+	benchmarkRendering(results, random);
+	benchmarkAllocations(results, random);
+	benchmarkKernels(results, random);
+	benchmarkParser(results, options, random, largeSizes);
+	benchmarkFileFormats(results, options, random);
+	benchmarkJournal(results, options, random);
+	benchmarkBatchScaling(results, options, random);
+	benchmarkUpdates(results, options, random);
+	benchmarkTreeShapes(results, random);
+	benchmarkHistory(results, random, largeSizes);
+
+	//The undo history is filled with additions, the smallest change, then kept at that size while the newest
+	//changes are undone and redone. The journal is never opened, so nothing is written.
+	UndoHistory undo(numeric_limits<size_t>::max());
+	Journal closedJournal;
+	auto recordAddition = [&](Money amount) {
+		UndoRecord change;
+		change.type = UNDO_ADD_TO_CATEGORY;
+		change.id = pickSyntheticCategory(nested, random);
+		change.amount = amount;
+		applyToCategory(change.id, amount, nested);
+		undo.record(std::move(change));
+	};
+	for (int i = 0; i < BENCH_UNDO_CHANGES; i++)
+		recordAddition(i % 2 == 0 ? 2500 : -2500);
+	double bytesPerChange = (double)undo.getMemoryUsed() / undo.undoCount();
+	undo.setMemoryLimit(undo.getMemoryUsed()); //Each new change now pushes out the oldest
+	string historySuffix = "/" + to_string(BENCH_UNDO_CHANGES);
+	results.push_back(timeBenchmark("undo/record" + historySuffix, 1, [&](long long i) {
+		recordAddition(i % 2 == 0 ? 2500 : -2500);
+	}));
+	results.back().counters.emplace_back("bytes_per_change", bytesPerChange);
+	results.push_back(timeBenchmark("undo/undoAndRedo" + historySuffix, 1, [&](long long) {
+		undoChange(undo.nextUndo(), nested, closedJournal);
+		undo.undone();
+		redoChange(undo.nextRedo(), nested, closedJournal);
+		undo.redone();
+	}));
+	results.back().counters.emplace_back("history_bytes", (double)undo.getMemoryUsed());
+	//A removal is undone by filling its empty slots back in, so the time depends on the branch, not the budget
+	results.push_back(timeBenchmark("undo/removeAndRestore" + budgetSuffix, 1, [&](long long) {
+		UndoRecord change;
+		deleteCategoryForUndo(pickSyntheticCategory(nested, random), nested, change);
+		undoChange(change, nested, closedJournal);
+	}));
+
+	//A million schedules, a fifth of them deposits, due from daily to every few months, are advanced through a
+	//year at a time and then a day at a time. Each iteration reports the schedules that came due as its items.
+	ScheduleBook book(daysFromCivil(2030, 1, 1));
+	for (int i = 0; i < BENCH_SCHEDULES; i++)
+	{
+		Schedule schedule;
+		schedule.target = random.between(0, 4) == 0 ? 0 : pickSyntheticCategory(nested, random);
+		schedule.amount = (i % 2 == 0 ? 1 : -1) * (Money)random.between(100, 100000);
+		schedule.nextDay = book.getAppliedThrough() + random.between(1, 60);
+		int kind = (int)random.between(0, 99);
+		schedule.unit = kind < 70 ? SCHEDULE_MONTHS : SCHEDULE_DAYS;
+		schedule.every = kind < 1 ? 1 : kind < 11 ? 7 : kind < 70 ? 1 : (int)random.between(2, 90);
+		int year, month;
+		civilFromDays(schedule.nextDay, year, month, schedule.dayOfMonth);
+		book.add(schedule);
+	}
+	ScheduleSummary scheduleSummary;
+	long long lastEvents = 0;
+	auto advanceBook = [&](int days) {
+		long long before = scheduleSummary.deposits + scheduleSummary.additions + scheduleSummary.skipped;
+		book.advance(book.getAppliedThrough() + days, nested, closedJournal, scheduleSummary);
+		lastEvents = scheduleSummary.deposits + scheduleSummary.additions + scheduleSummary.skipped - before;
+	};
+	string scheduleSuffix = "/" + to_string(BENCH_SCHEDULES);
+	results.push_back(timeBenchmark("schedules/advanceYear" + scheduleSuffix, 0, [&](long long) {
+		advanceBook(365);
+	}));
+	results.back().itemsPerIteration = (double)lastEvents;
+	results.push_back(timeBenchmark("schedules/advanceDay" + scheduleSuffix, 0, [&](long long) {
+		advanceBook(1);
+	}));
+	results.back().itemsPerIteration = results[results.size() - 2].itemsPerIteration / 365; //Days differ, take the average
+
+	//A third of the categories of a larger budget are given rules that can always be met: amounts, minimums that
+	//leave room for the rest of the group and maximums of at least half. Then the whole budget is solved, and one
+	//category's amount or weight is changed at a time, the usual edit once a budget's rules are in place.
+	SyntheticOptions solverOptions = options;
+	solverOptions.categoryCount = BENCH_SOLVER_CATEGORIES;
+	CategoryStore ruled;
+	generateSyntheticBudget(ruled, solverOptions, random);
+	auto randomRule = [&](int index) {
+		CategoryRule rule;
+		int groupSize = ruled.getChildCount(ruled.getParentIndex(index));
+		int kind = (int)random.between(0, 5);
+		if (kind <= 2)
+		{
+			rule.hasAmount = true;
+			rule.monthlyAmount = random.between(0, 50000);
+			rule.priority = (int)random.between(0, 3);
+		}
+		else if (kind == 3)
+			rule.minPercent = (BasisPoints)random.between(0, ONE_HUNDRED_PERCENT / (2 * groupSize));
+		else if (kind == 4 && groupSize >= 2)
+			rule.maxPercent = (BasisPoints)random.between(ONE_HUNDRED_PERCENT / 2, ONE_HUNDRED_PERCENT);
+		else
+			rule.weight = (int)random.between(1, 5);
+		return rule;
+	};
+	PercentageSolver solver(ruled, 100000000);
+	for (int i = 1; i < ruled.size(); i++)
+		if (random.between(0, 2) == 0)
+			solver.setRule(i, randomRule(i));
+	string solverSuffix = "/" + to_string(BENCH_SOLVER_CATEGORIES);
+	results.push_back(timeBenchmark("solver/solveAll" + solverSuffix, ruled.liveCount(), [&](long long) {
+		solver.solveAll();
+	}));
+	results.push_back(timeBenchmark("solver/changeRule" + solverSuffix, 1, [&](long long) {
+		int index = ruled.indexOf(pickSyntheticCategory(ruled, random));
+		CategoryRule rule = solver.getRule(index);
+		if (rule.hasAmount)
+			rule.monthlyAmount = random.between(0, 50000);
+		else
+			rule.weight = (int)random.between(1, 5);
+		solver.changeRule(index, rule);
+	}));
+
+	//Forecasts of a year are run on one thread, then on twice as many each time up to one per core, to show how
+	//the simulations scale. Each iteration reports its runs as its items.
+	ForecastModel forecastModel(nested);
+	ForecastOptions forecastOptions;
+	forecastOptions.runs = BENCH_FORECAST_RUNS;
+	forecastOptions.income.kind = DISTRIBUTION_NORMAL;
+	forecastOptions.income.first = 500000;
+	forecastOptions.income.second = 150000;
+	forecastOptions.expenses.kind = DISTRIBUTION_UNIFORM;
+	forecastOptions.expenses.first = 200000;
+	forecastOptions.expenses.second = 700000;
+	ForecastResult forecastResult;
+	int cores = max(1, (int)thread::hardware_concurrency());
+	double singleThreadTime = 0;
+	for (int threads = 1; threads <= cores; threads = threads == cores || threads * 2 <= cores ? threads * 2 : cores)
+	{
+		ThreadPool pool(threads);
+		results.push_back(timeBenchmark("forecast/threads:" + to_string(threads) + budgetSuffix, forecastOptions.runs,
+			[&](long long i) {
+			forecastOptions.seed = i;
+			runForecastSimulations(forecastModel, forecastOptions, pool, forecastResult);
+		}));
+		if (threads == 1)
+			singleThreadTime = results.back().nanosecondsPerIteration;
+		results.back().counters.emplace_back("speedup", singleThreadTime / results.back().nanosecondsPerIteration);
+	}
+
+	//Saving and loading go through a file in the temporary directory
+	string fileName = (filesystem::temp_directory_path() / "BudgetProgramBenchmark").string();
+	vector<char> buffer;
+	CategoryStore loaded;
+	results.push_back(timeBenchmark("saveToFile/text" + budgetSuffix, count, [&](long long) {
+		saveTextFile(fileName, nested);
+	}));
+	readWholeFile(fileName, buffer);
+	results.push_back(timeBenchmark("load/text" + budgetSuffix, count, [&](long long) {
+		parseTextBudget(buffer, fileName, loaded);
+	}));
+	results.push_back(timeBenchmark("saveToFile/snapshot" + budgetSuffix, count, [&](long long) {
+		saveSnapshot(fileName, nested);
+	}));
+	readWholeFile(fileName, buffer);
+	results.push_back(timeBenchmark("load/snapshot" + budgetSuffix, count, [&](long long) {
+		parseSnapshot(buffer, fileName, loaded);
+	}));
+
+	//A larger budget is saved after every change, with its journal, the way the menu and server save it. Adding to
+	//one category only writes that category's row, while a deposit changes every balance and writes the whole file.
+	SyntheticOptions saveOptions = options;
+	saveOptions.categoryCount = BENCH_SAVE_CATEGORIES;
+	CategoryStore large;
+	generateSyntheticBudget(large, saveOptions, random);
+	Journal saveJournal;
+	saveBudgetChanges(fileName, large, saveJournal, true);
+	string saveSuffix = "/" + to_string(BENCH_SAVE_CATEGORIES);
+	results.push_back(timeBenchmark("save/oneCategory" + saveSuffix, 1, [&](long long i) {
+		int id = pickSyntheticCategory(large, random);
+		applyToCategory(id, i % 2 == 0 ? 2500 : -2500, large);
+		saveJournal.recordAddToCategory(id, i % 2 == 0 ? 2500 : -2500);
+		saveBudgetChanges(fileName, large, saveJournal, true);
+	}));
+	results.push_back(timeBenchmark("save/allCategories" + saveSuffix, large.liveCount(), [&](long long i) {
+		modifyBalance(i % 2 == 0 ? 123456 : -123456, large);
+		saveJournal.recordDeposit(i % 2 == 0 ? 123456 : -123456);
+		saveBudgetChanges(fileName, large, saveJournal, true);
+	}));
+	saveJournal.close();
+	error_code removeError;
+	for (const char* extension : { "", ".journal", ".history" })
+		filesystem::remove(fileName + extension, removeError);
+
+	//A file of commands is run through batch mode from start to end, loading the budget and saving it, once
+	//reading it whole and once through the pipeline. Each run starts from a copy of the same budget.
+	SyntheticOptions batchOptions = options;
+	batchOptions.operationCount = BENCH_BATCH_OPERATIONS;
+	CategoryStore batchBudget;
+	generateSyntheticBudget(batchBudget, batchOptions, random);
+	string originalName = fileName + ".original";
+	string commandsName = fileName + ".commands";
+	saveSnapshot(originalName, batchBudget);
+	{
+		fstream commandsFile(commandsName, ios::out | ios::binary | ios::trunc);
+		writeSyntheticCommands(commandsFile, batchBudget, batchOptions, random);
+	}
+	auto runBatchOnce = [&](bool pipelined) {
+		for (const char* extension : { ".journal", ".history" })
+			filesystem::remove(fileName + extension, removeError);
+		filesystem::copy_file(originalName, fileName, filesystem::copy_options::overwrite_existing, removeError);
+		CategoryStore categories;
+		Journal journal;
+		journal.setSyncBatchSize(BATCH_JOURNAL_GROUP);
+		openOrCreateBudget(fileName, categories, journal);
+		BatchApplier applier(categories, journal);
+		if (pipelined)
+		{
+			PipelineReport report;
+			runBatchPipeline(commandsName, applier, categories, journal, report);
+		}
+		else
+		{
+			ThreadPool pool(0);
+			applyBatchFile(commandsName, pool, applier, categories);
+		}
+			saveBudgetChanges(fileName, categories, journal, true);
+	};
+	string batchSuffix = "/" + to_string(BENCH_BATCH_OPERATIONS);
+	results.push_back(timeBenchmark("batch/sequential" + batchSuffix, (double)BENCH_BATCH_OPERATIONS, [&](long long) {
+		runBatchOnce(false);
+	}));
+	double sequentialTime = results.back().nanosecondsPerIteration;
+	results.push_back(timeBenchmark("batch/pipelined" + batchSuffix, (double)BENCH_BATCH_OPERATIONS, [&](long long) {
+		runBatchOnce(true);
+	}));
+	results.back().counters.emplace_back("speedup", sequentialTime / results.back().nanosecondsPerIteration);
+	for (const char* extension : { "", ".journal", ".history", ".original", ".commands" })
+		filesystem::remove(fileName + extension, removeError);
+
+	ostringstream json;
+	json << fixed << setprecision(3);
+	json << "{\n  \"context\": {\n"
+		<< "    \"num_cpus\": " << thread::hardware_concurrency() << ",\n"
+		<< "    \"categories\": " << options.categoryCount << ",\n"
+		<< "    \"nested_percent\": " << options.nestedPercent << ",\n"
+		<< "    \"seed\": " << options.seed << ",\n"
+		<< "    \"large\": " << (largeSizes ? "true" : "false") << ",\n"
+#ifdef BUDGET_COUNT_ALLOCATIONS
+		<< "    \"counting_allocations\": true\n"
+#else
+		<< "    \"counting_allocations\": false\n"
+#endif
+		<< "  },\n  \"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		json << (i == 0 ? "\n" : ",\n")
+			<< "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+			<< ", \"real_time\": " << result.nanosecondsPerIteration << ", \"time_unit\": \"ns\""
+			<< ", \"items_per_second\": " << result.itemsPerIteration * 1e9 / result.nanosecondsPerIteration;
+		for (const pair<string, double>& counter : result.counters)
+			json << ", \"" << counter.first << "\": " << counter.second;
+#ifdef BUDGET_COUNT_ALLOCATIONS
+		json << ", \"allocations_per_iteration\": " << result.allocationsPerIteration;
+#endif
+		json << "}";
+	}
+	json << "\n  ]\n}\n";
+
+	if (outputName == "-")
+	{
+		cout << json.str();
+		return 0;
+	}
+	ofstream file(outputName, ios::out | ios::trunc);
+	file << json.str();
+	if (!file)
+	{
+		cout << "Error: Could not write " << outputName << ".\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	//BudgetBench [--output <file>] [--large] [synthetic options] times the core operations, writing JSON
+	SyntheticOptions options;
+	string outputName = "-";
+	bool large = false;
+	for (int i = 1; i < argc; i++)
+	{
+		int read = readSyntheticOption(argc, argv, i, options);
+		if (read == -1)
+			return 1;
+		else if (read == 1)
+			continue;
+		string option = argv[i];
+		if (option == "--large")
+			large = true;
+		else if (option == "--output" && i + 1 < argc)
+			outputName = argv[++i];
+		else
+		{
+			cout << "Error: Expected BudgetBench [--output <file>] [--large] [synthetic options], not " << option
+				<< ".\n";
+			return 1;
+		}
+	}
+	return runBenchmarks(options, outputName, large);
+}
@@ -0,0 +1,3052 @@
+//Name:			Budget Library
+//Description:	The category store operations, file formats, journal, undo history, batch mode,
+//				schedules, percentage solver and forecasts
+
+#include "Budget.h"
+
+//Every allocation made through new, counted when BUDGET_COUNT_ALLOCATIONS is defined
+#ifdef BUDGET_COUNT_ALLOCATIONS
+atomic<long long> allocationCounter{ 0 };
+
+//These are kept out of line, otherwise GCC sees malloc and free paired with new and delete and warns of a mismatch
+#if defined(__GNUC__) || defined(__clang__)
+#define BUDGET_NOINLINE __attribute__((noinline))
+#else
+#define BUDGET_NOINLINE
+#endif
+
+BUDGET_NOINLINE void* operator new(size_t size) {
+	allocationCounter.fetch_add(1, memory_order_relaxed);
+	if (void* memory = malloc(size == 0 ? 1 : size))
+		return memory;
+	throw bad_alloc();
+}
+BUDGET_NOINLINE void operator delete(void* memory) noexcept {
+	free(memory);
+}
+BUDGET_NOINLINE void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+#endif
+
+//Returns the number of allocations made so far, or 0 if they are not being counted
+long long allocationCount() {
+#ifdef BUDGET_COUNT_ALLOCATIONS
+	return allocationCounter.load(memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+const char* const METRIC_NAMES[METRIC_COUNT] = { "load_text", "load_snapshot", "replay_journal", "save_text",
+	"save_snapshot", "journal_commit", "render_report", "modify_balance", "split_down_tree", "add_to_category",
+	"create_category", "remove_category", "check_percentages", "history_query", "batch_parse", "batch_apply",
+	"server_command" };
+#ifdef BUDGET_METRICS
+const int METRIC_SUB_BUCKET_BITS = 4;
+const int METRIC_SUB_BUCKETS = 1 << METRIC_SUB_BUCKET_BITS;
+const int METRIC_BUCKETS = (64 - METRIC_SUB_BUCKET_BITS + 1) * METRIC_SUB_BUCKETS;
+
+struct Metric {
+	atomic<long long> count{ 0 };
+	atomic<long long> totalNanoseconds{ 0 };
+	atomic<long long> maxNanoseconds{ 0 };
+	atomic<long long> allocations{ 0 };
+	atomic<long long> buckets[METRIC_BUCKETS] = {};
+};
+Metric metrics[METRIC_COUNT];
+
+//Returns the histogram bucket a time falls in
+int static metricBucket(uint64_t nanoseconds) {
+	if (nanoseconds < (uint64_t)METRIC_SUB_BUCKETS)
+		return (int)nanoseconds;
+	int highestBit = 63;
+	while ((nanoseconds >> highestBit) == 0)
+		highestBit--;
+	int shift = highestBit - METRIC_SUB_BUCKET_BITS;
+	return (shift + 1) * METRIC_SUB_BUCKETS + (int)((nanoseconds >> shift) & (METRIC_SUB_BUCKETS - 1));
+}
+
+//Returns the longest time that falls in a histogram bucket
+uint64_t static metricBucketLimit(int bucket) {
+	if (bucket < METRIC_SUB_BUCKETS)
+		return (uint64_t)bucket;
+	int shift = bucket / METRIC_SUB_BUCKETS - 1;
+	uint64_t sub = (uint64_t)(bucket % METRIC_SUB_BUCKETS);
+	return ((METRIC_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+//This function records one run of an operation
+//Parameters:	MetricID id - The operation
+//				long long nanoseconds - How long it took
+//				long long allocations - The allocations it made
+void recordMetric(MetricID id, long long nanoseconds, long long allocations) {
+	Metric& metric = metrics[id];
+	metric.count.fetch_add(1, memory_order_relaxed);
+	metric.totalNanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+	metric.allocations.fetch_add(allocations, memory_order_relaxed);
+	metric.buckets[metricBucket((uint64_t)nanoseconds)].fetch_add(1, memory_order_relaxed);
+	long long longest = metric.maxNanoseconds.load(memory_order_relaxed);
+	while (nanoseconds > longest && !metric.maxNanoseconds.compare_exchange_weak(longest, nanoseconds,
+		memory_order_relaxed))
+	{
+	}
+}
+
+//This function finds the time below which a share of the runs of an operation finished
+//Parameters:	const Metric& metric - The operation
+//				double quantile - The share of runs, from 0 to 1
+//Returns:		The longest time in the bucket the quantile falls in, in nanoseconds
+uint64_t static metricQuantile(const Metric& metric, double quantile) {
+	long long count = metric.count.load(memory_order_relaxed);
+	long long target = max(1LL, (long long)ceil(quantile * count));
+	long long seen = 0;
+	for (int bucket = 0; bucket < METRIC_BUCKETS; bucket++)
+	{
+		seen += metric.buckets[bucket].load(memory_order_relaxed);
+		if (seen >= target)
+			return metricBucketLimit(bucket);
+	}
+	return (uint64_t)metric.maxNanoseconds.load(memory_order_relaxed);
+}
+
+//This function writes every operation that has run, as Prometheus text or as JSON
+//Parameters:	bool json - true for JSON, false for the Prometheus text format
+//Returns:		The metrics
+string formatMetrics(bool json) {
+	ostringstream out;
+	if (json)
+	{
+		out << "{\"operations\": [";
+		bool first = true;
+		for (int id = 0; id < METRIC_COUNT; id++)
+		{
+			const Metric& metric = metrics[id];
+			long long count = metric.count.load(memory_order_relaxed);
+			if (count == 0)
+				continue;
+			out << (first ? "\n" : ",\n") << "  {\"name\": \"" << METRIC_NAMES[id] << "\", \"count\": " << count
+				<< ", \"total_ns\": " << metric.totalNanoseconds.load(memory_order_relaxed)
+				<< ", \"max_ns\": " << metric.maxNanoseconds.load(memory_order_relaxed)
+				<< ", \"p50_ns\": " << metricQuantile(metric, 0.5) << ", \"p90_ns\": " << metricQuantile(metric, 0.9)
+				<< ", \"p99_ns\": " << metricQuantile(metric, 0.99)
+				<< ", \"p999_ns\": " << metricQuantile(metric, 0.999)
+				<< ", \"allocations\": " << metric.allocations.load(memory_order_relaxed) << "}";
+			first = false;
+		}
+		out << "\n]}\n";
+		return out.str();
+	}
+
+	out << setprecision(12);
+	//Prometheus histograms have fixed bucket limits, so the fine buckets are added up into powers of four,
+	//from 1 microsecond to about 17 seconds
+	out << "# HELP budget_operation_seconds Time taken by each operation.\n"
+		<< "# TYPE budget_operation_seconds histogram\n";
+	for (int id = 0; id < METRIC_COUNT; id++)
+	{
+		const Metric& metric = metrics[id];
+		long long count = metric.count.load(memory_order_relaxed);
+		if (count == 0)
+			continue;
+		long long seen = 0;
+		int bucket = 0;
+		for (uint64_t limit = 1000; limit <= 20000000000ULL; limit *= 4)
+		{
+			for (; bucket < METRIC_BUCKETS && metricBucketLimit(bucket) <= limit; bucket++)
+				seen += metric.buckets[bucket].load(memory_order_relaxed);
+			out << "budget_operation_seconds_bucket{operation=\"" << METRIC_NAMES[id] << "\",le=\"" << limit / 1e9
+				<< "\"} " << seen << "\n";
+		}
+		out << "budget_operation_seconds_bucket{operation=\"" << METRIC_NAMES[id] << "\",le=\"+Inf\"} " << count << "\n"
+			<< "budget_operation_seconds_sum{operation=\"" << METRIC_NAMES[id] << "\"} "
+			<< metric.totalNanoseconds.load(memory_order_relaxed) / 1e9 << "\n"
+			<< "budget_operation_seconds_count{operation=\"" << METRIC_NAMES[id] << "\"} " << count << "\n";
+	}
+	out << "# HELP budget_operation_allocations_total Memory allocations made during each operation.\n"
+		<< "# TYPE budget_operation_allocations_total counter\n";
+	for (int id = 0; id < METRIC_COUNT; id++)
+		if (metrics[id].count.load(memory_order_relaxed) > 0)
+			out << "budget_operation_allocations_total{operation=\"" << METRIC_NAMES[id] << "\"} "
+				<< metrics[id].allocations.load(memory_order_relaxed) << "\n";
+	return out.str();
+}
+#else
+
+string formatMetrics(bool) {
+	return "";
+}
+#endif
+
+//This function writes the metrics to the file named by BUDGET_METRICS_FILE, if it is set, called at exit
+//The file is JSON if its name ends in .json, and Prometheus text otherwise
+void writeMetricsFile() {
+#ifdef BUDGET_METRICS
+	const char* fileName = getenv("BUDGET_METRICS_FILE");
+	if (fileName == nullptr || *fileName == '\0')
+		return;
+	string name = fileName;
+	bool json = name.size() >= 5 && name.compare(name.size() - 5, 5, ".json") == 0;
+	ofstream file(name, ios::out | ios::trunc);
+	file << formatMetrics(json);
+#endif
+}
+
+//This function computes the 64 bit FNV-1a hash of a block of bytes, used as the checksum of snapshots,
+//journal entries, and blocks of the balance history
+//Parameters:	const char* data - The bytes to hash
+//				size_t length - The number of bytes
+//Returns:		The hash
+uint64_t fnv1a(const char* data, size_t length) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//Each kernel body is inlined into a plain x86, an AVX2 and an AVX-512 version, see BalanceKernels
+#ifdef BUDGET_X86_KERNELS
+#define BUDGET_INLINE_KERNEL inline __attribute__((always_inline))
+#ifdef __clang__
+#define BUDGET_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BUDGET_TARGET(isa) __attribute__((target(isa), optimize("tree-vectorize"))) //Vectorize even at -O2
+#endif
+#else
+#define BUDGET_INLINE_KERNEL inline
+#endif
+
+//Adds each category's rounded-down share of an amount to its balance, and records what was left over
+//Splitting the amount into whole and part (amount = whole * 10000 + part) keeps every product that
+//needs dividing under 10000 * 10000, so it fits in 32 bits and the loop can be vectorized
+//Parameters:	Money* balances - The balance column to add the shares to
+//				const BasisPoints* percentages - The percentage column
+//				int* remainders - Receives the part of each share that was rounded off, out of 10000
+//				int count - The number of categories to process
+//				Money whole, int part - The size of the amount, split as described above
+//				Money sign - 1 to add the shares, -1 to subtract them
+BUDGET_INLINE_KERNEL void distributeSharesBody(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign) {
+	for (int i = 0; i < count; i++)
+	{
+		int partProduct = part * percentages[i];
+		int partShare = partProduct / ONE_HUNDRED_PERCENT;
+		remainders[i] = partProduct - partShare * ONE_HUNDRED_PERCENT;
+		balances[i] += sign * (whole * percentages[i] + partShare);
+	}
+}
+
+//Returns the sum of count values starting at column
+template <typename T>
+BUDGET_INLINE_KERNEL long long sumColumnBody(const T* column, int count) {
+	long long total = 0;
+	for (int i = 0; i < count; i++)
+		total += column[i];
+	return total;
+}
+
+void distributeSharesScalar(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign) {
+	distributeSharesBody(balances, percentages, remainders, count, whole, part, sign);
+}
+Money sumMoneyScalar(const Money* column, int count) {
+	return sumColumnBody(column, count);
+}
+long long sumPercentScalar(const BasisPoints* column, int count) {
+	return sumColumnBody(column, count);
+}
+
+#ifdef BUDGET_X86_KERNELS
+BUDGET_TARGET("avx2")
+void distributeSharesAVX2(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign) {
+	distributeSharesBody(balances, percentages, remainders, count, whole, part, sign);
+}
+BUDGET_TARGET("avx2")
+Money sumMoneyAVX2(const Money* column, int count) {
+	return sumColumnBody(column, count);
+}
+BUDGET_TARGET("avx2")
+long long sumPercentAVX2(const BasisPoints* column, int count) {
+	return sumColumnBody(column, count);
+}
+
+BUDGET_TARGET("avx512f")
+void distributeSharesAVX512(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign) {
+	distributeSharesBody(balances, percentages, remainders, count, whole, part, sign);
+}
+BUDGET_TARGET("avx512f")
+Money sumMoneyAVX512(const Money* column, int count) {
+	return sumColumnBody(column, count);
+}
+BUDGET_TARGET("avx512f")
+long long sumPercentAVX512(const BasisPoints* column, int count) {
+	return sumColumnBody(column, count);
+}
+#endif
+
+//This function checks which vector instructions the CPU supports and returns the fastest kernels it can run
+//Returns:	The set of balance kernels to use for the rest of the program
+BalanceKernels static selectKernels() {
+	BalanceKernels kernels;
+#ifdef BUDGET_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		kernels.distributeShares = distributeSharesAVX512;
+		kernels.sumMoney = sumMoneyAVX512;
+		kernels.sumPercent = sumPercentAVX512;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		kernels.distributeShares = distributeSharesAVX2;
+		kernels.sumMoney = sumMoneyAVX2;
+		kernels.sumPercent = sumPercentAVX2;
+	}
+#endif
+	return kernels;
+}
+
+const BalanceKernels balanceKernels = selectKernels();
+
+//This function divides an amount by 10000, rounding half away from zero
+//Parameters:	long long amount - The amount to divide
+//Returns:		The rounded result
+long long static roundedDivide(long long amount) {
+	if (amount < 0)
+		return -((-amount + ONE_HUNDRED_PERCENT / 2) / ONE_HUNDRED_PERCENT);
+	return (amount + ONE_HUNDRED_PERCENT / 2) / ONE_HUNDRED_PERCENT;
+}
+
+//This function writes a value kept in hundredths (cents or basis points) as a decimal with two places
+//Parameters:	char* out - Where to write, with room for at least REPORT_NUMBER_SIZE characters
+//				long long hundredths - The value to write
+//Returns:		One past the last character written
+char* writeHundredths(char* out, long long hundredths) {
+	unsigned long long magnitude = hundredths < 0 ? 0ULL - (unsigned long long)hundredths
+		: (unsigned long long)hundredths;
+	char* end = out + REPORT_NUMBER_SIZE - 3; //Room for the point and cents
+	if (hundredths < 0)
+		*out++ = '-';
+	out = to_chars(out, end, magnitude / 100).ptr;
+	*out++ = '.';
+	*out++ = (char)('0' + magnitude % 100 / 10);
+	*out++ = (char)('0' + magnitude % 10);
+	return out;
+}
+
+//This function formats a value kept in hundredths (cents or basis points) as a decimal with two places
+//I.E. 4520 becomes "45.20" and -5 becomes "-0.05"
+//Parameters:	long long hundredths - The value to format
+//Returns:		The formatted string
+string toDecimalString(long long hundredths) {
+	char digits[REPORT_NUMBER_SIZE];
+	return string(digits, writeHundredths(digits, hundredths));
+}
+
+//This function picks the rows of a report
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				const ReportOptions& options - Which categories to include
+//				int& matched - Receives the number of categories that passed the filters, before paging
+//Returns:		The indexes of the categories to include, in order
+vector<int> static selectReportRows(const CategoryStore& categories, const ReportOptions& options, int& matched) {
+	bool filtered = options.onlyNegative || options.topCount > 0;
+	vector<int> rows;
+	rows.reserve(options.onlyNegative ? categories.getNegativeCount() : categories.liveCount());
+	for (int i = filtered ? 1 : 0; i < categories.size(); i++)
+		if (categories.isLive(i) && (!options.onlyNegative || categories.getBalance(i) < 0))
+			rows.push_back(i);
+
+	if (options.topCount > 0)
+	{
+		//Only the top rows have to be put in order, ties go to the earlier category
+		auto largerBalance = [&categories](int a, int b) {
+			Money balanceA = categories.getBranchTotal(a);
+			Money balanceB = categories.getBranchTotal(b);
+			return balanceA != balanceB ? balanceA > balanceB : a < b;
+		};
+		size_t kept = min(rows.size(), (size_t)options.topCount);
+		partial_sort(rows.begin(), rows.begin() + kept, rows.end(), largerBalance);
+		rows.resize(kept);
+	}
+
+	matched = (int)rows.size();
+	size_t first = min(rows.size(), (size_t)max(0, options.firstRow));
+	size_t last = options.rowLimit > 0 ? min(rows.size(), first + (size_t)options.rowLimit) : rows.size();
+	rows.erase(rows.begin() + last, rows.end());
+	rows.erase(rows.begin(), rows.begin() + first);
+	return rows;
+}
+
+//This function formats a report of the categories
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				const ReportOptions& options - The format, and which categories to include
+//				ReportWriter& writer - Receives the report
+void renderReport(const CategoryStore& categories, const ReportOptions& options, ReportWriter& writer) {
+	METRIC_SCOPE(METRIC_RENDER_REPORT);
+	int matched;
+	vector<int> rows = selectReportRows(categories, options, matched);
+	bool treeOrder = !options.onlyNegative && options.topCount == 0; //Names are only indented in tree order
+
+	switch (options.format)
+	{
+	case REPORT_TABLE:
+		writer.text("ID |  Category    |   Balance    | Percentage   |\n");
+		break;
+	case REPORT_SAVE:
+		writer.text("ID | Category     |  Balance    | Percentage   | Parent |\n");
+		break;
+	case REPORT_ID_LIST:
+		writer.text("ID | Category      \n");
+		break;
+	case REPORT_CSV:
+		writer.text("ID,Name,Parent ID,Depth,Balance,Total Balance,Percentage\n");
+		break;
+	case REPORT_JSON:
+		writer.text("[");
+		break;
+	case REPORT_PERCENT_LIST:
+		break;
+	}
+
+	for (size_t row = 0; row < rows.size(); row++)
+	{
+		int i = rows[row];
+		int depth = categories.getDepth(i);
+		int indent = treeOrder && depth > 1 ? 2 * (depth - 1) : 0;
+		int parentIndex = categories.getParentIndex(i);
+		int parentID = parentIndex < 0 ? 0 : categories.getIDNumber(parentIndex);
+		Money total = i == 0 ? categories.getBalance(0) : categories.getBranchTotal(i);
+		switch (options.format)
+		{
+		case REPORT_TABLE:
+			writer.number(categories.getIDNumber(i), 2);
+			writer.text(" | ");
+			writer.padded(categories.getName(i), 12, false, indent);
+			writer.text(" | ");
+			writer.hundredths(total, 12);
+			writer.text(" | ");
+			writer.hundredths(categories.getPercentOfBudget(i), 12);
+			writer.text(" |\n");
+			break;
+		case REPORT_SAVE:
+			//A line break between rows but not after the final one, as that would be loaded as an empty row
+			if (row > 0)
+				writer.character('\n');
+			writer.number(categories.getIDNumber(i), 2);
+			writer.text(" | ");
+			writer.padded(categories.getName(i), 12);
+			writer.text(" | ");
+			writer.hundredths(categories.getBalance(i), 11);
+			writer.text(" | ");
+			writer.hundredths(categories.getPercentOfBudget(i), 13);
+			writer.text("| ");
+			writer.number(parentID, 6);
+			writer.text(" |");
+			break;
+		case REPORT_ID_LIST:
+			writer.number(categories.getIDNumber(i), 2, true);
+			writer.text(" | ");
+			writer.padded(categories.getName(i), 14, false, indent);
+			writer.character('\n');
+			break;
+		case REPORT_PERCENT_LIST:
+			writer.padded(categories.getName(i), 14, false, indent);
+			writer.text(" | ");
+			writer.tenths(categories.getPercentOfBudget(i), 4);
+			writer.text("%\n");
+			break;
+		case REPORT_CSV:
+			writer.number(categories.getIDNumber(i));
+			writer.character(',');
+			writer.csvField(categories.getName(i));
+			writer.character(',');
+			writer.number(parentID);
+			writer.character(',');
+			writer.number(depth);
+			writer.character(',');
+			writer.hundredths(categories.getBalance(i));
+			writer.character(',');
+			writer.hundredths(total);
+			writer.character(',');
+			writer.hundredths(categories.getPercentOfBudget(i));
+			writer.character('\n');
+			break;
+		case REPORT_JSON:
+			writer.text(row > 0 ? ",\n  {\"id\": " : "\n  {\"id\": ");
+			writer.number(categories.getIDNumber(i));
+			writer.text(", \"name\": ");
+			writer.jsonString(categories.getName(i));
+			writer.text(", \"parentID\": ");
+			writer.number(parentID);
+			writer.text(", \"depth\": ");
+			writer.number(depth);
+			writer.text(", \"balance\": ");
+			writer.hundredths(categories.getBalance(i));
+			writer.text(", \"totalBalance\": ");
+			writer.hundredths(total);
+			writer.text(", \"percentage\": ");
+			writer.hundredths(categories.getPercentOfBudget(i));
+			writer.character('}');
+			break;
+		}
+	}
+
+	if (options.format == REPORT_JSON)
+		writer.text("\n]\n");
+	if (options.format == REPORT_TABLE)
+	{
+		if (options.firstRow > 0 || options.rowLimit > 0)
+		{
+			writer.text("Rows ");
+			writer.number(rows.empty() ? 0 : options.firstRow + 1);
+			writer.text(" to ");
+			writer.number(options.firstRow + (long long)rows.size());
+			writer.text(" of ");
+			writer.number(matched);
+			writer.text(".\n");
+		}
+		if (categories.getNegativeCount() > 0)
+		{
+			writer.number(categories.getNegativeCount());
+			writer.text(" categories are overdrawn.\n");
+		}
+	}
+}
+
+//This function displays the budget categories to the screen in a readable format
+//Sub-categories are indented under their parent. A parent's balance includes its sub-categories, and each
+//percentage is of the parent's share
+//Parameters:	const CategoryStore& categories - The store that contains all of the budget categories
+//				to be output to the screen.
+void displayToScreen(const CategoryStore& categories) {
+	ReportWriter writer(cout);
+	renderReport(categories, ReportOptions(), writer);
+}
+
+//This function saves all of the categories to a file, in roughly the same format as displayToScreen
+//Ideally this function will be saved as a .txt file
+//Each row holds the category's own balance, not counting sub-categories, and the ID of its parent
+//Parameters:	fstream& file - A pointer that leads to the output file
+//				const CategoryStore& categories - The store of all budget categories to be saved
+void static saveToFile(fstream& file, const CategoryStore& categories) {
+	ReportOptions options;
+	options.format = REPORT_SAVE;
+	ReportWriter writer(file);
+	renderReport(categories, options, writer);
+}
+
+//This function moves a pointer past any spaces or tabs
+//Parameters:	const char* first - The start of the text
+//				const char* last - One past the end of the text
+//Returns:		The first character that is not a space, or last
+const char* skipSpaces(const char* first, const char* last) {
+	while (first < last && (*first == ' ' || *first == '\t'))
+		first++;
+	return first;
+}
+
+//This function finds the next field of a saved row, which ends at the next | character
+//Spaces around the field are trimmed, and the cursor is moved past the |
+//Parameters:	const char*& cursor - The current position in the row, moved past the field
+//				const char* lineEnd - One past the end of the row
+//				const char*& fieldStart, const char*& fieldEnd - Receive the trimmed field
+//Returns:		false if there is no | left in the row
+bool static nextField(const char*& cursor, const char* lineEnd, const char*& fieldStart, const char*& fieldEnd) {
+	const char* bar = (const char*)memchr(cursor, '|', lineEnd - cursor);
+	if (bar == nullptr)
+		return false;
+
+	fieldStart = skipSpaces(cursor, bar);
+	fieldEnd = bar;
+	while (fieldEnd > fieldStart && (fieldEnd[-1] == ' ' || fieldEnd[-1] == '\t'))
+		fieldEnd--;
+	cursor = bar + 1;
+	return true;
+}
+
+//This function reads a decimal number with up to two places (I.E. -45.20) as a whole number of hundredths
+//Any further decimal places are rounded off
+//Parameters:	const char* first - The start of the number
+//				const char* last - One past the end of the number
+//				long long& value - Receives the number of hundredths
+//Returns:		false if the text is not a valid number
+bool static parseHundredths(const char* first, const char* last, long long& value) {
+	bool negative = false;
+	if (first < last && *first == '-')
+	{
+		negative = true;
+		first++;
+	}
+
+	long long whole = 0;
+	long long fraction = 0;
+	bool anyDigits = false;
+	if (first < last && *first != '.')
+	{
+		from_chars_result result = from_chars(first, last, whole);
+		if (result.ec != errc())
+			return false;
+		first = result.ptr;
+		anyDigits = true;
+	}
+	if (first < last && *first == '.')
+	{
+		first++;
+		int places = 0;
+		while (first < last && isdigit((unsigned char)*first))
+		{
+			int digit = *first - '0';
+			if (places < 2)
+				fraction = fraction * 10 + digit;
+			else if (places == 2 && digit >= 5)
+				fraction++; //Round off the rest
+			places++;
+			anyDigits = true;
+			first++;
+		}
+		if (places == 1)
+			fraction *= 10;
+	}
+	if (!anyDigits || first != last)
+		return false;
+
+	value = whole * 100 + fraction;
+	if (negative)
+		value = -value;
+	return true;
+}
+
+//This function reads an entire file into memory in one block
+//Parameters:	const string& fileName - The name of the file to read
+//				vector<char>& buffer - Receives the contents of the file
+//Returns:		false if the file could not be opened, after outputting an error
+bool readWholeFile(const string& fileName, vector<char>& buffer) {
+	ifstream file(fileName, ios::in | ios::binary);
+	if (!file.is_open())
+	{
+		cout << "Error: Could not open " << fileName << ".\n";
+		return false;
+	}
+	file.seekg(0, ios::end);
+	buffer.resize((size_t)file.tellg());
+	file.seekg(0, ios::beg);
+	file.read(buffer.data(), buffer.size());
+	return true;
+}
+
+//This function loads a budget saved by saveToFile into the store
+//Each row is parsed in place, so no strings are built for the fields
+//The first line is the header and the second is main, which is re-created from the totals of the rest.
+//This prevents manual meddling with main.
+//Files saved before sub-categories existed have no Parent column, and every row is placed directly under main.
+//If a row cannot be read, an error with its line number is output and nothing is loaded
+//Parameters:	const vector<char>& buffer - The contents of the file
+//				const string& fileName - The name of the file, for error messages
+//				CategoryStore& categories - The store to load into, which is cleared first
+//Returns:		true if the file was loaded
+bool parseTextBudget(const vector<char>& buffer, const string& fileName, CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_LOAD_TEXT);
+	const char* cursor = buffer.data();
+	const char* fileEnd = cursor + buffer.size();
+
+	categories.clear();
+	categories.reserve((int)count(buffer.begin(), buffer.end(), '\n') + 1);
+	//Add main, which will not be imported and instead re-created
+	categories.addWithID(1, "main", 0, 0);
+
+	int lineNumber = 0;
+	while (cursor < fileEnd)
+	{
+		const char* lineEnd = (const char*)memchr(cursor, '\n', fileEnd - cursor);
+		if (lineEnd == nullptr)
+			lineEnd = fileEnd;
+		const char* rowEnd = lineEnd;
+		if (rowEnd > cursor && rowEnd[-1] == '\r')
+			rowEnd--; //Files edited on Windows
+		const char* row = cursor;
+		cursor = lineEnd + 1;
+		lineNumber++;
+
+		//Skip the header, main, and any blank lines
+		if (lineNumber <= 2 || skipSpaces(row, rowEnd) == rowEnd)
+			continue;
+
+		const char* fieldStart;
+		const char* fieldEnd;
+		int id = 0;
+		Money balance = 0;
+		long long percentage = 0;
+		const char* error = nullptr;
+
+		//ID
+		if (!nextField(row, rowEnd, fieldStart, fieldEnd))
+			error = "missing ID";
+		else if (from_chars(fieldStart, fieldEnd, id).ptr != fieldEnd || fieldStart == fieldEnd || id <= 1)
+			error = "invalid ID";
+		else if (categories.indexOf(id) != -1)
+			error = "duplicate ID";
+		//name, which ends at the first space as spaces are not allowed in names
+		else if (!nextField(row, rowEnd, fieldStart, fieldEnd) || fieldStart == fieldEnd)
+			error = "missing category name";
+		if (error == nullptr)
+		{
+			const char* nameStart = fieldStart;
+			const char* nameEnd = nameStart;
+			while (nameEnd < fieldEnd && *nameEnd != ' ')
+				nameEnd++;
+
+			//balance
+			if (!nextField(row, rowEnd, fieldStart, fieldEnd) || !parseHundredths(fieldStart, fieldEnd, balance))
+				error = "invalid balance";
+			//budgetPercentage, already in hundredths of a percent which is basis points
+			else if (!nextField(row, rowEnd, fieldStart, fieldEnd)
+				|| !parseHundredths(fieldStart, fieldEnd, percentage)
+				|| percentage < 0 || percentage > ONE_HUNDRED_PERCENT)
+				error = "invalid percentage";
+			//parent, which must already be loaded
+			else
+			{
+				int parentID = 1;
+				if (nextField(row, rowEnd, fieldStart, fieldEnd) && fieldStart != fieldEnd
+					&& (from_chars(fieldStart, fieldEnd, parentID).ptr != fieldEnd || categories.indexOf(parentID) == -1))
+					error = "invalid parent ID";
+				else if (categories.addWithID(id, string_view(nameStart, nameEnd - nameStart), balance,
+					(BasisPoints)percentage, categories.indexOf(parentID)) == -1)
+					error = "duplicate category name";
+			}
+		}
+
+		if (error != nullptr)
+		{
+			cout << "Error: " << fileName << " line " << lineNumber << ": " << error << ".\n";
+			categories.clear();
+			return false;
+		}
+	}
+
+	categories.setBalance(0, categories.getCategoryTotal()); //Assign the total balance
+	categories.setPercentOfBudget(0, (BasisPoints)categories.getPercentTotal()); //Assign the total percentage
+	return true;
+}
+
+//The binary snapshot is an alternative to the text format that can be saved and loaded without any formatting
+//or parsing. After the header come the columns, each stored whole: every balance, then every percentage,
+//then every ID, then every parent ID, then the offset of each name in the string table (plus one for the end),
+//then the string table. Version 1 snapshots have no parent IDs, as every category was directly under main.
+//Main is saved like any other category. Numbers are stored in the byte order of the machine that saved them.
+//Every balance and percentage is a fixed size at a fixed place, so from version 3 the values of a few categories
+//can be written over in place. Their checksum is kept apart from the checksum of the rest, as a sum over the
+//rows that can be updated for just the rows written.
+const char SNAPSHOT_MAGIC[8] = { 'B', 'U', 'D', 'G', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 3;
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t categoryCount;
+	int64_t nextIDNumber;
+	uint64_t stringTableSize;
+	uint64_t checksum; //FNV-1a of everything after the header, from version 3 everything after the percentages
+	uint64_t valuesChecksum; //Only in version 3, the sum of snapshotRowHash over every row
+};
+
+//Returns the size of the header of a snapshot version, earlier versions end before valuesChecksum
+size_t static snapshotHeaderSize(uint32_t version) {
+	return version >= 3 ? sizeof(SnapshotHeader) : offsetof(SnapshotHeader, valuesChecksum);
+}
+
+//This function mixes the balance and percentage of a row of a snapshot into a hash, summed for valuesChecksum
+//The row is mixed in too, so two rows swapping values still changes the sum
+//Parameters:	uint32_t row - The row in the snapshot
+//				Money balance, BasisPoints percentage - The values stored in the row
+//Returns:		The hash of the row
+uint64_t static snapshotRowHash(uint32_t row, Money balance, BasisPoints percentage) {
+	uint64_t hash = ((uint64_t)row << 32 | (uint32_t)percentage) * 0x9E3779B97F4A7C15ULL ^ (uint64_t)balance;
+	hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+	return hash ^ (hash >> 31);
+}
+
+//This function checks if a file's contents start with the snapshot magic
+//Parameters:	const vector<char>& buffer - The contents of the file
+//Returns:		true if the contents are a binary snapshot
+bool static isSnapshot(const vector<char>& buffer) {
+	return buffer.size() >= sizeof(SNAPSHOT_MAGIC) && memcmp(buffer.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+}
+
+//This function saves every category as a binary snapshot, built in memory and written with a single write
+//Parameters:	const string& fileName - The name of the file to save to, which is overwritten
+//				const CategoryStore& categories - The store of categories to be saved
+//Returns:		false if the file could not be written, after outputting an error
+bool saveSnapshot(const string& fileName, const CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_SAVE_SNAPSHOT);
+	uint32_t count = (uint32_t)categories.liveCount();
+	uint64_t stringTableSize = 0;
+	for (int i = 0; i < categories.size(); i++)
+		stringTableSize += categories.getName(i).length();
+
+	size_t balancesAt = sizeof(SnapshotHeader);
+	size_t percentagesAt = balancesAt + count * sizeof(Money);
+	uint64_t valuesChecksum = 0;
+	size_t idsAt = percentagesAt + count * sizeof(BasisPoints);
+	size_t parentsAt = idsAt + count * sizeof(int32_t);
+	size_t offsetsAt = parentsAt + count * sizeof(int32_t);
+	size_t stringsAt = offsetsAt + (count + 1) * sizeof(uint32_t);
+	vector<char> buffer(stringsAt + stringTableSize);
+
+	//Copy each live category into the columns, skipping empty slots
+	uint32_t row = 0;
+	uint32_t nameOffset = 0;
+	for (int i = 0; i < categories.size(); i++)
+	{
+		if (!categories.isLive(i))
+			continue;
+		Money balance = categories.getBalance(i);
+		BasisPoints percentage = categories.getPercentOfBudget(i);
+		int32_t id = categories.getIDNumber(i);
+		int32_t parentID = i == 0 ? 0 : categories.getIDNumber(categories.getParentIndex(i));
+		string_view name = categories.getName(i);
+		memcpy(&buffer[balancesAt + row * sizeof(Money)], &balance, sizeof(Money));
+		memcpy(&buffer[percentagesAt + row * sizeof(BasisPoints)], &percentage, sizeof(BasisPoints));
+		valuesChecksum += snapshotRowHash(row, balance, percentage);
+		memcpy(&buffer[idsAt + row * sizeof(int32_t)], &id, sizeof(int32_t));
+		memcpy(&buffer[parentsAt + row * sizeof(int32_t)], &parentID, sizeof(int32_t));
+		memcpy(&buffer[offsetsAt + row * sizeof(uint32_t)], &nameOffset, sizeof(uint32_t));
+		memcpy(&buffer[stringsAt + nameOffset], name.data(), name.length());
+		nameOffset += (uint32_t)name.length();
+		row++;
+	}
+	memcpy(&buffer[offsetsAt + row * sizeof(uint32_t)], &nameOffset, sizeof(uint32_t));
+
+	SnapshotHeader header;
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version = SNAPSHOT_VERSION;
+	header.categoryCount = count;
+	header.nextIDNumber = categories.getNextIDNumber();
+	header.stringTableSize = stringTableSize;
+	header.checksum = fnv1a(buffer.data() + idsAt, buffer.size() - idsAt);
+	header.valuesChecksum = valuesChecksum;
+	memcpy(buffer.data(), &header, sizeof(SnapshotHeader));
+
+	ofstream file(fileName, ios::out | ios::binary | ios::trunc);
+	file.write(buffer.data(), buffer.size());
+	if (!file)
+	{
+		cout << "Error: Could not write " << fileName << ".\n";
+		return false;
+	}
+	return true;
+}
+
+//This function loads a binary snapshot saved by saveSnapshot into the store
+//The columns are copied straight out of the file contents into the store
+//Parameters:	const vector<char>& buffer - The contents of the file
+//				const string& fileName - The name of the file, for error messages
+//				CategoryStore& categories - The store to load into
+//				bool* valuesDamaged - If given, balances and percentages that fail their checksum are loaded anyway
+//				and this is set to true, for a caller that can put them right from the journal
+//Returns:		false if the snapshot is damaged or from a newer version, after outputting an error
+bool parseSnapshot(const vector<char>& buffer, const string& fileName, CategoryStore& categories,
+	bool* valuesDamaged) {
+	METRIC_SCOPE(METRIC_LOAD_SNAPSHOT);
+	SnapshotHeader header;
+	size_t headerSize = 0;
+	const char* error = nullptr;
+	bool hasParents = false;
+	if (buffer.size() < snapshotHeaderSize(1))
+		error = "file is too short";
+	else
+	{
+		memcpy(&header, buffer.data(), snapshotHeaderSize(1));
+		headerSize = snapshotHeaderSize(header.version);
+		hasParents = header.version >= 2;
+		size_t rowSize = sizeof(Money) + sizeof(BasisPoints) + sizeof(int32_t) + sizeof(uint32_t)
+			+ (hasParents ? sizeof(int32_t) : 0);
+		size_t checkedFrom = header.version >= 3
+			? headerSize + (size_t)header.categoryCount * (sizeof(Money) + sizeof(BasisPoints)) : headerSize;
+		if (header.version < 1 || header.version > SNAPSHOT_VERSION)
+			error = "unsupported snapshot version";
+		else if (header.categoryCount < 1 || buffer.size() != headerSize
+			+ (uint64_t)header.categoryCount * rowSize + sizeof(uint32_t) + header.stringTableSize)
+			error = "file size does not match its header";
+		else if (fnv1a(buffer.data() + checkedFrom, buffer.size() - checkedFrom) != header.checksum)
+			error = "checksum does not match, the file is damaged";
+		else
+			memcpy(&header, buffer.data(), headerSize);
+	}
+	if (error != nullptr)
+	{
+		cout << "Error: " << fileName << ": " << error << ".\n";
+		return false;
+	}
+
+	int count = (int)header.categoryCount;
+	vector<Money> balances(count);
+	vector<BasisPoints> percentages(count);
+	vector<int32_t> ids(count);
+	vector<int32_t> parentIDs(count, 1); //Everything is under main in a version 1 snapshot
+	vector<uint32_t> offsets(count + 1);
+	const char* column = buffer.data() + headerSize;
+	memcpy(balances.data(), column, count * sizeof(Money));
+	column += count * sizeof(Money);
+	memcpy(percentages.data(), column, count * sizeof(BasisPoints));
+	column += count * sizeof(BasisPoints);
+	bool damaged = false;
+	if (header.version >= 3)
+	{
+		uint64_t valuesChecksum = 0;
+		for (int i = 0; i < count; i++)
+			valuesChecksum += snapshotRowHash((uint32_t)i, balances[i], percentages[i]);
+		damaged = valuesChecksum != header.valuesChecksum;
+		if (damaged && valuesDamaged == nullptr)
+		{
+			cout << "Error: " << fileName << ": checksum does not match, the file is damaged.\n";
+			return false;
+		}
+	}
+	memcpy(ids.data(), column, count * sizeof(int32_t));
+	column += count * sizeof(int32_t);
+	if (hasParents)
+	{
+		memcpy(parentIDs.data(), column, count * sizeof(int32_t));
+		column += count * sizeof(int32_t);
+	}
+	memcpy(offsets.data(), column, (count + 1) * sizeof(uint32_t));
+	column += (count + 1) * sizeof(uint32_t);
+
+	//The names are left in the buffer until the store copies them
+	vector<string_view> names(count);
+	for (int i = 0; i < count; i++)
+	{
+		if (offsets[i] > offsets[i + 1] || offsets[i + 1] > header.stringTableSize)
+		{
+			cout << "Error: " << fileName << ": name table is damaged.\n";
+			return false;
+		}
+		names[i] = string_view(column + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+	if (!categories.assignColumns(balances.data(), percentages.data(), ids.data(), parentIDs.data(),
+		names.data(), count))
+	{
+		cout << "Error: " << fileName << ": categories are out of order under their parents or share a name.\n";
+		return false;
+	}
+	categories.setNextIDNumber((int)header.nextIDNumber);
+	//Only a version 3 snapshot with sound values can have the values of a few categories written over in place
+	if (header.version >= 3 && !damaged)
+		categories.markSaved(true);
+	if (valuesDamaged != nullptr)
+		*valuesDamaged = damaged;
+	return true;
+}
+
+//This function saves the store to a file as text, the same format saveToFile writes
+//Parameters:	const string& fileName - The name of the file to save to, which is overwritten
+//				const CategoryStore& categories - The store of categories to be saved
+//Returns:		false if the file could not be written, after outputting an error
+bool saveTextFile(const string& fileName, const CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_SAVE_TEXT);
+	fstream file(fileName, ios::out); //Deletes any old data then writes to file
+	saveToFile(file, categories);
+	if (!file)
+	{
+		cout << "Error: Could not write " << fileName << ".\n";
+		return false;
+	}
+	return true;
+}
+
+//This function converts a budget file between the text format and a binary snapshot
+//A text file becomes a snapshot and a snapshot becomes a text file
+//Parameters:	const string& inputName - The file to convert
+//				const string& outputName - The file to write, which is overwritten
+//Returns:		true if the file was converted
+bool convertBudgetFile(const string& inputName, const string& outputName) {
+	CategoryStore categories;
+	vector<char> buffer;
+	if (!readWholeFile(inputName, buffer))
+		return false;
+	if (isSnapshot(buffer))
+		return parseSnapshot(buffer, inputName, categories) && saveTextFile(outputName, categories);
+	return parseTextBudget(buffer, inputName, categories) && saveSnapshot(outputName, categories);
+}
+//Building with BUDGET_VERIFY_TOTALS defined checks the running totals of the store against a full recount after
+//every change, stopping the program at the first one that does not match. Without it the checks compile away.
+#ifdef BUDGET_VERIFY_TOTALS
+//This function recounts the totals of the store with the balance kernels and compares them to the running totals
+//The total below each category is recounted as a sum over the range of slots its branch fills
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				const char* caller - The function that made the change, for the error message
+void static verifyTotals(const CategoryStore& categories, const char* caller) {
+	int count = categories.size() - 1;
+	Money balanceTotal = balanceKernels.sumMoney(categories.balanceData() + 1, count);
+	int negatives = 0;
+	int nested = 0;
+	int badBranch = -1;
+	vector<long long> childPercents(categories.size());
+	vector<int> children(categories.size());
+	for (int i = 1; i <= count; i++)
+	{
+		if (!categories.isLive(i))
+			continue;
+		negatives += categories.getBalance(i) < 0;
+		nested += categories.getDepth(i) >= 2;
+		childPercents[categories.getParentIndex(i)] += categories.getPercentOfBudget(i);
+		children[categories.getParentIndex(i)]++;
+		int end = categories.branchEnd(i);
+		if (balanceKernels.sumMoney(categories.balanceData() + i, end - i) != categories.getBranchTotal(i))
+			badBranch = i;
+	}
+	for (int i = 0; i <= count; i++)
+		if (categories.isLive(i) && (childPercents[i] != categories.getChildPercentTotal(i)
+			|| children[i] != categories.getChildCount(i)))
+			badBranch = i;
+
+	if (balanceTotal != categories.getCategoryTotal() || negatives != categories.getNegativeCount()
+		|| nested != categories.getNestedCount() || badBranch != -1)
+	{
+		cerr << "Running totals do not match after " << caller << ": balance " << categories.getCategoryTotal()
+			<< " vs " << balanceTotal << ", negative " << categories.getNegativeCount() << " vs " << negatives
+			<< ", nested " << categories.getNestedCount() << " vs " << nested << ", first bad branch at index "
+			<< badBranch << "\n";
+		abort();
+	}
+}
+#define VERIFY_TOTALS(categories) verifyTotals(categories, __func__)
+#else
+#define VERIFY_TOTALS(categories)
+#endif
+
+//This function splits an amount between a group of categories by their percentages
+//Each category first gets its share rounded down to the cent, and the cents left over are handed out one at a
+//time to the categories that lost the most to rounding (largest remainder). This way the shares always add up
+//to exactly the amount split when the percentages add to 100%.
+//Parameters:	Money amount - The amount to split, negative to take money away
+//				Money* shares - Each category's share is added to its entry
+//				const BasisPoints* percentages - The percentage of each category
+//				int count - The number of categories
+//				long long totalPercent - The sum of the percentages
+//				ScratchArena& scratch - Working space for what each share lost to rounding
+//Returns:		The sum of the shares
+Money splitAmount(Money amount, Money* shares, const BasisPoints* percentages, int count,
+	long long totalPercent, ScratchArena& scratch) {
+	ScratchScope scope(scratch);
+	//Split the amount by size, the sign is applied to every share afterwards
+	Money sign = amount < 0 ? -1 : 1;
+	Money magnitude = amount * sign;
+	Money total = roundedDivide(magnitude * totalPercent); //Exactly the amount when percentages add to 100%
+
+	int* remainders = scratch.take<int>(count);
+	balanceKernels.distributeShares(shares, percentages, remainders, count,
+		magnitude / ONE_HUNDRED_PERCENT, (int)(magnitude % ONE_HUNDRED_PERCENT), sign);
+
+	//Everything rounded off adds up to a whole number of cents, to be handed back out
+	long long roundedOff = balanceKernels.sumPercent(remainders, count);
+	Money roundedDown = (magnitude * totalPercent - roundedOff) / ONE_HUNDRED_PERCENT;
+	Money leftover = total - roundedDown;
+	Money handedOut = 0;
+
+	if (leftover > 0)
+	{
+		//Find the categories with the largest remainders, ties go to the earlier category
+		int* order = scratch.take<int>(count);
+		int orderSize = 0;
+		for (int i = 0; i < count; i++)
+			if (remainders[i] > 0)
+				order[orderSize++] = i;
+		auto largerRemainder = [remainders](int a, int b) {
+			return remainders[a] != remainders[b] ? remainders[a] > remainders[b] : a < b;
+		};
+		if (leftover < orderSize)
+			nth_element(order, order + leftover, order + orderSize, largerRemainder);
+		for (; handedOut < leftover && handedOut < orderSize; handedOut++)
+			shares[order[handedOut]] += sign;
+	}
+	return (roundedDown + handedOut) * sign;
+}
+
+//This function splits an amount down the tree of categories
+//Main's amount is split between the categories directly under it, and each category with sub-categories splits
+//its share again between them. A category keeps any part of its share its sub-categories' percentages leave over.
+//Every category's share is known before its sub-categories are reached, as the store is in tree order.
+//Parameters:	Money amount - The amount to split, negative to take money away
+//				CategoryStore& categories - The store of budget categories
+//				Money* balances - Each category's share is added to its slot, the store's balances or scratch space
+//Returns:		The amount added to the categories directly under main, including everything below them
+Money static splitDownTree(Money amount, CategoryStore& categories, Money* balances) {
+	METRIC_SCOPE(METRIC_SPLIT_DOWN_TREE);
+	int numOfCategories = categories.size();
+	ScratchArena& scratch = categories.scratch();
+	ScratchScope scope(scratch);
+
+	//Group the sub-categories of each category together, in order, so each group can be split in one go
+	int* groupStart = scratch.take<int>(numOfCategories + 1, 0);
+	for (int i = 1; i < numOfCategories; i++)
+		if (categories.isLive(i))
+			groupStart[categories.getParentIndex(i) + 1]++;
+	for (int i = 0; i < numOfCategories; i++)
+		groupStart[i + 1] += groupStart[i];
+	int* groups = scratch.take<int>(groupStart[numOfCategories]);
+	int* nextInGroup = scratch.take<int>(numOfCategories);
+	copy(groupStart, groupStart + numOfCategories, nextInGroup);
+	for (int i = 1; i < numOfCategories; i++)
+		if (categories.isLive(i))
+			groups[nextInGroup[categories.getParentIndex(i)]++] = i;
+
+	//Each group's shares are only needed until the group is handed out, so they are taken from the space above
+	//everything the whole split needs
+	Money* shares = scratch.take<Money>(numOfCategories, 0);
+	ScratchArena::Mark groupSpace = scratch.mark();
+	shares[0] = amount;
+	Money addedUnderMain = 0;
+	for (int parent = 0; parent < numOfCategories; parent++)
+	{
+		int first = groupStart[parent];
+		int count = groupStart[parent + 1] - first;
+		if (count == 0 || shares[parent] == 0)
+			continue;
+
+		scratch.release(groupSpace);
+		Money* groupShares = scratch.take<Money>(count, 0);
+		BasisPoints* groupPercentages = scratch.take<BasisPoints>(count);
+		for (int i = 0; i < count; i++)
+			groupPercentages[i] = categories.getPercentOfBudget(groups[first + i]);
+		Money handedDown = splitAmount(shares[parent], groupShares, groupPercentages, count,
+			categories.getChildPercentTotal(parent), scratch);
+
+		//A category with sub-categories passes its share on, any other keeps it
+		for (int i = 0; i < count; i++)
+		{
+			int child = groups[first + i];
+			if (categories.getChildCount(child) > 0)
+				shares[child] = groupShares[i];
+			else
+				balances[child] += groupShares[i];
+		}
+		if (parent == 0)
+			addedUnderMain = handedDown;
+		else
+		{
+			balances[parent] += shares[parent] - handedDown;
+			categories.addToSubcategoryTotal(parent, handedDown);
+		}
+	}
+	return addedUnderMain;
+}
+
+//This function modifies the balance contained within all budget categories
+//The balance is distributed based on the percentageOfBudget variable for each category, all adding up to 100%
+//Categories under another category split their parent's share the same way. See splitAmount for how each
+//share is rounded to the cent.
+//Parameters:	Money balanceModification - Variable that contains the amount of money to be added/removed
+//				CategoryStore& categories - The store of budget categories
+void modifyBalance(Money balanceModification, CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_MODIFY_BALANCE);
+	const BasisPoints* percentages = categories.percentData();
+
+	//With only main there is nothing to split, main takes its own share
+	if (categories.liveCount() <= 1)
+	{
+		categories.addToBalance(0, roundedDivide(balanceModification * percentages[0]));
+		return;
+	}
+
+	//The shares go straight into the balances, unless each one has to be recorded in the history
+	ScratchScope scope(categories.scratch());
+	Money* shares = nullptr;
+	Money* balances = categories.balanceData();
+	if (categories.hasHistory())
+	{
+		shares = categories.scratch().take<Money>(categories.size(), 0);
+		balances = shares;
+	}
+
+	//Without any sub-categories the whole store is one group, split straight over the columns
+	Money added;
+	if (categories.getNestedCount() == 0)
+		added = splitAmount(balanceModification, balances + 1, percentages + 1, categories.size() - 1,
+			categories.getPercentTotal(), categories.scratch());
+	else
+		added = splitDownTree(balanceModification, categories, balances);
+	if (categories.hasHistory())
+		categories.applyShares(shares);
+
+	//Only a withdrawal, or a deposit into a store with negative balances, can move a balance across zero
+	categories.balancesChanged(added, balanceModification < 0 || categories.getNegativeCount() > 0);
+	categories.addToBalance(0, added);
+	VERIFY_TOTALS(categories);
+}
+
+//This function gets the accumulated percentage of the categories directly under main
+//This is useful for ensuring that all of the categories add up to 100%
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//Returns:	The total accumulated percentage of the categories in basis points
+BasisPoints static getTotalPercentage(const CategoryStore& categories) {
+	return (BasisPoints)categories.getPercentTotal(); //Kept up to date by the store, main is not included
+}
+
+//This function adds an amount to a single category and updates main to match
+//Parameters:	int IDChoice - the ID of the category to be modified
+//				Money modification - The amount to add, negative to subtract
+//				CategoryStore& categories - The store of budget categories
+//Returns:		false if no category other than main has the ID
+bool applyToCategory(int IDChoice, Money modification, CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_ADD_TO_CATEGORY);
+	//Index 0 is total which should not be modified
+	int index = categories.indexOf(IDChoice);
+	if (index <= 0)
+		return false;
+
+	categories.addToBalance(index, modification);
+	categories.addToBalance(0, modification); //Main moves by the same amount
+	VERIFY_TOTALS(categories);
+	return true;
+}
+
+//This function creates a new category, initializing the percentage as 100% if it is the first
+//category under its parent, otherwise as 0%
+//Parameters:	string_view catName - The name of the category
+//				Money startingBalance - The balance the category starts with, which is also added to main
+//				CategoryStore& categories - The store of budget categories
+//				int id - The ID to give the category, or 0 to use the next valid ID
+//				int parentID - The ID of the category to place it under, 1 for main
+//Returns:		The ID of the new category, 0 if no category has the parent ID, or -1 if the name is taken
+int createCategory(string_view catName, Money startingBalance, CategoryStore& categories, int id,
+	int parentID) {
+	METRIC_SCOPE(METRIC_CREATE_CATEGORY);
+	int parentIndex = categories.indexOf(parentID);
+	if (parentIndex < 0)
+		return 0;
+	if (categories.indexOfName(catName) != -1)
+		return -1;
+
+	BasisPoints startingPercentage;
+	categories.addToBalance(0, startingBalance); //Add the new balance to main
+
+	//If this is the only category under its parent, it is 100%
+	if (categories.getChildCount(parentIndex) == 0)
+		startingPercentage = ONE_HUNDRED_PERCENT;
+	else
+		startingPercentage = 0;
+
+	int index;
+	if (id == 0)
+		index = categories.add(catName, startingBalance, startingPercentage, parentIndex);
+	else
+		index = categories.addWithID(id, catName, startingBalance, startingPercentage, parentIndex);
+	VERIFY_TOTALS(categories);
+	return categories.getIDNumber(index);
+}
+
+//This function erases a budget category and every category below it from the store, removing the percentages
+//and balances from the total
+//The store leaves empty slots behind, so nothing after the removed categories has to move
+//Parameters:	CategoryStore& categories - The store of categories
+//				int index - index (not ID) of the category to be removed
+void static eraseArrayCategory(CategoryStore& categories, int index) {
+	categories.setBalance(0, categories.getBalance(0) 
+		- categories.getBranchTotal(index)); //Remove this cat balance, and its sub-categories, from total
+	if (categories.getParentIndex(index) == 0)
+		categories.setPercentOfBudget(0, categories.getPercentOfBudget(0) 
+			- categories.getPercentOfBudget(index)); //Remove this cat percentage from total
+
+	categories.erase(index);
+	VERIFY_TOTALS(categories);
+}
+
+//This function removes the category with the ID from the store
+//Parameters:	int IDChoice - The ID of the category to be removed
+//				CategoryStore& categories - The store of budget categories
+//Returns:		The index the category was at, or -1 if no category other than main has the ID
+int deleteCategory(int IDChoice, CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_REMOVE_CATEGORY);
+	int indexOfRemoval = categories.indexOf(IDChoice);
+
+	//Main (index 0) can never be removed
+	if (indexOfRemoval <= 0)
+		return -1;
+
+	eraseArrayCategory(categories, indexOfRemoval);
+	return indexOfRemoval;
+}
+
+//This function puts back a branch of categories that was removed, with the IDs, balances and percentages they
+//had, and sets main's percentage
+//The branch goes back into its empty slots when they are still there, otherwise in front of the category that
+//followed it, so the categories end up in the same order either way
+//Parameters:	const char* rows - The removed categories in tree order, each an int32 ID, int32 parent ID,
+//				Money balance, int32 percentage, int32 name length and then the name
+//				const char* rowsEnd - One past the last row
+//				const int* slots - The slot each category was removed from, or nullptr if the indexes have moved since
+//				int beforeID - The ID of the category that followed the branch under its parent, 0 if it was the last
+//				BasisPoints mainPercent - The percentage main is set to
+//				CategoryStore& categories - The store of budget categories
+//Returns:		The number of categories put back
+int static restoreCategories(const char* rows, const char* rowsEnd, const int* slots, int beforeID,
+	BasisPoints mainPercent, CategoryStore& categories) {
+	const size_t rowHeader = 4 * sizeof(int32_t) + sizeof(int64_t);
+	Money restoredTotal = 0;
+	int restored = 0;
+	int index = -1;
+	for (int row = 0; rowsEnd - rows >= (ptrdiff_t)rowHeader; row++)
+	{
+		int32_t id, parentID, percent, nameLength;
+		int64_t balance;
+		memcpy(&id, rows, sizeof(int32_t));
+		memcpy(&parentID, rows + sizeof(int32_t), sizeof(int32_t));
+		memcpy(&balance, rows + 2 * sizeof(int32_t), sizeof(int64_t));
+		memcpy(&percent, rows + 2 * sizeof(int32_t) + sizeof(int64_t), sizeof(int32_t));
+		memcpy(&nameLength, rows + 3 * sizeof(int32_t) + sizeof(int64_t), sizeof(int32_t));
+		if (nameLength < 0 || rowsEnd - (rows + rowHeader) < nameLength)
+			break;
+		string_view name(rows + rowHeader, nameLength);
+		rows += rowHeader + nameLength;
+
+		int parentIndex = categories.indexOf(parentID);
+		if (parentIndex < 0)
+			continue;
+		if (slots != nullptr)
+			index = slots[row];
+		else if (index != -1)
+			index++; //Every category of the branch follows the one before it
+		else
+		{
+			int beforeIndex = beforeID == 0 ? -1 : categories.indexOf(beforeID);
+			index = beforeIndex > parentIndex ? beforeIndex : categories.branchEnd(parentIndex);
+		}
+		if (categories.restoreWithID(index, id, name, balance, percent, parentIndex) == -1)
+			continue;
+		restoredTotal += balance;
+		restored++;
+	}
+	categories.addToBalance(0, restoredTotal); //Main gets back what was taken off it at removal
+	categories.setPercentOfBudget(0, mainPercent);
+	VERIFY_TOTALS(categories);
+	return restored;
+}
+
+//This function sets the percentage of a single category without checking the total, call
+//updateMainPercentage once every category has been set
+//Parameters:	int IDChoice - The ID of the category
+//				BasisPoints percent - The new percentage
+//				CategoryStore& categories - The store of budget categories
+//Returns:		false if no category other than main has the ID
+bool assignPercentage(int IDChoice, BasisPoints percent, CategoryStore& categories) {
+	int index = categories.indexOf(IDChoice);
+	if (index <= 0)
+		return false;
+
+	categories.setPercentOfBudget(index, percent);
+	return true;
+}
+
+//This function finds a category whose sub-categories' percentages do not add up to 100%
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//Returns:		The index of the first such category, main being 0, or -1 if every group adds up to 100%
+int findUnbalancedGroup(const CategoryStore& categories) {
+	METRIC_SCOPE(METRIC_CHECK_PERCENTAGES);
+	for (int i = 0; i < categories.size(); i++)
+		if (categories.isLive(i) && categories.getChildCount(i) > 0
+			&& categories.getChildPercentTotal(i) != ONE_HUNDRED_PERCENT)
+			return i;
+	return -1;
+}
+
+//This function sets main's percentage to the total of every other category
+//Parameters:	CategoryStore& categories - The store of budget categories
+void updateMainPercentage(CategoryStore& categories) {
+	categories.setPercentOfBudget(0, getTotalPercentage(categories));
+	VERIFY_TOTALS(categories);
+}
+
+//This function saves the store to a file without ever leaving a half written file behind
+//The budget is written to a temporary file first, which then replaces the real file
+//Parameters:	const string& fileName - The name of the file to save to
+//				const CategoryStore& categories - The store of categories to be saved
+//				bool snapshot - true to save a binary snapshot, false to save text
+//Returns:		false if the file could not be written, after outputting an error
+bool saveBudgetFile(const string& fileName, const CategoryStore& categories, bool snapshot) {
+	string temporaryName = fileName + ".tmp";
+	bool saved = snapshot ? saveSnapshot(temporaryName, categories) : saveTextFile(temporaryName, categories);
+	if (!saved)
+		return false;
+
+	error_code renameError;
+	filesystem::rename(temporaryName, fileName, renameError);
+	if (renameError)
+	{
+		cout << "Error: Could not replace " << fileName << ": " << renameError.message() << "\n";
+		return false;
+	}
+	return true;
+}
+
+//This function writes the balances and percentages of the categories changed since the budget was saved over their
+//rows in a version 3 snapshot, leaving the rest of the file untouched
+//The new values are committed to the journal first, so if the program stops part way through, replaying the
+//journal puts the values right whichever of them reached the file
+//Parameters:	const string& fileName - The snapshot the store was last saved to, which the journal belongs to
+//				const CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal of the budget
+//Returns:		false if the file is not the snapshot the store was saved to, or could not be written
+bool static patchSnapshot(const string& fileName, const CategoryStore& categories, Journal& journal) {
+	METRIC_SCOPE(METRIC_SAVE_SNAPSHOT);
+	int flags = O_RDWR;
+#ifdef _WIN32
+	flags |= O_BINARY;
+#endif
+	int descriptor = ::open(fileName.c_str(), flags);
+	if (descriptor == -1)
+		return false;
+	auto writeAt = [&](size_t offset, const void* value, size_t size) {
+		return lseek(descriptor, (long)offset, SEEK_SET) == (long)offset
+			&& write(descriptor, value, (unsigned int)size) == (long)size;
+	};
+	SnapshotHeader header;
+	bool written = read(descriptor, &header, sizeof(SnapshotHeader)) == (long)sizeof(SnapshotHeader)
+		&& memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 && header.version == 3
+		&& header.categoryCount == (uint32_t)categories.liveCount()
+		&& header.nextIDNumber == categories.getNextIDNumber();
+	if (written)
+	{
+		journal.recordSavedValues(categories);
+		journal.commit();
+		size_t balancesAt = sizeof(SnapshotHeader);
+		size_t percentagesAt = balancesAt + header.categoryCount * sizeof(Money);
+		const vector<int>& changed = categories.getChangedSlots();
+		for (int i = 0; i < (int)changed.size() && written; i++)
+		{
+			uint32_t row = categories.getSavedRow(changed[i]);
+			Money balance = categories.getBalance(changed[i]);
+			BasisPoints percentage = categories.getPercentOfBudget(changed[i]);
+			header.valuesChecksum += snapshotRowHash(row, balance, percentage)
+				- snapshotRowHash(row, categories.getSavedBalance(i), categories.getSavedPercent(i));
+			written = writeAt(balancesAt + row * sizeof(Money), &balance, sizeof(Money))
+				&& writeAt(percentagesAt + row * sizeof(BasisPoints), &percentage, sizeof(BasisPoints));
+		}
+		written = written && writeAt(offsetof(SnapshotHeader, valuesChecksum), &header.valuesChecksum, sizeof(uint64_t))
+			&& Journal::syncFile(descriptor) == 0;
+	}
+	::close(descriptor);
+	return written;
+}
+
+//This function saves a budget and opens its journal on the file, empty, as every change is now in the file
+//Saving over the snapshot the budget was loaded from or last saved to, when only the balances and percentages
+//of a few categories have changed, writes just their rows with patchSnapshot, and does nothing at all if none
+//have changed. Otherwise, such as after a deposit or a category being added, removed or renamed, the whole file
+//is written again with saveBudgetFile.
+//Parameters:	const string& fileName - The name of the file to save to
+//				CategoryStore& categories - The store of categories to be saved
+//				Journal& journal - The journal of the budget
+//				bool snapshot - true to save a binary snapshot, false to save text
+//Returns:		false if the file could not be written, after outputting an error
+bool saveBudgetChanges(const string& fileName, CategoryStore& categories, Journal& journal, bool snapshot) {
+	journal.commit();
+	bool sameFile = journal.isOpen() && journal.getBudgetName() == fileName && journal.isBudgetSnapshot() == snapshot;
+	if (sameFile && snapshot && categories.canSaveChangesOnly()
+		&& (categories.getChangedSlots().empty() || patchSnapshot(fileName, categories, journal)))
+		categories.markSaved(false);
+	else if (saveBudgetFile(fileName, categories, snapshot))
+		categories.markSaved(true);
+	else
+		return false;
+	journal.open(fileName, snapshot);
+	return true;
+}
+
+//This function replays the journal of a budget file on top of the budget that was loaded from it
+//Replay stops at the first entry that is cut off or fails its checksum, as that is where a crash happened
+//A saved values entry holds the result of every entry before it, which the budget file may or may not have been
+//given, so replay starts from the last one
+//Parameters:	const string& fileName - The budget file the journal belongs to
+//				CategoryStore& categories - The store the budget was loaded into
+//				int& entriesReplayed - Receives the number of entries applied
+//				bool* savedValuesReplayed - If given, set to true if a saved values entry was applied
+//Returns:		The length of the journal that replayed cleanly, 0 if there is no journal
+size_t static replayJournal(const string& fileName, CategoryStore& categories, int& entriesReplayed,
+	bool* savedValuesReplayed = nullptr) {
+	METRIC_SCOPE(METRIC_REPLAY_JOURNAL);
+	entriesReplayed = 0;
+	if (savedValuesReplayed != nullptr)
+		*savedValuesReplayed = false;
+	vector<char> buffer;
+	ifstream file(fileName + ".journal", ios::in | ios::binary);
+	if (!file.is_open())
+		return 0;
+	buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	if (buffer.size() < sizeof(JOURNAL_MAGIC) || memcmp(buffer.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+		return 0;
+
+	//Returns the end of the entry at a position, or 0 if it is cut off or fails its checksum
+	auto entryEndAt = [&](size_t position) -> size_t {
+		if (position + sizeof(uint32_t) > buffer.size())
+			return 0;
+		uint32_t length;
+		memcpy(&length, &buffer[position], sizeof(uint32_t));
+		size_t entryEnd = position + sizeof(uint32_t) + (size_t)length + sizeof(uint32_t);
+		if (length == 0 || entryEnd > buffer.size())
+			return 0;
+		uint32_t checksum;
+		memcpy(&checksum, &buffer[position + sizeof(uint32_t) + length], sizeof(uint32_t));
+		return checksum == (uint32_t)fnv1a(&buffer[position + sizeof(uint32_t)], length) ? entryEnd : 0;
+	};
+	size_t position = sizeof(JOURNAL_MAGIC);
+	for (size_t scan = position, scanEnd; (scanEnd = entryEndAt(scan)) != 0; scan = scanEnd)
+		if (buffer[scan + sizeof(uint32_t)] == JOURNAL_SAVED_VALUES)
+			position = scan;
+
+	for (size_t entryEnd; (entryEnd = entryEndAt(position)) != 0; position = entryEnd)
+	{
+		uint32_t length;
+		memcpy(&length, &buffer[position], sizeof(uint32_t));
+		const char* entry = &buffer[position + sizeof(uint32_t)];
+
+		int32_t id = 0;
+		int64_t amount = 0;
+		const char* values = entry + 1;
+		switch (entry[0])
+		{
+		case JOURNAL_DEPOSIT:
+			memcpy(&amount, values, sizeof(int64_t));
+			modifyBalance(amount, categories);
+			break;
+		case JOURNAL_ADD_TO_CATEGORY:
+			memcpy(&id, values, sizeof(int32_t));
+			memcpy(&amount, values + sizeof(int32_t), sizeof(int64_t));
+			applyToCategory(id, amount, categories);
+			break;
+		case JOURNAL_NEW_CATEGORY:
+			memcpy(&id, values, sizeof(int32_t));
+			memcpy(&amount, values + sizeof(int32_t), sizeof(int64_t));
+			createCategory(string_view(values + sizeof(int32_t) + sizeof(int64_t),
+				entry + length - (values + sizeof(int32_t) + sizeof(int64_t))), amount, categories, id);
+			break;
+		case JOURNAL_NEW_SUBCATEGORY:
+		{
+			int32_t parentID;
+			memcpy(&id, values, sizeof(int32_t));
+			memcpy(&parentID, values + sizeof(int32_t), sizeof(int32_t));
+			memcpy(&amount, values + 2 * sizeof(int32_t), sizeof(int64_t));
+			createCategory(string_view(values + 2 * sizeof(int32_t) + sizeof(int64_t),
+				entry + length - (values + 2 * sizeof(int32_t) + sizeof(int64_t))), amount, categories, id, parentID);
+			break;
+		}
+		case JOURNAL_REMOVE_CATEGORY:
+			memcpy(&id, values, sizeof(int32_t));
+			deleteCategory(id, categories);
+			break;
+		case JOURNAL_SET_PERCENTAGES:
+			for (const char* pair = values; pair + 2 * sizeof(int32_t) <= entry + length; pair += 2 * sizeof(int32_t))
+			{
+				int32_t percent;
+				memcpy(&id, pair, sizeof(int32_t));
+				memcpy(&percent, pair + sizeof(int32_t), sizeof(int32_t));
+				assignPercentage(id, percent, categories);
+			}
+			updateMainPercentage(categories);
+			break;
+		case JOURNAL_RESTORE_CATEGORIES:
+		{
+			if (length < 1 + 2 * sizeof(int32_t))
+				break;
+			int32_t mainPercent, beforeID;
+			memcpy(&mainPercent, values, sizeof(int32_t));
+			memcpy(&beforeID, values + sizeof(int32_t), sizeof(int32_t));
+			restoreCategories(values + 2 * sizeof(int32_t), entry + length, nullptr, beforeID, mainPercent, categories);
+			break;
+		}
+		case JOURNAL_SAVED_VALUES:
+		{
+			const size_t recordSize = 2 * sizeof(int32_t) + sizeof(int64_t);
+			for (const char* record = values; record + recordSize <= entry + length; record += recordSize)
+			{
+				int32_t percent;
+				memcpy(&id, record, sizeof(int32_t));
+				memcpy(&amount, record + sizeof(int32_t), sizeof(int64_t));
+				memcpy(&percent, record + sizeof(int32_t) + sizeof(int64_t), sizeof(int32_t));
+				int index = categories.indexOf(id);
+				if (index < 0)
+					continue;
+				categories.setBalance(index, amount);
+				categories.setPercentOfBudget(index, percent);
+			}
+			if (savedValuesReplayed != nullptr)
+				*savedValuesReplayed = true;
+			break;
+		}
+		}
+		entriesReplayed++;
+	}
+	return position;
+}
+
+//This function starts recording every balance change of the store in the history kept by the journal
+//Any difference between the store and the end of the history, from changes made before the history was
+//recorded or lost in a crash, is added to the history as a change made now
+//Parameters:	CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal of the budget, which has been opened
+void attachHistory(CategoryStore& categories, Journal& journal) {
+	BalanceHistory& history = journal.getHistory();
+	for (int i = 0; i < categories.size(); i++)
+	{
+		if (!categories.isLive(i))
+			continue;
+		Money missing = categories.getBalance(i) - history.getBalance(categories.getIDNumber(i));
+		if (missing != 0)
+			history.record(categories.getIDNumber(i), missing);
+	}
+	for (int id : history.categoryIDs())
+		if (categories.indexOf(id) == -1 && history.getBalance(id) != 0)
+			history.record(id, -history.getBalance(id)); //Removed while the history was not recorded
+	history.commit();
+	categories.setHistory(&history);
+}
+
+//This function loads a budget file and replays its journal on top of it, leaving the journal as it is
+//A snapshot whose values fail their checksum was being patched when the program stopped, and is only loaded if
+//the journal holds the values that were being written
+//Parameters:	const string& fileName - The name of the file to load
+//				CategoryStore& categories - The store to load into
+//				bool& snapshot - Receives true if the file is a binary snapshot
+//				int& entriesReplayed - Receives the number of journal entries applied
+//				size_t& validLength - Receives the length of the journal that replayed cleanly
+//Returns:		true if the file was loaded, otherwise an error has been output
+bool static loadBudget(const string& fileName, CategoryStore& categories, bool& snapshot, int& entriesReplayed,
+	size_t& validLength) {
+	vector<char> buffer;
+	if (!readWholeFile(fileName, buffer))
+		return false;
+	snapshot = isSnapshot(buffer);
+	bool valuesDamaged = false;
+	bool loaded = snapshot ? parseSnapshot(buffer, fileName, categories, &valuesDamaged)
+		: parseTextBudget(buffer, fileName, categories);
+	if (!loaded)
+		return false;
+
+	bool savedValuesReplayed;
+	validLength = replayJournal(fileName, categories, entriesReplayed, &savedValuesReplayed);
+	if (valuesDamaged && !savedValuesReplayed)
+	{
+		cout << "Error: " << fileName << ": checksum does not match, the file is damaged.\n";
+		return false;
+	}
+	return true;
+}
+
+//This function loads a budget file and replays its journal, then opens the journal to record new changes
+//Parameters:	const string& fileName - The name of the file to load
+//				CategoryStore& categories - The store to load into
+//				Journal& journal - The journal to attach to the file
+//Returns:		true if the file was loaded, otherwise an error has been output
+bool openBudget(const string& fileName, CategoryStore& categories, Journal& journal) {
+	categories.setHistory(nullptr); //Loading and replaying are not new changes
+	bool snapshot;
+	int entriesReplayed;
+	size_t validLength;
+	if (!loadBudget(fileName, categories, snapshot, entriesReplayed, validLength))
+		return false;
+	if (entriesReplayed > 0)
+		cout << entriesReplayed << " unsaved changes were recovered from the journal.\n";
+	journal.getHistory().load(fileName);
+	journal.open(fileName, snapshot, validLength);
+	attachHistory(categories, journal);
+	return true;
+}
+
+//This function opens a budget file like openBudget, or starts a new budget if the file does not exist yet
+//A new budget still replays any journal left behind, in case it was never saved before the program stopped
+//Parameters:	const string& fileName - The name of the budget file
+//				CategoryStore& categories - The store to load into
+//				Journal& journal - The journal to attach to the file
+//Returns:		true if the budget is ready, otherwise an error has been output
+bool openOrCreateBudget(const string& fileName, CategoryStore& categories, Journal& journal) {
+	if (filesystem::exists(fileName))
+		return openBudget(fileName, categories, journal);
+
+	categories.setHistory(nullptr);
+	categories.clear();
+	categories.add("main", 0, ONE_HUNDRED_PERCENT);
+	int entriesReplayed;
+	size_t validLength = replayJournal(fileName, categories, entriesReplayed);
+	if (entriesReplayed > 0)
+		cout << entriesReplayed << " unsaved changes were recovered from the journal.\n";
+	journal.getHistory().load(fileName);
+	journal.open(fileName, false, validLength);
+	attachHistory(categories, journal);
+	return true;
+}
+
+//This function removes a category like deleteCategory, first recording everything needed to put it back
+//The data of the record is the number of slots, the slot of each removed category, then the rows read by
+//restoreCategories. The slots are left out if the removal compacted the store.
+//Parameters:	int IDChoice - The ID of the category to be removed
+//				CategoryStore& categories - The store of budget categories
+//				UndoRecord& record - Receives the change
+//Returns:		The index the category was at, or -1 if no category other than main has the ID
+int deleteCategoryForUndo(int IDChoice, CategoryStore& categories, UndoRecord& record) {
+	int index = categories.indexOf(IDChoice);
+	if (index <= 0)
+		return -1;
+	int end = categories.branchEnd(index);
+	int parentIndex = categories.getParentIndex(index);
+	record.type = UNDO_REMOVE_CATEGORY;
+	record.id = IDChoice;
+	record.mainPercent = categories.getPercentOfBudget(0);
+	record.indexMoves = categories.getIndexMoves();
+
+	//The branch goes back in front of the next category under the same parent
+	record.parentID = 0;
+	int next = end;
+	while (next < categories.size() && !categories.isLive(next))
+		next++;
+	if (next < categories.size() && categories.getParentIndex(next) == parentIndex)
+		record.parentID = categories.getIDNumber(next);
+
+	record.data.clear();
+	int live = 0;
+	for (int i = index; i < end; i++)
+		live += categories.isLive(i);
+	putUndoValue<int32_t>(record.data, live);
+	for (int i = index; i < end; i++)
+		if (categories.isLive(i))
+			putUndoValue<int32_t>(record.data, i);
+	for (int i = index; i < end; i++)
+	{
+		if (!categories.isLive(i))
+			continue;
+		string_view name = categories.getName(i);
+		putUndoValue<int32_t>(record.data, categories.getIDNumber(i));
+		putUndoValue<int32_t>(record.data, categories.getIDNumber(categories.getParentIndex(i)));
+		putUndoValue<int64_t>(record.data, categories.getBalance(i));
+		putUndoValue<int32_t>(record.data, categories.getPercentOfBudget(i));
+		putUndoValue<int32_t>(record.data, (int32_t)name.size());
+		record.data.insert(record.data.end(), name.begin(), name.end());
+	}
+
+	deleteCategory(IDChoice, categories);
+	if (categories.getIndexMoves() != record.indexMoves)
+	{
+		//The slots are gone, so keep only the rows
+		record.data.erase(record.data.begin() + sizeof(int32_t), record.data.begin() + (1 + live) * sizeof(int32_t));
+		memset(record.data.data(), 0, sizeof(int32_t));
+	}
+	record.data.shrink_to_fit();
+	return index;
+}
+
+//This function finds the rows of a removal record, after its slots
+//Parameters:	const UndoRecord& record - A removal
+//				const int*& slots - Receives the slot of each row, nullptr if the rows can't go back into them
+//				const CategoryStore& categories - The store of budget categories
+//Returns:		The first row
+const char static* removedRows(const UndoRecord& record, const int*& slots, const CategoryStore& categories) {
+	int32_t slotCount;
+	memcpy(&slotCount, record.data.data(), sizeof(int32_t));
+	slots = slotCount > 0 && record.indexMoves == categories.getIndexMoves()
+		? (const int*)(record.data.data() + sizeof(int32_t)) : nullptr;
+	return record.data.data() + (1 + slotCount) * sizeof(int32_t);
+}
+
+//This function sets main's percentage back to what a change left it at, if it is not that already
+//Undoing a new category or a percentage change can leave main's percentage where it was before, which the
+//removal or percentage entries in the journal would not, so the journal gets a restore with no rows
+//Parameters:	BasisPoints mainPercent - The percentage main should have
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+void static restoreMainPercentage(BasisPoints mainPercent, CategoryStore& categories, Journal& journal) {
+	if (categories.getPercentOfBudget(0) == mainPercent)
+		return;
+	restoreCategories(nullptr, nullptr, nullptr, 0, mainPercent, categories);
+	journal.recordRestoreCategories(mainPercent, 0, nullptr, 0);
+}
+
+//This function swaps the percentages held by a percentage change with the ones in the store, which both undoes
+//and redoes it
+//Parameters:	UndoRecord& record - The percentage change
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+void static swapPercentages(UndoRecord& record, CategoryStore& categories, Journal& journal) {
+	BasisPoints mainPercent = categories.getPercentOfBudget(0);
+	journal.recordPercentages(record.data.data(), record.data.size());
+	for (size_t at = 0; at + 2 * sizeof(int32_t) <= record.data.size(); at += 2 * sizeof(int32_t))
+	{
+		int32_t id, percent;
+		memcpy(&id, &record.data[at], sizeof(int32_t));
+		memcpy(&percent, &record.data[at + sizeof(int32_t)], sizeof(int32_t));
+		int index = categories.indexOf(id);
+		if (index <= 0)
+			continue;
+		int32_t current = categories.getPercentOfBudget(index);
+		memcpy(&record.data[at + sizeof(int32_t)], &current, sizeof(int32_t));
+		categories.setPercentOfBudget(index, percent);
+	}
+	updateMainPercentage(categories);
+	restoreMainPercentage(record.mainPercent, categories, journal);
+	record.mainPercent = mainPercent;
+}
+
+//This function undoes a change, leaving it ready to be redone
+//Changes are undone newest first, so the store is exactly as the change left it
+//Parameters:	UndoRecord& record - The change
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+void undoChange(UndoRecord& record, CategoryStore& categories, Journal& journal) {
+	switch (record.type)
+	{
+	case UNDO_DEPOSIT:
+		//A split rounds the same way for either sign, so taking the amount back out returns every cent
+		modifyBalance(-record.amount, categories);
+		journal.recordDeposit(-record.amount);
+		break;
+	case UNDO_ADD_TO_CATEGORY:
+		applyToCategory(record.id, -record.amount, categories);
+		journal.recordAddToCategory(record.id, -record.amount);
+		break;
+	case UNDO_NEW_CATEGORY:
+		deleteCategory(record.id, categories);
+		journal.recordRemoveCategory(record.id);
+		restoreMainPercentage(record.mainPercent, categories, journal);
+		break;
+	case UNDO_REMOVE_CATEGORY:
+	{
+		const int* slots;
+		const char* rows = removedRows(record, slots, categories);
+		const char* rowsEnd = record.data.data() + record.data.size();
+		restoreCategories(rows, rowsEnd, slots, record.parentID, record.mainPercent, categories);
+		journal.recordRestoreCategories(record.mainPercent, record.parentID, rows, rowsEnd - rows);
+		break;
+	}
+	case UNDO_SET_PERCENTAGES:
+		swapPercentages(record, categories, journal);
+		break;
+	}
+}
+
+//This function makes an undone change again, leaving it ready to be undone
+//Parameters:	UndoRecord& record - The change
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+void redoChange(UndoRecord& record, CategoryStore& categories, Journal& journal) {
+	switch (record.type)
+	{
+	case UNDO_DEPOSIT:
+		modifyBalance(record.amount, categories);
+		journal.recordDeposit(record.amount);
+		break;
+	case UNDO_ADD_TO_CATEGORY:
+		applyToCategory(record.id, record.amount, categories);
+		journal.recordAddToCategory(record.id, record.amount);
+		break;
+	case UNDO_NEW_CATEGORY:
+	{
+		string_view name(record.data.data(), record.data.size());
+		createCategory(name, record.amount, categories, record.id, record.parentID);
+		journal.recordNewCategory(record.id, record.parentID, record.amount, name);
+		break;
+	}
+	case UNDO_REMOVE_CATEGORY:
+		deleteCategoryForUndo(record.id, categories, record); //The slots may have moved since it was removed
+		journal.recordRemoveCategory(record.id);
+		break;
+	case UNDO_SET_PERCENTAGES:
+		swapPercentages(record, categories, journal);
+		break;
+	}
+}
+
+//This function describes a change for the undo menu
+//Parameters:	const UndoRecord& record - The change
+//				const CategoryStore& categories - The store of budget categories
+//Returns:		The description, such as "adding 5.00 to Savings"
+string describeChange(const UndoRecord& record, const CategoryStore& categories) {
+	switch (record.type)
+	{
+	case UNDO_DEPOSIT:
+		return "adding " + toDecimalString(record.amount) + " to the balance";
+	case UNDO_ADD_TO_CATEGORY:
+	{
+		int index = categories.indexOf(record.id);
+		return "adding " + toDecimalString(record.amount) + " to "
+			+ (index > 0 ? string(categories.getName(index)) : "ID " + to_string(record.id));
+	}
+	case UNDO_NEW_CATEGORY:
+		return "creating " + string(record.data.data(), record.data.size());
+	case UNDO_REMOVE_CATEGORY:
+	{
+		int index = categories.indexOf(record.id);
+		if (index > 0)
+			return "removing " + string(categories.getName(index));
+		//The name of the removed category is the first one in its rows
+		const int* slots;
+		const char* row = removedRows(record, slots, categories);
+		int32_t nameLength;
+		memcpy(&nameLength, row + 3 * sizeof(int32_t) + sizeof(int64_t), sizeof(int32_t));
+		return "removing " + string(row + 4 * sizeof(int32_t) + sizeof(int64_t), nameLength);
+	}
+	case UNDO_SET_PERCENTAGES:
+		return "setting " + to_string(record.data.size() / (2 * sizeof(int32_t))) + " percentages";
+	}
+	return "";
+}
+
+//This function counts the days from 1970-01-01 to a date, using the Gregorian calendar for every year
+//Parameters:	int year, int month, int day - The date
+//Returns:		The number of days, negative for dates before 1970
+int64_t daysFromCivil(int year, int month, int day) {
+	int64_t shiftedYear = year - (month <= 2); //Count years from March, so the leap day is at the end
+	int64_t era = (shiftedYear >= 0 ? shiftedYear : shiftedYear - 399) / 400;
+	int64_t yearOfEra = shiftedYear - era * 400;
+	int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}
+
+//This function reads a date in the format YYYY-MM-DD
+//Parameters:	const string& text - The date
+//				int64_t& startTime - Receives the time the day starts at, in seconds since 1970 (UTC)
+//Returns:		false if the text is not a valid date
+bool parseDate(const string& text, int64_t& startTime) {
+	int year, month, day;
+	char extra;
+	if (sscanf(text.c_str(), "%d-%d-%d%c", &year, &month, &day, &extra) != 3
+		|| month < 1 || month > 12 || day < 1 || day > 31)
+		return false;
+	startTime = daysFromCivil(year, month, day) * 86400;
+	return true;
+}
+
+//A bounded queue handing values from one thread to one other thread, without locks
+//Each end only writes its own position, so the two threads never wait on each other except when the queue is
+//full or empty. Then push or pop keeps trying, spinning briefly before giving up the core each time, so a fast
+//thread is held back by a slow one instead of running ahead. Each end also keeps counts of its own, read once
+//both threads are done: how long it waited, and how full the queue was after each push.
+template <typename T>
+class SpscQueue {
+	vector<T> slots;
+	size_t mask;
+	alignas(64) atomic<size_t> head{ 0 }; //Count of values popped, only written by the consumer
+	alignas(64) atomic<size_t> tail{ 0 }; //Count of values pushed, only written by the producer
+	atomic<bool> closed{ false };
+	alignas(64) double pushWaitSeconds = 0;
+	long long pushes = 0;
+	long long occupancyTotal = 0;
+	size_t mostOccupied = 0;
+	alignas(64) double popWaitSeconds = 0;
+
+	//Waits a moment before trying again, spinning at first and then letting other threads run
+	static void pause(int& tries) {
+		if (++tries > 64)
+			this_thread::yield();
+	}
+public:
+	//Parameters:	size_t capacity - The most values held at once, rounded up to a power of two
+	explicit SpscQueue(size_t capacity) {
+		size_t size = 1;
+		while (size < capacity)
+			size *= 2;
+		slots.resize(size);
+		mask = size - 1;
+	}
+	size_t capacity() const {
+		return slots.size();
+	}
+	//Adds a value, waiting while the queue is full. Only called by the producer
+	void push(T value) {
+		size_t position = tail.load(memory_order_relaxed);
+		if (position - head.load(memory_order_acquire) == slots.size())
+		{
+			auto waitStart = chrono::steady_clock::now();
+			for (int tries = 0; position - head.load(memory_order_acquire) == slots.size(); )
+				pause(tries);
+			pushWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - waitStart).count();
+		}
+		slots[position & mask] = std::move(value);
+		tail.store(position + 1, memory_order_release);
+		size_t occupied = position + 1 - head.load(memory_order_relaxed);
+		pushes++;
+		occupancyTotal += (long long)occupied;
+		mostOccupied = max(mostOccupied, occupied);
+	}
+	//Marks that nothing more will be pushed. Only called by the producer
+	void close() {
+		closed.store(true, memory_order_release);
+	}
+	//Takes the oldest value, waiting while the queue is empty. Only called by the consumer
+	//Returns:		false once the queue is closed and empty
+	bool pop(T& value) {
+		size_t position = head.load(memory_order_relaxed);
+		if (tail.load(memory_order_acquire) == position)
+		{
+			auto waitStart = chrono::steady_clock::now();
+			for (int tries = 0; tail.load(memory_order_acquire) == position; pause(tries))
+			{
+				//Checking tail again after seeing closed catches a value pushed just before closing
+				if (closed.load(memory_order_acquire) && tail.load(memory_order_acquire) == position)
+				{
+					popWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - waitStart).count();
+					return false;
+				}
+			}
+			popWaitSeconds += chrono::duration<double>(chrono::steady_clock::now() - waitStart).count();
+		}
+		value = std::move(slots[position & mask]);
+		head.store(position + 1, memory_order_release);
+		return true;
+	}
+	double getPushWaitSeconds() const {
+		return pushWaitSeconds;
+	}
+	double getPopWaitSeconds() const {
+		return popWaitSeconds;
+	}
+	//Returns how many values the queue held after each push, on average
+	double averageOccupancy() const {
+		return pushes == 0 ? 0 : (double)occupancyTotal / pushes;
+	}
+	size_t mostOccupancy() const {
+		return mostOccupied;
+	}
+};
+const int BATCH_ERRORS_SHOWN = 20; //Errors after this many are only counted
+const size_t BATCH_MIN_CHUNK = 1 << 20; //Files are not cut into chunks smaller than this many bytes
+const int PIPELINE_BLOCKS = 8; //Blocks of the file between being read and being applied at once, each BATCH_MIN_CHUNK
+const int PIPELINE_JOURNAL_GROUPS = 4; //Journal groups waiting to be written at once
+
+//This function splits a line of a batch file into its values, separated by commas, spaces or tabs
+//Parameters:	const char* row - The start of the line
+//				const char* rowEnd - One past the end of the line
+//				vector<string_view>& fields - Receives the values, reused between lines so it does not reallocate
+void splitBatchFields(const char* row, const char* rowEnd, vector<string_view>& fields) {
+	fields.clear();
+	while (row < rowEnd)
+	{
+		while (row < rowEnd && (*row == ',' || *row == ' ' || *row == '\t'))
+			row++;
+		const char* fieldStart = row;
+		while (row < rowEnd && *row != ',' && *row != ' ' && *row != '\t')
+			row++;
+		if (row > fieldStart)
+			fields.emplace_back(fieldStart, row - fieldStart);
+	}
+}
+
+//This function reads a whole ID from a batch value
+//Parameters:	string_view field - The value
+//				int& id - Receives the ID
+//Returns:		false if the value is not a whole number
+bool parseBatchID(string_view field, int& id) {
+	return !field.empty() && from_chars(field.data(), field.data() + field.size(), id).ptr == field.data() + field.size();
+}
+
+//This function finds the category a batch value refers to, either by its ID or by its name
+//Parameters:	string_view field - The value
+//				const CategoryStore& categories - The store of budget categories
+//				int& id - Receives the ID, or -1 if no category has the name
+//Returns:		false if the value is empty
+bool resolveBatchID(string_view field, const CategoryStore& categories, int& id) {
+	if (field.empty())
+		return false;
+	if (parseBatchID(field, id))
+		return true;
+	int index = categories.indexOfName(field);
+	id = index < 0 ? -1 : categories.getIDNumber(index);
+	return true;
+}
+
+//This function reads an amount of money, or a percentage, from a batch value as hundredths
+//Parameters:	string_view field - The value
+//				long long& value - Receives the number of hundredths
+//Returns:		false if the value is not a valid number
+bool parseBatchHundredths(string_view field, long long& value) {
+	return parseHundredths(field.data(), field.data() + field.size(), value);
+}
+
+//This function applies a create, remove or percent command from a batch file to the store and records it in the journal
+//Parameters:	const vector<string_view>& fields - The values of the command
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+//				BatchSummary& summary - Counts of what has been done, updated by this command
+//				vector<pair<int, BasisPoints>>& oldPercentages - Scratch space for undoing a bad percent command
+//Returns:		nullptr if the command was applied, otherwise the reason it was not
+const char* applyBatchCommand(const vector<string_view>& fields, CategoryStore& categories, Journal& journal,
+	BatchSummary& summary, vector<pair<int, BasisPoints>>& oldPercentages) {
+	string_view command = fields[0];
+	int id;
+	long long amount;
+	if (command == "create")
+	{
+		int parentID = 1;
+		if (fields.size() < 3 || fields.size() > 4 || !parseBatchHundredths(fields[2], amount)
+			|| (fields.size() == 4 && !resolveBatchID(fields[3], categories, parentID)))
+			return "expected create,<name>,<starting balance>[,<parent ID>]";
+		id = createCategory(fields[1], amount, categories, 0, parentID);
+		if (id == 0)
+			return "parent ID not found";
+		if (id == -1)
+			return "name already exists";
+		journal.recordNewCategory(id, parentID, amount, fields[1]);
+		summary.created++;
+	}
+	else if (command == "remove")
+	{
+		if (fields.size() != 2 || !resolveBatchID(fields[1], categories, id))
+			return "expected remove,<ID>";
+		if (deleteCategory(id, categories) == -1)
+			return "ID not found";
+		journal.recordRemoveCategory(id);
+		summary.removed++;
+	}
+	else if (command == "percent")
+	{
+		if (fields.size() < 3 || fields.size() % 2 != 1)
+			return "expected percent,<ID>,<percent>,...";
+
+		//Set each percentage, remembering the old ones in case the total does not come to 100%
+		const char* error = nullptr;
+		oldPercentages.clear();
+		for (size_t i = 1; i < fields.size() && error == nullptr; i += 2)
+		{
+			if (!resolveBatchID(fields[i], categories, id) || !parseBatchHundredths(fields[i + 1], amount)
+				|| amount < 0 || amount > ONE_HUNDRED_PERCENT)
+				error = "expected percent,<ID>,<percent>,... with percentages between 0 and 100";
+			else if (categories.indexOf(id) <= 0)
+				error = "ID not found";
+			else
+			{
+				oldPercentages.emplace_back(id, categories.getPercentOfBudget(categories.indexOf(id)));
+				assignPercentage(id, (BasisPoints)amount, categories);
+			}
+		}
+		if (error == nullptr && findUnbalancedGroup(categories) != -1)
+			error = "percentages do not total 100%";
+		if (error != nullptr)
+		{
+			for (size_t i = oldPercentages.size(); i > 0; i--)
+				assignPercentage(oldPercentages[i - 1].first, oldPercentages[i - 1].second, categories);
+			return error;
+		}
+		updateMainPercentage(categories);
+		journal.recordPercentages(categories);
+		summary.percentageChanges++;
+	}
+	else
+		return "unknown command";
+	return nullptr;
+}
+
+//This function reads one chunk of a batch file into commands
+//Only the lines are read here, nothing is applied to the budget, so chunks can be read in parallel
+//Parameters:	BatchChunk& chunk - The chunk to read, with start and end filled in
+//				int maxID - No category can have an ID above this, so adds to higher IDs are errors
+void static parseBatchChunk(BatchChunk& chunk, int maxID) {
+	METRIC_SCOPE(METRIC_BATCH_PARSE);
+	vector<string_view> fields;
+	const char* cursor = chunk.start;
+	while (cursor < chunk.end)
+	{
+		const char* lineEnd = (const char*)memchr(cursor, '\n', chunk.end - cursor);
+		if (lineEnd == nullptr)
+			lineEnd = chunk.end;
+		const char* rowEnd = lineEnd;
+		if (rowEnd > cursor && rowEnd[-1] == '\r')
+			rowEnd--;
+		const char* row = skipSpaces(cursor, rowEnd);
+		cursor = lineEnd + 1;
+		chunk.lines++;
+		if (row == rowEnd || *row == '#')
+			continue;
+
+		splitBatchFields(row, rowEnd, fields);
+		chunk.records++;
+		BatchRecord record = { BATCH_COMMAND, 0, 0, chunk.lines, row, rowEnd };
+		if (fields[0] == "deposit")
+		{
+			if (fields.size() != 2 || !parseBatchHundredths(fields[1], record.amount))
+			{
+				chunk.errors.emplace_back(chunk.lines, "expected deposit,<amount>");
+				continue;
+			}
+			record.type = BATCH_DEPOSIT;
+		}
+		else if (fields[0] == "add")
+		{
+			if (fields.size() != 3 || !parseBatchHundredths(fields[2], record.amount))
+			{
+				chunk.errors.emplace_back(chunk.lines, "expected add,<ID>,<amount>");
+				continue;
+			}
+			if (!parseBatchID(fields[1], record.id))
+			{
+				record.type = BATCH_NAMED_ADD;
+				record.text = fields[1].data();
+				record.textEnd = fields[1].data() + fields[1].size();
+			}
+			else if (record.id <= 1 || record.id > maxID)
+			{
+				chunk.errors.emplace_back(chunk.lines, "ID not found");
+				continue;
+			}
+			else
+				record.type = BATCH_ADD;
+		}
+		chunk.commands.push_back(record);
+	}
+}
+
+//This function reads a whole batch file, parses it in chunks spread over a thread pool, and applies the chunks
+//Parameters:	const string& commandsName - The file of commands, or - to read them from standard input
+//				ThreadPool& pool - The threads to parse the chunks on, one chunk each unless the file is small
+//				BatchApplier& applier - Applies the chunks to the budget
+//				const CategoryStore& categories - The budget, for the highest ID its categories can reach
+//Returns:		The number of chunks the file was cut into, or 0 if it could not be read
+size_t applyBatchFile(const string& commandsName, ThreadPool& pool, BatchApplier& applier,
+	const CategoryStore& categories) {
+	vector<char> buffer;
+	if (commandsName == "-")
+		buffer.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+	else if (!readWholeFile(commandsName, buffer))
+		return 0;
+
+	//Cut the file into chunks at line breaks, one per thread unless the file is small
+	size_t chunkCount = min((size_t)pool.size(), buffer.size() / BATCH_MIN_CHUNK + 1);
+	vector<BatchChunk> chunks(chunkCount);
+	const char* fileEnd = buffer.data() + buffer.size();
+	const char* chunkStart = buffer.data();
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = buffer.data() + buffer.size() * (i + 1) / chunkCount;
+		if (chunkEnd < chunkStart)
+			chunkEnd = chunkStart;
+		const char* lineBreak = (const char*)memchr(chunkEnd, '\n', fileEnd - chunkEnd);
+		chunkEnd = (i + 1 == chunkCount || lineBreak == nullptr) ? fileEnd : lineBreak + 1;
+		chunks[i].start = chunkStart;
+		chunks[i].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	//A create line is at least 10 characters, which limits how high an ID in this file can go
+	int maxID = (int)min((long long)numeric_limits<int>::max(), (long long)categories.getNextIDNumber() + (long long)buffer.size() / 10 + 1);
+	pool.run((int)chunkCount, [&](int i) { parseBatchChunk(chunks[i], maxID); });
+	for (BatchChunk& chunk : chunks)
+		applier.applyChunk(chunk);
+	return chunkCount;
+}
+
+//One block of a batch file in the pipeline, passed from stage to stage and then back to be read into again
+struct PipelineBlock {
+	vector<char> bytes; //Whole lines, except for a last line without a line break at the end of the file
+	size_t length = 0;
+	BatchChunk chunk; //Points into bytes
+};
+
+//This function runs the stages of a pipelined batch run: a thread reading blocks of the file, a thread parsing
+//each block like parseBatchChunk does a chunk, this thread applying them in order, and a thread writing the journal
+//groups that applying them recorded. The stages are joined by SpscQueues, and only PIPELINE_BLOCKS blocks exist,
+//so reading stops whenever the later stages fall behind.
+//Parameters:	const string& commandsName - The file of commands, or - to read them from standard input
+//				BatchApplier& applier - Applies the chunks to the budget
+//				const CategoryStore& categories - The budget, for the highest ID its categories can reach
+//				Journal& journal - The journal the applier records changes in
+//				PipelineReport& report - Receives how each stage and queue was used
+//Returns:		false if the file could not be read, after outputting an error
+bool runBatchPipeline(const string& commandsName, BatchApplier& applier, const CategoryStore& categories,
+	Journal& journal, PipelineReport& report) {
+	int descriptor = 0;
+	if (commandsName != "-")
+	{
+		int flags = O_RDONLY;
+#ifdef _WIN32
+		flags |= O_BINARY;
+#endif
+		descriptor = ::open(commandsName.c_str(), flags);
+		if (descriptor == -1)
+		{
+			cout << "Error: Could not open " << commandsName << ".\n";
+			return false;
+		}
+	}
+	//A file's size gives the same highest ID as reading it whole. For input of unknown length, what has been read
+	//so far is enough, as a category has to be created before anything can be added to it
+	error_code sizeError;
+	long long knownSize = commandsName == "-" ? -1 : (long long)filesystem::file_size(commandsName, sizeError);
+	if (sizeError)
+		knownSize = -1;
+	long long firstID = categories.getNextIDNumber();
+
+	PipelineStage& reading = report.stages[0];
+	PipelineStage& parsing = report.stages[1];
+	PipelineStage& applying = report.stages[2];
+	PipelineStage& journaling = report.stages[3];
+	reading = { "read", "bytes" };
+	parsing = { "parse", "records" };
+	applying = { "apply", "records" };
+	journaling = { "journal", "bytes" };
+	vector<PipelineBlock> blocks(PIPELINE_BLOCKS);
+	SpscQueue<PipelineBlock*> emptyBlocks(PIPELINE_BLOCKS);
+	SpscQueue<PipelineBlock*> readBlocks(PIPELINE_BLOCKS);
+	SpscQueue<PipelineBlock*> parsedBlocks(PIPELINE_BLOCKS);
+	SpscQueue<vector<char>> journalGroups(PIPELINE_JOURNAL_GROUPS);
+	for (PipelineBlock& block : blocks)
+		emptyBlocks.push(&block);
+	bool readFailed = false;
+
+	thread reader([&]() {
+		auto startTime = chrono::steady_clock::now();
+		vector<char> carried; //The start of a line that did not fit in the last block
+		bool atEnd = false;
+		PipelineBlock* block;
+		while (!atEnd && emptyBlocks.pop(block))
+		{
+			vector<char>& bytes = block->bytes;
+			size_t filled = carried.size();
+			bytes.resize(max({ bytes.size(), BATCH_MIN_CHUNK, filled * 2 }));
+			copy(carried.begin(), carried.end(), bytes.begin());
+			size_t lineEnd = 0; //One past the last line break
+			//Fill the block, going on past its end while no line has ended in it yet
+			while (!atEnd && (filled < bytes.size() || lineEnd == 0))
+			{
+				if (filled == bytes.size())
+					bytes.resize(bytes.size() * 2);
+				long got = read(descriptor, bytes.data() + filled, (unsigned int)(bytes.size() - filled));
+				if (got <= 0)
+				{
+					atEnd = true;
+					readFailed = got < 0;
+					break;
+				}
+				for (size_t i = filled + got; i > filled; i--)
+				{
+					if (bytes[i - 1] == '\n')
+					{
+						lineEnd = i;
+						break;
+					}
+				}
+				filled += got;
+				reading.items += got;
+			}
+			if (atEnd)
+				lineEnd = filled; //The last line may have no line break
+			carried.assign(bytes.begin() + lineEnd, bytes.begin() + filled);
+			block->length = lineEnd;
+			readBlocks.push(block);
+		}
+		readBlocks.close();
+		reading.busySeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	});
+
+	thread parser([&]() {
+		auto startTime = chrono::steady_clock::now();
+		long long bytesParsed = 0;
+		PipelineBlock* block;
+		while (readBlocks.pop(block))
+		{
+			bytesParsed += (long long)block->length;
+			//A create line is at least 10 characters, which limits how high an ID in this file can go
+			long long highestID = firstID + (knownSize >= 0 ? knownSize : bytesParsed) / 10 + 1;
+			//The lists of the chunk are cleared rather than replaced, so their space is reused for the next block
+			block->chunk.lines = 0;
+			block->chunk.records = 0;
+			block->chunk.commands.clear();
+			block->chunk.errors.clear();
+			block->chunk.start = block->bytes.data();
+			block->chunk.end = block->bytes.data() + block->length;
+			parseBatchChunk(block->chunk, (int)min((long long)numeric_limits<int>::max(), highestID));
+			parsing.items += block->chunk.records;
+			parsedBlocks.push(block);
+		}
+		parsedBlocks.close();
+		parsing.busySeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	});
+
+	thread journalWriter([&]() {
+		auto startTime = chrono::steady_clock::now();
+		vector<char> group;
+		while (journalGroups.pop(group))
+		{
+			journal.writeGroup(group);
+			journaling.items += (long long)group.size();
+		}
+		journaling.busySeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	});
+
+	//Groups are handed to the journal writer here instead of being committed as they fill
+	auto startTime = chrono::steady_clock::now();
+	journal.setSyncBatchSize(numeric_limits<int>::max());
+	PipelineBlock* block;
+	vector<char> group;
+	while (parsedBlocks.pop(block))
+	{
+		applier.applyChunk(block->chunk);
+		applying.items += block->chunk.records;
+		emptyBlocks.push(block);
+		if (journal.getPendingEntries() >= BATCH_JOURNAL_GROUP)
+		{
+			journal.takePending(group);
+			journalGroups.push(std::move(group));
+		}
+	}
+	journal.takePending(group);
+	journalGroups.push(std::move(group));
+	journalGroups.close();
+	applying.busySeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	reader.join();
+	parser.join();
+	journalWriter.join();
+	journal.setSyncBatchSize(BATCH_JOURNAL_GROUP);
+	if (descriptor != 0)
+		::close(descriptor);
+
+	reading.waitSeconds = emptyBlocks.getPopWaitSeconds() + readBlocks.getPushWaitSeconds();
+	parsing.waitSeconds = readBlocks.getPopWaitSeconds() + parsedBlocks.getPushWaitSeconds();
+	applying.waitSeconds = parsedBlocks.getPopWaitSeconds() + journalGroups.getPushWaitSeconds();
+	journaling.waitSeconds = journalGroups.getPopWaitSeconds();
+	for (PipelineStage& stage : report.stages)
+		stage.busySeconds = max(0.0, stage.busySeconds - stage.waitSeconds);
+	report.queues[0] = { "read -> parse", readBlocks.averageOccupancy(), readBlocks.mostOccupancy(), readBlocks.capacity() };
+	report.queues[1] = { "parse -> apply", parsedBlocks.averageOccupancy(), parsedBlocks.mostOccupancy(),
+		parsedBlocks.capacity() };
+	report.queues[2] = { "apply -> journal", journalGroups.averageOccupancy(), journalGroups.mostOccupancy(),
+		journalGroups.capacity() };
+	if (readFailed)
+	{
+		cout << "Error: Could not read " << commandsName << ".\n";
+		return false;
+	}
+	return true;
+}
+
+//This function outputs how each stage of a pipelined batch run spent its time, and how full the queues between
+//them were. The slowest stage is the one with the least time waiting.
+//Parameters:	const PipelineReport& report - The report filled in by runBatchPipeline
+void static outputPipelineReport(const PipelineReport& report) {
+	cout << "  Pipeline stages:\n";
+	for (const PipelineStage& stage : report.stages)
+		cout << "    " << left << setw(9) << stage.name << right << setw(12) << stage.items << " " << left << setw(8)
+			<< stage.unit << right << setprecision(3) << stage.busySeconds << " s busy, " << stage.waitSeconds
+			<< " s waiting, " << setprecision(0) << stage.items / max(stage.busySeconds, 1e-9) << " " << stage.unit
+			<< "/s\n";
+	cout << "  Queue occupancy:\n";
+	for (const PipelineQueue& queue : report.queues)
+		cout << "    " << left << setw(17) << queue.name << right << setprecision(2) << queue.averageOccupancy
+			<< " on average, " << queue.mostOccupancy << " at most, of " << queue.capacity << "\n";
+	cout << setprecision(3);
+}
+
+//This function runs batch mode, applying every command in a file to a budget and saving it
+//If the budget file does not exist yet, a new budget is started
+//Parameters:	const string& budgetName - The budget file to update
+//				const string& commandsName - The file of commands, or - to read them from standard input
+//				int threadCount - The number of threads to read the file with, 0 uses one per core
+//				bool pipelined - true to read, parse, apply and journal the file in a pipeline instead, see
+//				runBatchPipeline
+//Returns:		0 if the budget was saved, 1 if it could not be loaded or saved
+int runBatch(const string& budgetName, const string& commandsName, int threadCount, bool pipelined) {
+	auto startTime = chrono::steady_clock::now();
+	CategoryStore categories;
+	Journal journal;
+	journal.setSyncBatchSize(BATCH_JOURNAL_GROUP);
+	if (!openOrCreateBudget(budgetName, categories, journal))
+		return 1;
+	bool snapshot = journal.isBudgetSnapshot();
+
+	long long allocationsBefore = allocationCount();
+	BatchApplier applier(categories, journal);
+	PipelineReport pipeline;
+	size_t threadsUsed;
+	if (pipelined)
+		threadsUsed = runBatchPipeline(commandsName, applier, categories, journal, pipeline) ? PIPELINE_STAGES : 0;
+	else
+	{
+		ThreadPool pool(threadCount);
+		threadsUsed = applyBatchFile(commandsName, pool, applier, categories);
+	}
+	if (threadsUsed == 0)
+		return 1;
+	long long allocations = allocationCount() - allocationsBefore;
+
+	vector<pair<long long, const char*>>& errors = applier.getErrors();
+	sort(errors.begin(), errors.end());
+	for (size_t i = 0; i < errors.size() && i < (size_t)BATCH_ERRORS_SHOWN; i++)
+		cout << "Error: line " << errors[i].first << ": " << errors[i].second << ", skipped.\n";
+
+	bool saved = saveBudgetChanges(budgetName, categories, journal, snapshot);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	const BatchSummary& summary = applier.getSummary();
+	cout << "Processed " << summary.records << " records in " << fixed << setprecision(3) << seconds << " seconds"
+		<< " using " << threadsUsed << " threads\n"
+		<< "  Deposits:             " << summary.deposits << " totalling " << toDecimalString(summary.depositTotal) << "\n"
+		<< "  Category adjustments: " << summary.adjustments << "\n"
+		<< "  Categories created:   " << summary.created << "\n"
+		<< "  Categories removed:   " << summary.removed << "\n"
+		<< "  Percentage changes:   " << summary.percentageChanges << "\n"
+		<< "  Errors:               " << summary.errors << "\n"
+		<< "  Total balance:        " << toDecimalString(categories.getBalance(0)) << "\n";
+#ifdef BUDGET_COUNT_ALLOCATIONS
+	cout << "  Allocations:          " << allocations << " (" << setprecision(2)
+		<< (double)allocations / max(1LL, summary.records) << " per record)\n";
+#else
+	(void)allocations;
+#endif
+	if (pipelined)
+		outputPipelineReport(pipeline);
+	if (saved)
+		cout << "Saved " << budgetName << "\n";
+	return saved ? 0 : 1;
+}
+
+//This function runs report mode, writing a report of a budget without changing it
+//Changes still waiting in the budget's journal are included, but the journal is left as it is
+//Parameters:	const string& budgetName - The budget file to report on
+//				const ReportOptions& options - The format, and which categories to include
+//				const string& outputName - The file to write the report to, or - for the screen
+//Returns:		0 if the report was written, 1 if the budget could not be loaded or the report could not be written
+int runReport(const string& budgetName, const ReportOptions& options, const string& outputName) {
+	CategoryStore categories;
+	bool snapshot;
+	int entriesReplayed;
+	size_t validLength;
+	if (!loadBudget(budgetName, categories, snapshot, entriesReplayed, validLength))
+		return 1;
+
+	if (outputName == "-")
+	{
+		ReportWriter writer(cout);
+		renderReport(categories, options, writer);
+		return 0;
+	}
+	fstream file(outputName, ios::out | ios::binary | ios::trunc);
+	{
+		ReportWriter writer(file);
+		renderReport(categories, options, writer);
+	}
+	if (!file)
+	{
+		cout << "Error: Could not write " << outputName << ".\n";
+		return 1;
+	}
+	return 0;
+}
+
+//This function finds the date of a day counted from 1970-01-01, the reverse of daysFromCivil
+//Parameters:	int64_t days - The day
+//				int& year, int& month, int& day - Receive the date
+void civilFromDays(int64_t days, int& year, int& month, int& day) {
+	days += 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	int64_t dayOfEra = days - era * 146097;
+	int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	int64_t shiftedMonth = (5 * dayOfYear + 2) / 153; //Counted from March
+	day = (int)(dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+	month = (int)(shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+	year = (int)(yearOfEra + era * 400 + (month <= 2));
+}
+
+//This function writes a day counted from 1970-01-01 as YYYY-MM-DD
+//Parameters:	int64_t days - The day
+//Returns:		The date
+string formatDay(int64_t days) {
+	int year, month, day;
+	civilFromDays(days, year, month, day);
+	char text[16];
+	snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, day);
+	return text;
+}
+
+//This function finds the day a schedule is due after the day it was last due
+//A monthly schedule falls on its day of the month, or the last day of a month too short for it
+//Parameters:	const Schedule& schedule - The schedule, with nextDay being the day it was last due
+//Returns:		The next day it is due, or -1 if it is only due once
+int64_t nextScheduleDay(const Schedule& schedule) {
+	if (schedule.unit == SCHEDULE_ONCE)
+		return -1;
+	if (schedule.unit == SCHEDULE_DAYS)
+		return schedule.nextDay + schedule.every;
+	int year, month, day;
+	civilFromDays(schedule.nextDay, year, month, day);
+	int monthCount = year * 12 + (month - 1) + schedule.every;
+	year = monthCount / 12;
+	month = monthCount % 12 + 1;
+	int monthLength = (int)(daysFromCivil(month == 12 ? year + 1 : year, month == 12 ? 1 : month + 1, 1)
+		- daysFromCivil(year, month, 1));
+	return daysFromCivil(year, month, min(schedule.dayOfMonth, monthLength));
+}
+
+//This function reads how often a schedule repeats: once, daily, weekly, monthly, or a number followed by d for
+//days or m for months (such as 14d or 3m)
+//Parameters:	string_view text - How often it repeats
+//				Schedule& schedule - Receives the unit and count
+//Returns:		false if the text is not understood
+bool static parseScheduleRepeat(string_view text, Schedule& schedule) {
+	schedule.every = 1;
+	if (text == "once")
+		schedule.unit = SCHEDULE_ONCE;
+	else if (text == "daily")
+		schedule.unit = SCHEDULE_DAYS;
+	else if (text == "weekly")
+	{
+		schedule.unit = SCHEDULE_DAYS;
+		schedule.every = 7;
+	}
+	else if (text == "monthly")
+		schedule.unit = SCHEDULE_MONTHS;
+	else if (text.size() >= 2 && (text.back() == 'd' || text.back() == 'm')
+		&& parseBatchID(text.substr(0, text.size() - 1), schedule.every) && schedule.every > 0)
+		schedule.unit = text.back() == 'd' ? SCHEDULE_DAYS : SCHEDULE_MONTHS;
+	else
+		return false;
+	return true;
+}
+
+//This function returns today's day, counted from 1970-01-01 in UTC
+int64_t currentDay() {
+	return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count() / 86400;
+}
+
+//This function applies every schedule of a budget that has come due, then saves the schedules
+//The journal is committed before the schedules are saved, so a crash can not lose a change the schedules
+//count as applied
+//Parameters:	const string& budgetName - The budget file
+//				int64_t toDay - The day to apply the schedules through
+//				CategoryStore& categories - The store of budget categories, loaded from the file
+//				Journal& journal - The journal of the budget
+//				ScheduleSummary& summary - Receives what was applied
+//Returns:		false if the schedules could not be loaded or saved, after outputting an error
+bool applyDueSchedules(const string& budgetName, int64_t toDay, CategoryStore& categories, Journal& journal,
+	ScheduleSummary& summary) {
+	if (!filesystem::exists(budgetName + ".schedules"))
+		return true;
+	ScheduleBook book;
+	if (!book.load(budgetName, toDay))
+		return false;
+	if (book.getAppliedThrough() >= toDay)
+		return true;
+	book.advance(toDay, categories, journal, summary);
+	journal.commit();
+	return book.save(budgetName);
+}
+
+//This function outputs what applying the schedules did, if anything
+//Parameters:	const ScheduleSummary& summary - What was applied
+//				int64_t toDay - The day the schedules were applied through
+void outputScheduleSummary(const ScheduleSummary& summary, int64_t toDay) {
+	if (summary.deposits + summary.additions + summary.skipped == 0)
+		return;
+	cout << "Scheduled changes applied through " << formatDay(toDay) << ": " << summary.deposits
+		<< " deposits totalling " << toDecimalString(summary.depositTotal) << ", " << summary.additions
+		<< " category adjustments";
+	if (summary.skipped > 0)
+		cout << ", " << summary.skipped << " skipped as their category no longer exists";
+	cout << ".\n";
+}
+
+//This function adds a schedule to a budget, from the command line
+//Parameters:	const string& budgetName - The budget file
+//				const string& target - deposit, or the ID or name of the category to add to
+//				const string& amount - The amount each time it is due, negative to take money away
+//				const string& firstDate - The first day it is due, YYYY-MM-DD
+//				const string& repeat - How often it repeats, see parseScheduleRepeat
+//Returns:		0 if the schedule was added, otherwise 1 after outputting an error
+int runAddSchedule(const string& budgetName, const string& target, const string& amount,
+	const string& firstDate, const string& repeat) {
+	CategoryStore categories;
+	bool snapshot;
+	int entriesReplayed;
+	size_t validLength;
+	if (!loadBudget(budgetName, categories, snapshot, entriesReplayed, validLength))
+		return 1;
+
+	Schedule schedule;
+	long long hundredths;
+	int64_t startTime;
+	if (target != "deposit" && (!resolveBatchID(target, categories, schedule.target)
+		|| categories.indexOf(schedule.target) <= 0))
+	{
+		cout << "Error: No category other than main is " << target << ".\n";
+		return 1;
+	}
+	if (!parseBatchHundredths(amount, hundredths))
+	{
+		cout << "Error: " << amount << " is not a valid amount.\n";
+		return 1;
+	}
+	if (!parseDate(firstDate, startTime))
+	{
+		cout << "Error: " << firstDate << " is not a valid date.\n";
+		return 1;
+	}
+	if (!parseScheduleRepeat(repeat, schedule))
+	{
+		cout << "Error: Expected once, daily, weekly, monthly, or a number of days or months such as 14d or 3m.\n";
+		return 1;
+	}
+	schedule.amount = hundredths;
+	schedule.nextDay = startTime / 86400;
+	int year, month;
+	civilFromDays(schedule.nextDay, year, month, schedule.dayOfMonth);
+
+	ScheduleBook book;
+	if (!book.load(budgetName, currentDay()))
+		return 1;
+	if (schedule.nextDay <= book.getAppliedThrough())
+	{
+		cout << "Error: The schedules have already been applied through " << formatDay(book.getAppliedThrough())
+			<< ", the first date must be after it.\n";
+		return 1;
+	}
+	book.add(schedule);
+	if (!book.save(budgetName))
+		return 1;
+	cout << "Scheduled " << (schedule.target == 0 ? "deposit" : "addition") << " of " << toDecimalString(schedule.amount)
+		<< " starting " << formatDay(schedule.nextDay) << ", " << book.size() << " schedules in " << budgetName
+		<< ".schedules\n";
+	return 0;
+}
+
+//This function applies the schedules of a budget up to a day, then saves the budget, from the command line
+//Parameters:	const string& budgetName - The budget file
+//				int64_t toDay - The day to apply the schedules through, which can be in the future to simulate it
+//Returns:		0 if the budget was saved, otherwise 1 after outputting an error
+int runAdvance(const string& budgetName, int64_t toDay) {
+	CategoryStore categories;
+	Journal journal;
+	journal.setSyncBatchSize(BATCH_JOURNAL_GROUP);
+	if (!openBudget(budgetName, categories, journal))
+		return 1;
+	ScheduleSummary summary;
+	if (!applyDueSchedules(budgetName, toDay, categories, journal, summary))
+		return 1;
+	outputScheduleSummary(summary, toDay);
+	if (!saveBudgetChanges(budgetName, categories, journal, journal.isBudgetSnapshot()))
+		return 1;
+	cout << "Saved " << budgetName << "\n";
+	return 0;
+}
+
+//This function reads the rules of a budget's categories into a solver
+//Each line is <category ID or name> <rule> <value> [date], separated by commas or spaces, see the rules above.
+//A category can have several lines, and lines starting with # are skipped.
+//Parameters:	const string& rulesName - The file of rules
+//				const CategoryStore& categories - The budget the rules are for
+//				int64_t today - The day targets are counted from
+//				PercentageSolver& solver - Receives the rules
+//Returns:		The number of rules read, or -1 after outputting an error
+int static loadPercentageRules(const string& rulesName, const CategoryStore& categories, int64_t today,
+	PercentageSolver& solver) {
+	vector<char> buffer;
+	if (!readWholeFile(rulesName, buffer))
+		return -1;
+	vector<CategoryRule> rules(categories.size());
+	vector<bool> hasRule(categories.size());
+	vector<string_view> fields;
+	const char* row = buffer.data();
+	const char* fileEnd = buffer.data() + buffer.size();
+	int line = 0;
+	int ruleCount = 0;
+	while (row < fileEnd)
+	{
+		const char* rowEnd = (const char*)memchr(row, '\n', fileEnd - row);
+		if (rowEnd == nullptr)
+			rowEnd = fileEnd;
+		const char* next = rowEnd + (rowEnd < fileEnd);
+		if (rowEnd > row && rowEnd[-1] == '\r')
+			rowEnd--;
+		splitBatchFields(row, rowEnd, fields);
+		row = next;
+		line++;
+		if (fields.empty() || fields[0][0] == '#')
+			continue;
+
+		int id;
+		int index = -1;
+		long long value = 0;
+		if (resolveBatchID(fields[0], categories, id))
+			index = categories.indexOf(id);
+		if (index <= 0)
+		{
+			cout << "Error: Line " << line << " of " << rulesName << " is not for a category other than main.\n";
+			return -1;
+		}
+		CategoryRule& rule = rules[index];
+		string_view kind = fields.size() >= 3 ? fields[1] : "";
+		int64_t targetTime;
+		bool valid = fields.size() == (kind == "target" ? 4u : 3u);
+		if (valid && kind == "priority")
+			valid = parseBatchID(fields[2], rule.priority);
+		else if (valid && kind == "weight")
+			valid = parseBatchID(fields[2], rule.weight) && rule.weight >= 0 && rule.weight <= ONE_HUNDRED_PERCENT;
+		else if (!valid || !parseBatchHundredths(fields[2], value) || value < 0)
+			valid = false;
+		else if (kind == "amount")
+		{
+			rule.monthlyAmount += value;
+			rule.hasAmount = true;
+		}
+		else if (kind == "target" && parseDate(string(fields[3]), targetTime))
+		{
+			//The money still needed is spread over the months left, at least one
+			int year, month, day, targetYear, targetMonth;
+			civilFromDays(today, year, month, day);
+			civilFromDays(targetTime / 86400, targetYear, targetMonth, day);
+			long long months = max(1, (targetYear - year) * 12 + targetMonth - month);
+			Money needed = max((Money)0, value - categories.getBranchTotal(index));
+			rule.monthlyAmount += (needed + months - 1) / months;
+			rule.hasAmount = true;
+		}
+		else if ((kind == "min" || kind == "max") && value <= ONE_HUNDRED_PERCENT)
+			(kind == "min" ? rule.minPercent : rule.maxPercent) = (BasisPoints)value;
+		else
+			valid = false;
+		if (!valid || rule.minPercent > rule.maxPercent)
+		{
+			cout << "Error: Line " << line << " of " << rulesName << " is not a valid rule.\n";
+			return -1;
+		}
+		hasRule[index] = true;
+		ruleCount++;
+	}
+	for (int i = 1; i < categories.size(); i++)
+		if (hasRule[i])
+			solver.setRule(i, rules[i]);
+	return ruleCount;
+}
+
+//This function copies the percentages a solver changed into the store, and records them in the journal
+//Parameters:	const PercentageSolver& solver - The solver, after a solve that succeeded
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+void static applySolvedPercentages(const PercentageSolver& solver, CategoryStore& categories, Journal& journal) {
+	vector<char> pairs;
+	for (const pair<int, BasisPoints>& change : solver.getChanges())
+	{
+		categories.setPercentOfBudget(change.first, solver.getPercent(change.first));
+		putUndoValue<int32_t>(pairs, categories.getIDNumber(change.first));
+		putUndoValue<int32_t>(pairs, solver.getPercent(change.first));
+	}
+	updateMainPercentage(categories);
+	journal.recordPercentages(pairs.data(), pairs.size());
+}
+
+//This function sets a budget's percentages from a file of rules, from the command line
+//Parameters:	const string& budgetName - The budget file
+//				const string& rulesName - The file of rules
+//				Money monthlyIncome - The income expected each month, which amounts and targets are shares of
+//Returns:		0 if the budget was saved, otherwise 1 after outputting an error
+int runSolve(const string& budgetName, const string& rulesName, Money monthlyIncome) {
+	CategoryStore categories;
+	Journal journal;
+	if (!openBudget(budgetName, categories, journal))
+		return 1;
+	PercentageSolver solver(categories, monthlyIncome);
+	int ruleCount = loadPercentageRules(rulesName, categories, currentDay(), solver);
+	if (ruleCount == -1)
+		return 1;
+	int failed = solver.solveAll();
+	if (failed != -1)
+	{
+		cout << "Error: The rules for the categories under " << categories.getName(failed)
+			<< " cannot be met, their minimums add to more than 100% or their maximums to less.\n";
+		return 1;
+	}
+	applySolvedPercentages(solver, categories, journal);
+	if (!saveBudgetChanges(budgetName, categories, journal, journal.isBudgetSnapshot()))
+		return 1;
+	cout << "Solved " << ruleCount << " rules, changing the percentages of " << solver.getChanges().size()
+		<< " categories. Saved " << budgetName << "\n";
+	return 0;
+}
+
+const int FORECAST_RUNS_PER_TASK = 64; //Runs handed to a worker at a time
+
+//This function finds a percentile by nearest rank, putting the values partly in order
+//Parameters:	vector<Money>& values - The values, at least one
+//				int percent - The percentile to find
+//Returns:		The value at the percentile
+Money static percentileOf(vector<Money>& values, int percent) {
+	size_t rank = (size_t)llround((double)(values.size() - 1) * percent / 100);
+	nth_element(values.begin(), values.begin() + rank, values.end());
+	return values[rank];
+}
+
+//This function runs a forecast
+//Every run's final balances are kept until the end to find the percentiles, one row of the live categories each
+//Parameters:	const ForecastModel& model - The budget to forecast
+//				const ForecastOptions& options - The runs, months and distributions
+//				ThreadPool& pool - The workers to spread the runs over
+//				ForecastResult& result - Receives how each category fared
+void runForecastSimulations(const ForecastModel& model, const ForecastOptions& options, ThreadPool& pool,
+	ForecastResult& result) {
+	const CategoryStore& categories = model.store();
+	int numOfCategories = categories.size();
+	result = ForecastResult();
+	for (int i = 0; i < numOfCategories; i++)
+		if (categories.isLive(i))
+			result.rows.push_back(i);
+	size_t rowCount = result.rows.size();
+	int runs = max(1, options.runs);
+	vector<Money> finals((size_t)runs * rowCount);
+	int taskCount = (runs + FORECAST_RUNS_PER_TASK - 1) / FORECAST_RUNS_PER_TASK;
+	vector<vector<long long>> taskNegatives(taskCount);
+
+	pool.run(taskCount, [&](int task) {
+		vector<Money> balances(numOfCategories);
+		vector<Money> totals(numOfCategories);
+		vector<Money> shares(numOfCategories);
+		vector<char> wentNegative(numOfCategories);
+		vector<long long>& negatives = taskNegatives[task];
+		negatives.assign(numOfCategories, 0);
+		ScratchArena scratch;
+		int lastRun = min(runs, (task + 1) * FORECAST_RUNS_PER_TASK);
+		for (int run = task * FORECAST_RUNS_PER_TASK; run < lastRun; run++)
+		{
+			SyntheticRandom random(SyntheticRandom(options.seed ^ ((uint64_t)run * 0xD1B54A32D192ED03ULL)).next());
+			for (int i = 1; i < numOfCategories; i++)
+				balances[i] = categories.getBalance(i);
+			Money mainBalance = categories.getBalance(0);
+			fill(wentNegative.begin(), wentNegative.end(), 0);
+			for (int month = 0; month < options.months; month++)
+			{
+				mainBalance += model.split(options.income.draw(random), balances.data(), shares.data(), scratch);
+				mainBalance += model.split(-options.expenses.draw(random), balances.data(), shares.data(), scratch);
+				//Going backwards means every category's total is finished before its parent's is reached
+				copy(balances.begin(), balances.end(), totals.begin());
+				for (int i = numOfCategories - 1; i >= 2; i--)
+					if (categories.getParentIndex(i) > 0)
+						totals[categories.getParentIndex(i)] += totals[i];
+				totals[0] = mainBalance;
+				for (int i = 0; i < numOfCategories; i++)
+					wentNegative[i] |= totals[i] < 0;
+			}
+			Money* finalBalances = &finals[(size_t)run * rowCount];
+			for (size_t row = 0; row < rowCount; row++)
+			{
+				finalBalances[row] = totals[result.rows[row]];
+				negatives[result.rows[row]] += wentNegative[result.rows[row]];
+			}
+		}
+	});
+
+	vector<Money> column(runs);
+	for (size_t row = 0; row < rowCount; row++)
+	{
+		for (int run = 0; run < runs; run++)
+			column[run] = finals[(size_t)run * rowCount + row];
+		result.low.push_back(percentileOf(column, 5));
+		result.median.push_back(percentileOf(column, 50));
+		result.high.push_back(percentileOf(column, 95));
+		long long negativeRuns = 0;
+		for (const vector<long long>& negatives : taskNegatives)
+			negativeRuns += negatives[result.rows[row]];
+		result.negativeRuns.push_back(negativeRuns);
+	}
+}
+
+//This function reads how a monthly amount is drawn
+//Parameters:	const string& text - <amount>, normal:<mean>,<standard deviation> or uniform:<low>,<high>
+//				AmountDistribution& distribution - Receives the distribution
+//Returns:		false if the text is not a distribution
+bool parseAmountDistribution(const string& text, AmountDistribution& distribution) {
+	size_t colon = text.find(':');
+	if (colon == string::npos)
+	{
+		distribution.kind = DISTRIBUTION_FIXED;
+		return parseBatchHundredths(text, distribution.first);
+	}
+	string kind = text.substr(0, colon);
+	if (kind == "normal")
+		distribution.kind = DISTRIBUTION_NORMAL;
+	else if (kind == "uniform")
+		distribution.kind = DISTRIBUTION_UNIFORM;
+	else
+		return false;
+	size_t comma = text.find(',', colon);
+	return comma != string::npos && parseBatchHundredths(string_view(text).substr(colon + 1, comma - colon - 1),
+		distribution.first) && parseBatchHundredths(string_view(text).substr(comma + 1), distribution.second)
+		&& distribution.second >= 0;
+}
+
+//This function forecasts a budget from the command line, writing a table of how each category fared
+//Parameters:	const string& budgetName - The budget file, which is not changed
+//				const ForecastOptions& options - The runs, months and distributions
+//				const vector<pair<string, string>>& percentages - Categories (by ID or name) to give new
+//					percentages for the forecast only, to see what a different split would do
+//Returns:		0 if the forecast ran, otherwise 1 after outputting an error
+int runForecast(const string& budgetName, const ForecastOptions& options,
+	const vector<pair<string, string>>& percentages) {
+	CategoryStore categories;
+	bool snapshot;
+	int entriesReplayed;
+	size_t validLength;
+	if (!loadBudget(budgetName, categories, snapshot, entriesReplayed, validLength))
+		return 1;
+
+	for (const pair<string, string>& change : percentages)
+	{
+		int id;
+		long long percent;
+		if (!resolveBatchID(change.first, categories, id) || categories.indexOf(id) <= 0)
+		{
+			cout << "Error: No category other than main is " << change.first << ".\n";
+			return 1;
+		}
+		if (!parseBatchHundredths(change.second, percent) || percent < 0 || percent > ONE_HUNDRED_PERCENT)
+		{
+			cout << "Error: " << change.second << " is not a valid percentage.\n";
+			return 1;
+		}
+		assignPercentage(id, (BasisPoints)percent, categories);
+	}
+	int unbalanced = findUnbalancedGroup(categories);
+	if (unbalanced != -1)
+	{
+		cout << "Error: The categories under " << categories.getName(unbalanced)
+			<< " do not add up to 100%.\n";
+		return 1;
+	}
+	updateMainPercentage(categories);
+
+	ForecastModel model(categories);
+	ThreadPool pool(options.threadCount);
+	ForecastResult result;
+	auto start = chrono::steady_clock::now();
+	runForecastSimulations(model, options, pool, result);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	ReportWriter writer(cout);
+	writer.text("Forecast of ");
+	writer.number(options.runs);
+	writer.text(" runs over ");
+	writer.number(options.months);
+	writer.text(" months\n");
+	writer.text("ID |  Category    |   5th pct    |    Median    |   95th pct   | Negative % |\n");
+	for (size_t row = 0; row < result.rows.size(); row++)
+	{
+		int i = result.rows[row];
+		int depth = categories.getDepth(i);
+		writer.number(categories.getIDNumber(i), 2);
+		writer.text(" | ");
+		writer.padded(categories.getName(i), 12, false, depth > 1 ? 2 * (depth - 1) : 0);
+		writer.text(" | ");
+		writer.hundredths(result.low[row], 12);
+		writer.text(" | ");
+		writer.hundredths(result.median[row], 12);
+		writer.text(" | ");
+		writer.hundredths(result.high[row], 12);
+		writer.text(" | ");
+		writer.hundredths(result.negativeRuns[row] * ONE_HUNDRED_PERCENT / options.runs, 10);
+		writer.text(" |\n");
+	}
+	writer.text("Ran ");
+	writer.number(llround(options.runs / seconds));
+	writer.text(" simulations a second on ");
+	writer.number(pool.size());
+	writer.text(" threads\n");
+	return 0;
+}
@@ -0,0 +1,2869 @@
+//Name:			Budget Library
+//Description:	The budget categories and everything done to them, shared by BudgetProgram, its benchmarks
+//				and its tests. The store, file formats, journal, undo history, batch mode, schedules,
+//				percentage solver, forecasts, server and synthetic budgets are built as one library.
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <iomanip>
+#include <limits>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <cstdlib>
+#include <future>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+//The vectorized balance kernels are only built where the compiler supports x86 intrinsics
+//and runtime CPU detection, otherwise the scalar loops are used everywhere
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BUDGET_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//Money is kept as a whole number of cents, and percentages as basis points (hundredths of a percent)
+//Both are integers, so adding and splitting them is always exact and no rounding error builds up
+using Money = long long;
+using BasisPoints = int;
+const BasisPoints ONE_HUNDRED_PERCENT = 10000;
+
+//Defining BUDGET_COUNT_ALLOCATIONS counts every allocation made through new, so the allocations made by each
+//command can be measured. allocationCount returns 0 in a normal build.
+long long allocationCount();
+
+//Defining BUDGET_METRICS times the load, save, menu and balance operations. Each operation keeps a count, its
+//total and longest time, the allocations made during it, and a histogram of its times. The histogram has 16
+//buckets for each power of two nanoseconds (like HDR Histogram), so any time is placed within 6.25% of its value
+//using only a few bit operations. Everything is updated with relaxed atomics, so server threads can share it.
+//The metrics are written as Prometheus text or JSON on demand, and at exit to the file named by the
+//BUDGET_METRICS_FILE environment variable. Without BUDGET_METRICS, METRIC_SCOPE compiles to nothing.
+enum MetricID {
+	METRIC_LOAD_TEXT,
+	METRIC_LOAD_SNAPSHOT,
+	METRIC_REPLAY_JOURNAL,
+	METRIC_SAVE_TEXT,
+	METRIC_SAVE_SNAPSHOT,
+	METRIC_JOURNAL_COMMIT,
+	METRIC_RENDER_REPORT,
+	METRIC_MODIFY_BALANCE,
+	METRIC_SPLIT_DOWN_TREE,
+	METRIC_ADD_TO_CATEGORY,
+	METRIC_CREATE_CATEGORY,
+	METRIC_REMOVE_CATEGORY,
+	METRIC_CHECK_PERCENTAGES,
+	METRIC_HISTORY_QUERY,
+	METRIC_BATCH_PARSE,
+	METRIC_BATCH_APPLY,
+	METRIC_SERVER_COMMAND,
+	METRIC_COUNT
+};
+
+#ifdef BUDGET_METRICS
+void recordMetric(MetricID id, long long nanoseconds, long long allocations);
+
+//Times everything from its creation to the end of the enclosing block as one run of an operation
+class MetricScope {
+	MetricID id;
+	chrono::steady_clock::time_point start;
+	long long allocationsBefore;
+public:
+	explicit MetricScope(MetricID id) : id(id), start(chrono::steady_clock::now()),
+		allocationsBefore(allocationCount()) {
+	}
+	~MetricScope() {
+		long long nanoseconds = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+		recordMetric(id, nanoseconds, allocationCount() - allocationsBefore);
+	}
+	MetricScope(const MetricScope&) = delete;
+	MetricScope& operator=(const MetricScope&) = delete;
+};
+#define METRIC_SCOPE(id) MetricScope metricScope(id)
+string formatMetrics(bool json);
+#else
+#define METRIC_SCOPE(id)
+string formatMetrics(bool);
+#endif
+
+void writeMetricsFile();
+uint64_t fnv1a(const char* data, size_t length);
+
+//The balance history keeps every change to every category's balance along with the time it was made, so past
+//balances can be looked up. Each category's changes are packed one after another: the seconds since its
+//previous change, then the amount, each as a variable length number, so most changes take only a few bytes.
+//Every HISTORY_BLOCK_ENTRIES changes start a new block, and each block keeps a checkpoint of the balance before
+//it and the money that came in and went out during it. Finding a balance on a date is a binary search over the
+//blocks and then a read of one block, and totals over a range add up whole blocks, only reading the blocks at
+//either end of the range.
+//The history is kept next to the budget file in <budget file>.history, which is only ever added to, in blocks
+//of [uint32 length][int64 time, then ID, time change and amount for each change][uint32 checksum].
+//Times are whole seconds since 1970 (UTC).
+//The history is written along with each group of journal entries but not flushed to disk, so after a crash it can
+//be behind the journal. attachHistory then records whatever is missing as one change per category, made at the
+//time the budget is next loaded.
+const int HISTORY_BLOCK_ENTRIES = 128;
+const char HISTORY_MAGIC[8] = { 'B', 'U', 'D', 'G', 'H', 'I', 'S', 'T' };
+const size_t HISTORY_WRITE_SIZE = 1 << 20; //Changes written to the file at once when it is rewritten whole
+
+//The money that came in and went out of a category over a range of time
+struct HistoryFlows {
+	Money inflow = 0;
+	Money outflow = 0; //Negative, or 0 if nothing went out
+};
+
+//A checkpoint at the start of a block of changes
+struct HistoryBlock {
+	int64_t firstTime; //Time of the first change in the block
+	int64_t lastTime; //Time of the last change in the block
+	Money balanceBefore; //Balance before the first change in the block
+	HistoryFlows flows; //Everything that came in and went out during the block
+	size_t offset; //Where the block starts in the packed changes
+};
+
+//Every change ever made to one category's balance
+struct CategoryHistory {
+	vector<uint8_t> changes; //The packed changes of every block, in order
+	vector<HistoryBlock> blocks;
+	Money balance = 0; //Balance after the last change
+	int64_t lastTime = 0;
+	int entriesInBlock = 0;
+};
+
+class BalanceHistory {
+	unordered_map<int, CategoryHistory> histories; //By category ID, kept after a category is removed
+	size_t entries = 0;
+	int fileDescriptor = -1;
+	string budgetName; //The budget file the history belongs to
+	vector<uint8_t> pending; //A block of changes waiting to be written to the file
+	int64_t pendingTime = 0; //Time of the last change in the pending block
+
+	static void putVarint(vector<uint8_t>& out, uint64_t value) {
+		while (value >= 0x80)
+		{
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((uint8_t)value);
+	}
+	//Reads a variable length number, returning false if it runs past the end
+	static bool getVarint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+		value = 0;
+		for (int shift = 0; cursor < end && shift < 64; shift += 7)
+		{
+			uint8_t byte = *cursor++;
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (byte < 0x80)
+				return true;
+		}
+		return false;
+	}
+	//Signed numbers are stored with the sign in the lowest bit, so small negative amounts stay small
+	static uint64_t toZigzag(int64_t value) {
+		return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	}
+	static int64_t fromZigzag(uint64_t value) {
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+	static int64_t currentTime() {
+		return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+	}
+	//Returns one past the last packed change of a block
+	static size_t blockEnd(const CategoryHistory& history, size_t block) {
+		return block + 1 < history.blocks.size() ? history.blocks[block + 1].offset : history.changes.size();
+	}
+
+	//Adds a change to a category's history in memory, starting a new block when the last one is full
+	void append(int id, int64_t time, Money amount) {
+		CategoryHistory& history = histories[id];
+		if (time < history.lastTime)
+			time = history.lastTime; //The clock went backwards, keep the changes in order
+		if (history.blocks.empty() || history.entriesInBlock == HISTORY_BLOCK_ENTRIES)
+		{
+			history.blocks.push_back({ time, time, history.balance, HistoryFlows(), history.changes.size() });
+			history.entriesInBlock = 0;
+			history.lastTime = time;
+		}
+		putVarint(history.changes, (uint64_t)(time - history.lastTime));
+		putVarint(history.changes, toZigzag(amount));
+
+		HistoryBlock& block = history.blocks.back();
+		block.lastTime = time;
+		if (amount > 0)
+			block.flows.inflow += amount;
+		else
+			block.flows.outflow += amount;
+		history.balance += amount;
+		history.lastTime = time;
+		history.entriesInBlock++;
+		entries++;
+	}
+	//Adds a change to the block waiting to be written to the file
+	void appendPending(int id, int64_t time, Money amount) {
+		if (pending.empty())
+		{
+			pending.resize(sizeof(uint32_t) + sizeof(int64_t)); //The length is filled in by commit
+			memcpy(&pending[sizeof(uint32_t)], &time, sizeof(int64_t));
+			pendingTime = time;
+		}
+		putVarint(pending, (uint64_t)id);
+		putVarint(pending, toZigzag(time - pendingTime));
+		putVarint(pending, toZigzag(amount));
+		pendingTime = time;
+	}
+	//Opens the history file for appending, cutting off anything after the valid length
+	bool openFile(const string& fileName, size_t validLength) {
+		string historyName = fileName + ".history";
+		int flags = O_WRONLY | O_CREAT;
+#ifdef _WIN32
+		flags |= O_BINARY;
+#endif
+		fileDescriptor = ::open(historyName.c_str(), flags, 0644);
+		if (fileDescriptor == -1)
+		{
+			cout << "Error: Could not open the history " << historyName << ", balance history will not be saved.\n";
+			return false;
+		}
+		if (validLength < sizeof(HISTORY_MAGIC))
+			validLength = 0;
+		error_code resizeError;
+		filesystem::resize_file(historyName, validLength, resizeError);
+		lseek(fileDescriptor, (long)validLength, SEEK_SET);
+		if (validLength == 0 && write(fileDescriptor, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != sizeof(HISTORY_MAGIC))
+			cout << "Error: Could not write to the history of " << fileName << ".\n";
+		return true;
+	}
+public:
+	~BalanceHistory() {
+		close();
+	}
+	bool isOpen() const {
+		return fileDescriptor != -1;
+	}
+	const string& getBudgetName() const {
+		return budgetName;
+	}
+	//Returns the number of changes in the history
+	size_t entryCount() const {
+		return entries;
+	}
+
+	//Loads the history of a budget file and opens it to record new changes
+	//Loading stops at the first block that is cut off or fails its checksum, which is then cut off the file
+	//Parameters:	const string& fileName - The budget file the history belongs to
+	//Returns:		false if the history file could not be opened, after outputting an error
+	bool load(const string& fileName) {
+		close();
+		histories.clear();
+		entries = 0;
+		budgetName = fileName;
+
+		vector<char> buffer;
+		ifstream file(fileName + ".history", ios::in | ios::binary);
+		if (file.is_open())
+			buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		file.close();
+
+		size_t position = 0;
+		vector<pair<int, Money>> blockChanges;
+		vector<int64_t> blockTimes;
+		if (buffer.size() >= sizeof(HISTORY_MAGIC) && memcmp(buffer.data(), HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) == 0)
+		{
+			position = sizeof(HISTORY_MAGIC);
+			while (position + sizeof(uint32_t) <= buffer.size())
+			{
+				uint32_t length;
+				memcpy(&length, &buffer[position], sizeof(uint32_t));
+				const char* block = &buffer[position + sizeof(uint32_t)];
+				size_t blockEnd = position + sizeof(uint32_t) + (size_t)length + sizeof(uint32_t);
+				uint32_t checksum;
+				if (length < sizeof(int64_t) || blockEnd > buffer.size())
+					break;
+				memcpy(&checksum, block + length, sizeof(uint32_t));
+				if (checksum != (uint32_t)fnv1a(block, length))
+					break;
+
+				//Read the whole block before adding any of it, in case it does not decode
+				int64_t time;
+				memcpy(&time, block, sizeof(int64_t));
+				const uint8_t* cursor = (const uint8_t*)block + sizeof(int64_t);
+				const uint8_t* end = (const uint8_t*)block + length;
+				uint64_t id = 0, timeChange = 0, amount = 0;
+				bool valid = true;
+				blockChanges.clear();
+				blockTimes.clear();
+				while (cursor < end && valid)
+				{
+					valid = getVarint(cursor, end, id) && getVarint(cursor, end, timeChange)
+						&& getVarint(cursor, end, amount);
+					time += fromZigzag(timeChange);
+					blockChanges.emplace_back((int)id, fromZigzag(amount));
+					blockTimes.push_back(time);
+				}
+				if (!valid)
+					break;
+				for (size_t i = 0; i < blockChanges.size(); i++)
+					append(blockChanges[i].first, blockTimes[i], blockChanges[i].second);
+				position = blockEnd;
+			}
+		}
+		return openFile(fileName, position);
+	}
+
+	//Writes the whole history next to a different budget file, which is then used to record new changes
+	//Parameters:	const string& fileName - The budget file the history now belongs to
+	void moveTo(const string& fileName) {
+		close();
+		budgetName = fileName;
+		if (!openFile(fileName, 0))
+			return;
+		for (const auto& entry : histories)
+		{
+			const CategoryHistory& history = entry.second;
+			const uint8_t* cursor = history.changes.data();
+			const uint8_t* end = cursor + history.changes.size();
+			uint64_t timeChange, amount;
+			for (size_t block = 0; block < history.blocks.size(); block++)
+			{
+				int64_t time = history.blocks[block].firstTime;
+				while (cursor < end && cursor < history.changes.data() + blockEnd(history, block))
+				{
+					getVarint(cursor, end, timeChange);
+					getVarint(cursor, end, amount);
+					time += (int64_t)timeChange;
+					appendPending(entry.first, time, fromZigzag(amount));
+					if (pending.size() >= HISTORY_WRITE_SIZE)
+						commit();
+				}
+			}
+		}
+		commit();
+	}
+
+	//Adds a change to a category's balance to the history, made now
+	//Parameters:	int id - The ID of the category
+	//				Money amount - The change to its balance
+	void record(int id, Money amount) {
+		recordAt(id, currentTime(), amount);
+	}
+	//Adds a change to a category's balance to the history, made at a given time
+	//A time before the category's latest change is counted as made with it, so its changes stay in order
+	//Parameters:	int id - The ID of the category
+	//				int64_t time - When the change was made
+	//				Money amount - The change to its balance
+	void recordAt(int id, int64_t time, Money amount) {
+		append(id, time, amount);
+		if (fileDescriptor != -1)
+			appendPending(id, time, amount);
+	}
+
+	//Writes the pending changes to the history file, without flushing it to disk
+	void commit() {
+		if (fileDescriptor != -1 && !pending.empty())
+		{
+			uint32_t length = (uint32_t)(pending.size() - sizeof(uint32_t));
+			memcpy(pending.data(), &length, sizeof(uint32_t));
+			uint32_t checksum = (uint32_t)fnv1a((const char*)pending.data() + sizeof(uint32_t), length);
+			const uint8_t* checksumBytes = (const uint8_t*)&checksum;
+			pending.insert(pending.end(), checksumBytes, checksumBytes + sizeof(uint32_t));
+			if (write(fileDescriptor, pending.data(), (unsigned int)pending.size()) != (long)pending.size())
+				cout << "Error: Could not write to the history of " << budgetName << ".\n";
+		}
+		pending.clear();
+	}
+
+	void close() {
+		if (fileDescriptor == -1)
+			return;
+		commit();
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+
+	//Returns the ID of every category with a history, including removed categories
+	vector<int> categoryIDs() const {
+		vector<int> ids;
+		ids.reserve(histories.size());
+		for (const auto& entry : histories)
+			ids.push_back(entry.first);
+		return ids;
+	}
+	//Returns the balance of a category after its latest change, 0 if it has no history
+	Money getBalance(int id) const {
+		auto found = histories.find(id);
+		return found == histories.end() ? 0 : found->second.balance;
+	}
+
+	//Finds the balance of a category at a point in time
+	//Parameters:	int id - The ID of the category
+	//				int64_t time - The time, every change made at or before it is counted
+	//Returns:		The balance, 0 if the category had no changes by then
+	Money balanceAt(int id, int64_t time) const {
+		METRIC_SCOPE(METRIC_HISTORY_QUERY);
+		auto found = histories.find(id);
+		if (found == histories.end())
+			return 0;
+		const CategoryHistory& history = found->second;
+
+		//The last block starting at or before the time holds the answer
+		auto after = upper_bound(history.blocks.begin(), history.blocks.end(), time,
+			[](int64_t value, const HistoryBlock& block) { return value < block.firstTime; });
+		if (after == history.blocks.begin())
+			return 0;
+		size_t block = (after - history.blocks.begin()) - 1;
+		const HistoryBlock& checkpoint = history.blocks[block];
+		if (checkpoint.lastTime <= time)
+			return checkpoint.balanceBefore + checkpoint.flows.inflow + checkpoint.flows.outflow;
+
+		Money balance = checkpoint.balanceBefore;
+		int64_t changeTime = checkpoint.firstTime;
+		const uint8_t* cursor = history.changes.data() + checkpoint.offset;
+		const uint8_t* end = history.changes.data() + blockEnd(history, block);
+		uint64_t timeChange, amount;
+		while (getVarint(cursor, end, timeChange) && getVarint(cursor, end, amount))
+		{
+			changeTime += (int64_t)timeChange;
+			if (changeTime > time)
+				break;
+			balance += fromZigzag(amount);
+		}
+		return balance;
+	}
+
+	//Adds up the money that came in and went out of a category over a range of time
+	//Parameters:	int id - The ID of the category
+	//				int64_t from - The start of the range
+	//				int64_t to - The end of the range, changes made at this time are not counted
+	//Returns:		The money in and out
+	HistoryFlows flowsBetween(int id, int64_t from, int64_t to) const {
+		METRIC_SCOPE(METRIC_HISTORY_QUERY);
+		HistoryFlows flows;
+		auto found = histories.find(id);
+		if (found == histories.end())
+			return flows;
+		const CategoryHistory& history = found->second;
+
+		//Skip every block that ended before the range
+		auto first = lower_bound(history.blocks.begin(), history.blocks.end(), from,
+			[](const HistoryBlock& block, int64_t value) { return block.lastTime < value; });
+		for (size_t block = first - history.blocks.begin(); block < history.blocks.size(); block++)
+		{
+			const HistoryBlock& checkpoint = history.blocks[block];
+			if (checkpoint.firstTime >= to)
+				break;
+			if (checkpoint.firstTime >= from && checkpoint.lastTime < to)
+			{
+				flows.inflow += checkpoint.flows.inflow;
+				flows.outflow += checkpoint.flows.outflow;
+				continue;
+			}
+
+			//The block is only partly in the range, so read its changes
+			int64_t changeTime = checkpoint.firstTime;
+			const uint8_t* cursor = history.changes.data() + checkpoint.offset;
+			const uint8_t* end = history.changes.data() + blockEnd(history, block);
+			uint64_t timeChange, amount;
+			while (getVarint(cursor, end, timeChange) && getVarint(cursor, end, amount))
+			{
+				changeTime += (int64_t)timeChange;
+				if (changeTime < from)
+					continue;
+				if (changeTime >= to)
+					break;
+				Money change = fromZigzag(amount);
+				if (change > 0)
+					flows.inflow += change;
+				else
+					flows.outflow += change;
+			}
+		}
+		return flows;
+	}
+};
+
+//Category names are copied into large blocks of memory that never move, so a view of a name stays valid while
+//more names are added. Each name is followed by a 0, so it can be printed as a C string.
+//The blocks are shared, so a copy of the names made elsewhere can keep them alive after the arena lets them go.
+const size_t NAME_BLOCK_SIZE = 64 * 1024;
+class NameArena {
+	vector<shared_ptr<char[]>> blocks;
+	size_t used = NAME_BLOCK_SIZE; //Bytes used in the last block, full until the first block is made
+	size_t totalBytes = 0;
+public:
+	//Copies a name into the arena
+	//Returns:		A view of the copy, valid until the arena is cleared
+	string_view intern(string_view name) {
+		size_t needed = name.size() + 1;
+		char* copy;
+		if (needed > NAME_BLOCK_SIZE)
+		{
+			//A name too long for a block gets a block of its own, and the next name starts a new block
+			blocks.push_back(shared_ptr<char[]>(new char[needed]));
+			copy = blocks.back().get();
+			used = NAME_BLOCK_SIZE;
+		}
+		else
+		{
+			if (used + needed > NAME_BLOCK_SIZE)
+			{
+				blocks.push_back(shared_ptr<char[]>(new char[NAME_BLOCK_SIZE]));
+				used = 0;
+			}
+			copy = blocks.back().get() + used;
+			used += needed;
+		}
+		memcpy(copy, name.data(), name.size());
+		copy[name.size()] = '\0';
+		totalBytes += needed;
+		return string_view(copy, name.size());
+	}
+	//Returns the blocks that hold the names
+	const vector<shared_ptr<char[]>>& getBlocks() const {
+		return blocks;
+	}
+	//Returns the bytes taken by every name copied in, including names no longer used
+	size_t bytes() const {
+		return totalBytes;
+	}
+	void clear() {
+		blocks.clear();
+		used = NAME_BLOCK_SIZE;
+		totalBytes = 0;
+	}
+};
+
+//Scratch space for the work of a single command, handed out by moving forward through blocks of memory
+//Everything taken is given back at once with release, and the blocks are kept, so once they have grown to fit
+//the largest command, commands no longer allocate any memory at all. Only meant for types without constructors.
+const size_t SCRATCH_BLOCK_SIZE = 256 * 1024;
+class ScratchArena {
+	struct Block {
+		unique_ptr<char[]> memory;
+		size_t size;
+	};
+	vector<Block> blocks;
+	size_t currentBlock = 0;
+	size_t used = 0; //Bytes taken from the current block
+public:
+	//A point to give the space taken after it back to
+	struct Mark {
+		size_t block;
+		size_t used;
+	};
+	Mark mark() const {
+		return { currentBlock, used };
+	}
+	void release(Mark point) {
+		currentBlock = point.block;
+		used = point.used;
+	}
+	//Takes space for a number of values, left uninitialized
+	//Returns:		The first value, valid until the space is released
+	template <typename T>
+	T* take(size_t count) {
+		size_t bytes = count * sizeof(T);
+		size_t start = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+		while (currentBlock < blocks.size() && start + bytes > blocks[currentBlock].size)
+		{
+			currentBlock++;
+			start = 0;
+		}
+		if (currentBlock == blocks.size())
+		{
+			size_t size = max(SCRATCH_BLOCK_SIZE, bytes);
+			blocks.push_back({ unique_ptr<char[]>(new char[size]), size });
+		}
+		used = start + bytes;
+		return (T*)(blocks[currentBlock].memory.get() + start);
+	}
+	//Takes space for a number of values, each set to the value given
+	template <typename T>
+	T* take(size_t count, T value) {
+		T* values = take<T>(count);
+		fill_n(values, count, value);
+		return values;
+	}
+};
+
+//Gives back everything taken from a scratch arena while it exists, so each command starts from the same point
+class ScratchScope {
+	ScratchArena& arena;
+	ScratchArena::Mark start;
+public:
+	explicit ScratchScope(ScratchArena& arena) : arena(arena), start(arena.mark()) {
+	}
+	~ScratchScope() {
+		arena.release(start);
+	}
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+};
+
+//This class stores the budget categories column by column, each property in its own array, so the balance loops
+//only touch the numbers they need. Every category has a balance, name, and percentage of income assigned to it.
+//I.E. Savings, Wants, Needs. Index 0 is always main, which holds the totals of every other category.
+//A category can sit under another (I.E. Needs > Housing > Rent), its percentage a share of its parent's. The store
+//is kept in tree order, so a category and everything below it fill one range of slots, and each category keeps a
+//running total of everything below it. The price is that a category added anywhere but the end of the store moves
+//every later category up a slot.
+//Removed categories leave empty slots until they outnumber the live ones. Names are unique and kept in an arena.
+//The slots changed since the last save are noted, so the save can rewrite just those, until more than 1 in
+//PATCH_SAVE_DIVISOR change or a category is added, removed, moved or renamed.
+const int PATCH_SAVE_DIVISOR = 8;
+class CategoryStore {
+	int nextIDNumber = 0; //The most recent ID given out, the next new category gets the one after
+	vector<Money> balances; //The category's own money, not counting its sub-categories
+	vector<BasisPoints> budgetPercentages; // 0-10000, of the parent category
+	vector<int> idNumbers; //Wont change, even if the ID beforehand is removed
+	vector<int> parentIndexes; //Index of the parent category, -1 for main
+	vector<int> depths; //0 for main, 1 for the categories directly under main, and so on
+	vector<Money> subcategoryTotals; //Sum of the balances of every category below this one
+	vector<long long> childPercentTotals; //Sum of the percentages of the categories directly below this one
+	vector<int> childCounts; //Number of categories directly below this one
+	vector<string_view> names; //Views into nameArena, kept separate so the numeric columns stay tightly packed
+	NameArena nameArena;
+	pmr::unsynchronized_pool_resource indexPool; //Holds the entries of the two indexes, reused after a removal
+	pmr::unordered_map<int, int> idToIndex{ &indexPool }; //Finds the index of any ID without searching
+	pmr::unordered_map<string_view, int> nameToID{ &indexPool }; //Finds the ID of any name without searching
+	int removedSlots = 0; //Number of empty slots left behind by removed categories
+	int indexMoves = 0; //Number of times categories have moved to other indexes, by compacting or making room
+	long long layoutVersion = 0; //Goes up each time categories are added, removed, moved or renamed
+	int nestedCount = 0; //Number of categories below a category other than main
+	int negativeCount = 0; //Number of categories other than main with a balance below zero
+	BalanceHistory* history = nullptr; //Records every balance change, once the budget has a file
+	ScratchArena scratchArena; //Working space for commands applied to this store, kept between commands
+	vector<char> changedSinceSave; //1 for each slot in changedSlots
+	vector<int> changedSlots; //Slots whose balance or percentage changed since the save, in the order they changed
+	vector<Money> savedBalances; //The balance each of changedSlots had when saved
+	vector<BasisPoints> savedPercentages; //The percentage each of changedSlots had when saved
+	vector<uint32_t> savedRows; //The row of each slot in the saved file
+	bool layoutChanged = true; //Categories were added, removed, moved or renamed since the save, or it never was
+	bool valuesRewritten = false; //Too many values changed to note them one by one
+
+	//Notes that categories are about to be added, removed, moved or renamed
+	void changeLayout() {
+		layoutChanged = true;
+		layoutVersion++;
+	}
+
+	//Notes that the balance or percentage of the slot is about to change, keeping the value it was saved with
+	void markChanged(int index) {
+		if (layoutChanged || valuesRewritten || changedSinceSave[index])
+			return;
+		if ((int)changedSlots.size() >= size() / PATCH_SAVE_DIVISOR)
+		{
+			valuesRewritten = true;
+			return;
+		}
+		changedSinceSave[index] = 1;
+		changedSlots.push_back(index);
+		savedBalances.push_back(balances[index]);
+		savedPercentages.push_back(budgetPercentages[index]);
+	}
+	//Updates the running totals of every category above the index for a balance change, and records it
+	void trackBalance(int index, Money oldBalance, Money newBalance) {
+		markChanged(index);
+		Money change = newBalance - oldBalance;
+		for (int parent = parentIndexes[index]; parent >= 0; parent = parentIndexes[parent])
+			subcategoryTotals[parent] += change;
+		if (index != 0)
+			negativeCount += (newBalance < 0) - (oldBalance < 0);
+		if (history != nullptr && change != 0)
+			history->record(idNumbers[index], change);
+	}
+	void trackPercent(int index, BasisPoints oldPercent, BasisPoints newPercent) {
+		markChanged(index);
+		if (parentIndexes[index] >= 0)
+			childPercentTotals[parentIndexes[index]] += newPercent - oldPercent;
+	}
+	//Returns true if the slot is the category at the index or anywhere below it
+	bool inBranch(int slot, int index) const {
+		while (depths[slot] > depths[index])
+			slot = parentIndexes[slot];
+		return slot == index;
+	}
+	//Works the running totals out from scratch, used after the columns are replaced whole
+	//Going backwards means every category is finished before its parent is reached
+	void recountTotals() {
+		fill(subcategoryTotals.begin(), subcategoryTotals.end(), 0);
+		fill(childPercentTotals.begin(), childPercentTotals.end(), 0);
+		fill(childCounts.begin(), childCounts.end(), 0);
+		nestedCount = 0;
+		negativeCount = 0;
+		for (int i = size() - 1; i >= 1; i--)
+		{
+			if (idNumbers[i] == 0)
+				continue;
+			int parent = parentIndexes[i];
+			subcategoryTotals[parent] += balances[i] + subcategoryTotals[i];
+			childPercentTotals[parent] += budgetPercentages[i];
+			childCounts[parent]++;
+			nestedCount += depths[i] >= 2;
+			negativeCount += balances[i] < 0;
+		}
+	}
+
+	//Moves every live category down over the empty slots, keeping their order, and rebuilds the ID index
+	//The names are copied into a fresh arena, dropping the ones left behind by removed or renamed categories
+	void compact() {
+		vector<int> newIndexes(size());
+		NameArena oldArena = std::move(nameArena);
+		nameArena.clear();
+		nameToID.clear();
+		int kept = 0;
+		for (int i = 0; i < size(); i++)
+		{
+			if (idNumbers[i] == 0)
+				continue;
+			newIndexes[i] = kept;
+			//A parent always comes before its sub-categories, so it has already been moved
+			parentIndexes[kept] = parentIndexes[i] < 0 ? -1 : newIndexes[parentIndexes[i]];
+			if (kept != i) //Moving a name onto itself would empty it
+			{
+				balances[kept] = balances[i];
+				budgetPercentages[kept] = budgetPercentages[i];
+				idNumbers[kept] = idNumbers[i];
+				depths[kept] = depths[i];
+				subcategoryTotals[kept] = subcategoryTotals[i];
+				childPercentTotals[kept] = childPercentTotals[i];
+				childCounts[kept] = childCounts[i];
+				idToIndex[idNumbers[kept]] = kept;
+			}
+			names[kept] = nameArena.intern(names[i]);
+			nameToID[names[kept]] = idNumbers[kept];
+			kept++;
+		}
+		balances.resize(kept);
+		budgetPercentages.resize(kept);
+		idNumbers.resize(kept);
+		parentIndexes.resize(kept);
+		depths.resize(kept);
+		subcategoryTotals.resize(kept);
+		childPercentTotals.resize(kept);
+		childCounts.resize(kept);
+		names.resize(kept);
+		removedSlots = 0;
+		indexMoves++;
+		layoutVersion++;
+	}
+	//Puts a new row into the columns at the index, moving every later category up a slot
+	//This takes time in proportion to the number of categories after the index
+	int insertRow(int index, int id, string_view name, Money balance, BasisPoints budgetPercentage, int parentIndex) {
+		changeLayout();
+		if (id > nextIDNumber)
+			nextIDNumber = id;
+		int depth = 0;
+		if (size() == 0)
+			parentIndex = -1;
+		else
+			depth = depths[parentIndex] + 1;
+		if (index < size())
+		{
+			//Parents come before their sub-categories, so only the categories from the index on can have a
+			//parent that moves
+			indexMoves++;
+			for (int i = index; i < size(); i++)
+			{
+				if (parentIndexes[i] >= index)
+					parentIndexes[i]++;
+				if (idNumbers[i] != 0)
+					idToIndex[idNumbers[i]] = i + 1;
+			}
+		}
+		balances.insert(balances.begin() + index, 0);
+		budgetPercentages.insert(budgetPercentages.begin() + index, 0);
+		idNumbers.insert(idNumbers.begin() + index, id);
+		parentIndexes.insert(parentIndexes.begin() + index, parentIndex);
+		depths.insert(depths.begin() + index, depth);
+		subcategoryTotals.insert(subcategoryTotals.begin() + index, 0);
+		childPercentTotals.insert(childPercentTotals.begin() + index, 0);
+		childCounts.insert(childCounts.begin() + index, 0);
+		names.insert(names.begin() + index, nameArena.intern(name));
+		idToIndex[id] = index;
+		nameToID[names[index]] = id;
+		if (parentIndex >= 0)
+			childCounts[parentIndex]++;
+		nestedCount += depth >= 2;
+		setBalance(index, balance);
+		setPercentOfBudget(index, budgetPercentage);
+		return index;
+	}
+public:
+	//Returns the number of slots in the store, including main and any empty slots
+	//Loops over every slot are safe, as empty slots have no balance or percentage
+	int size() const {
+		return (int)idNumbers.size();
+	}
+	//Returns the number of categories that actually exist, including main
+	int liveCount() const {
+		return size() - removedSlots;
+	}
+	//Returns false if the slot at the index belongs to a removed category
+	bool isLive(int index) const {
+		return idNumbers[index] != 0;
+	}
+	//Returns the index of the category with the ID, or -1 if no category has that ID
+	int indexOf(int id) const {
+		auto found = idToIndex.find(id);
+		if (found == idToIndex.end())
+			return -1;
+		return found->second;
+	}
+	//Returns the index of the category with the name, or -1 if no category has that name
+	int indexOfName(string_view name) const {
+		auto found = nameToID.find(name);
+		if (found == nameToID.end())
+			return -1;
+		return indexOf(found->second);
+	}
+	//Returns one past the last slot below the category at the index
+	//The category and everything below it fill the slots from the index up to here
+	int branchEnd(int index) const {
+		if (index == 0)
+			return size();
+		int end = index + 1;
+		while (end < size() && depths[end] > depths[index])
+			end++;
+		return end;
+	}
+	void reserve(int count) {
+		balances.reserve(count);
+		budgetPercentages.reserve(count);
+		idNumbers.reserve(count);
+		parentIndexes.reserve(count);
+		depths.reserve(count);
+		subcategoryTotals.reserve(count);
+		childPercentTotals.reserve(count);
+		childCounts.reserve(count);
+		names.reserve(count);
+		nameToID.reserve(count);
+	}
+	void clear() {
+		balances.clear();
+		budgetPercentages.clear();
+		idNumbers.clear();
+		parentIndexes.clear();
+		depths.clear();
+		subcategoryTotals.clear();
+		childPercentTotals.clear();
+		childCounts.clear();
+		names.clear();
+		nameArena.clear();
+		idToIndex.clear();
+		nameToID.clear();
+		removedSlots = 0;
+		nextIDNumber = 0;
+		nestedCount = 0;
+		negativeCount = 0;
+		changeLayout();
+	}
+	//Adds a new category, assigning it the next valid ID
+	//Returns the index of the new category, or -1 if the name is already taken
+	int add(string_view name, Money balance, BasisPoints budgetPercentage, int parentIndex = 0) {
+		if (nameToID.count(name) != 0)
+			return -1;
+		return addWithID(++nextIDNumber, name, balance, budgetPercentage, parentIndex);
+	}
+	//Adds a category with an already known ID, used when loading from a file
+	//The ID counter is moved up past the ID if needed, so the ID is never given out again
+	//The first category added is main. Every other one goes after the last category below its parent, which is
+	//the end of the store unless the parent already has a category after its branch
+	//Returns the index of the new category, or -1 if the name is already taken, leaving the store unchanged
+	int addWithID(int id, string_view name, Money balance, BasisPoints budgetPercentage, int parentIndex = 0) {
+		if (nameToID.count(name) != 0)
+			return -1;
+		int index = size();
+		if (index > 0 && parentIndex > 0 && !inBranch(index - 1, parentIndex))
+			index = branchEnd(parentIndex); //Make room in the middle
+		return insertRow(index, id, name, balance, budgetPercentage, parentIndex);
+	}
+	//Puts a removed category back at an index inside its parent's branch, used to undo a removal
+	//If the slot at the index is still empty from the removal it is filled in place, otherwise the category is
+	//put in before it, moving every later category up a slot
+	//Returns the index of the category, or -1 if the name is already taken, leaving the store unchanged
+	int restoreWithID(int index, int id, string_view name, Money balance, BasisPoints budgetPercentage,
+		int parentIndex) {
+		if (nameToID.count(name) != 0)
+			return -1;
+		if (index >= size() || idNumbers[index] != 0 || parentIndexes[index] != parentIndex)
+			return insertRow(index, id, name, balance, budgetPercentage, parentIndex);
+
+		//The empty slot kept its parent and depth, and every running total it had was taken off at removal
+		changeLayout();
+		idNumbers[index] = id;
+		names[index] = nameArena.intern(name);
+		idToIndex[id] = index;
+		nameToID[names[index]] = id;
+		childCounts[parentIndex]++;
+		nestedCount += depths[index] >= 2;
+		removedSlots--;
+		setBalance(index, balance);
+		setPercentOfBudget(index, budgetPercentage);
+		return index;
+	}
+	//Replaces everything in the store with whole columns at once, used when loading a snapshot
+	//The rows must be in tree order, each category after its parent and next to its parent's other branches
+	//Parameters:	const Money* newBalances, const BasisPoints* newPercentages, const int* newIDs - The columns
+	//				const int* newParentIDs - The ID of each category's parent, main's is not read
+	//				const string_view* newNames - The names, which are copied into the store
+	//				int count - The number of categories in each column
+	//Returns:		false if the rows are not in tree order or two share a name, leaving the store empty
+	bool assignColumns(const Money* newBalances, const BasisPoints* newPercentages, const int* newIDs,
+		const int* newParentIDs, const string_view* newNames, int count) {
+		clear();
+		balances.assign(newBalances, newBalances + count);
+		budgetPercentages.assign(newPercentages, newPercentages + count);
+		idNumbers.assign(newIDs, newIDs + count);
+		parentIndexes.assign(count, -1);
+		depths.assign(count, 0);
+		subcategoryTotals.assign(count, 0);
+		childPercentTotals.assign(count, 0);
+		childCounts.assign(count, 0);
+		names.resize(count);
+		idToIndex.reserve(count);
+		nameToID.reserve(count);
+		for (int i = 0; i < count; i++)
+		{
+			idToIndex[idNumbers[i]] = i;
+			names[i] = nameArena.intern(newNames[i]);
+			if (!nameToID.emplace(names[i], idNumbers[i]).second)
+			{
+				clear();
+				return false;
+			}
+			if (i == 0)
+				continue;
+			int parent = indexOf(newParentIDs[i]);
+			if (parent < 0 || parent >= i || !inBranch(i - 1, parent))
+			{
+				clear();
+				return false;
+			}
+			parentIndexes[i] = parent;
+			depths[i] = depths[parent] + 1;
+		}
+		recountTotals();
+		return true;
+	}
+	//Removes the category at the index and every category below it, leaving empty slots behind
+	//Indexes of other categories stay valid unless the empty slots get compacted
+	//Returns:		The number of categories removed
+	int erase(int index) {
+		changeLayout();
+		int end = branchEnd(index);
+		Money branchTotal = balances[index] + subcategoryTotals[index];
+		for (int parent = parentIndexes[index]; parent >= 0; parent = parentIndexes[parent])
+			subcategoryTotals[parent] -= branchTotal;
+		trackPercent(index, budgetPercentages[index], 0);
+		childCounts[parentIndexes[index]]--;
+
+		int removed = 0;
+		for (int i = index; i < end; i++)
+		{
+			if (idNumbers[i] == 0)
+				continue;
+			idToIndex.erase(idNumbers[i]);
+			nameToID.erase(names[i]);
+			nestedCount -= depths[i] >= 2;
+			negativeCount -= balances[i] < 0;
+			if (history != nullptr && balances[i] != 0)
+				history->record(idNumbers[i], -balances[i]);
+			//The parent and depth are kept, so the empty slot still sits in the right branch
+			balances[i] = 0;
+			budgetPercentages[i] = 0;
+			idNumbers[i] = 0;
+			subcategoryTotals[i] = 0;
+			childPercentTotals[i] = 0;
+			childCounts[i] = 0;
+			names[i] = string_view();
+			removed++;
+		}
+		removedSlots += removed;
+
+		if (removedSlots > liveCount())
+			compact();
+		return removed;
+	}
+	//Renames the category at the index, keeping its own name counts as a change
+	//Returns:		false if another category already has the name, leaving the category unchanged
+	bool setName(int index, string_view name) {
+		auto found = nameToID.find(name);
+		if (found != nameToID.end())
+			return found->second == idNumbers[index];
+		changeLayout();
+		nameToID.erase(names[index]);
+		names[index] = nameArena.intern(name);
+		nameToID[names[index]] = idNumbers[index];
+		return true;
+	}
+	//Returns the name of the category at the index
+	//The view stays valid until the category is removed or renamed, or the store is cleared
+	string_view getName(int index) const {
+		return names[index];
+	}
+	void setBalance(int index, Money balance) {
+		trackBalance(index, balances[index], balance);
+		balances[index] = balance;
+	}
+	Money getBalance(int index) const {
+		return balances[index];
+	}
+	void addToBalance(int index, Money number) {
+		trackBalance(index, balances[index], balances[index] + number);
+		balances[index] += number;
+	}
+	void setPercentOfBudget(int index, BasisPoints budgetPercentage) {
+		trackPercent(index, budgetPercentages[index], budgetPercentage);
+		budgetPercentages[index] = budgetPercentage;
+	}
+	BasisPoints getPercentOfBudget(int index) const {
+		return budgetPercentages[index];
+	}
+	int getNextIDNumber() const {
+		return nextIDNumber;
+	}
+	//Returns the number of times categories have moved to other indexes, any index kept from before a move
+	//may now belong to another category
+	int getIndexMoves() const {
+		return indexMoves;
+	}
+	//Returns a number that changes whenever categories are added, removed, moved to other indexes or renamed
+	long long getLayoutVersion() const {
+		return layoutVersion;
+	}
+	//Returns the blocks of memory that hold the names, which stay valid for as long as they are held
+	const vector<shared_ptr<char[]>>& getNameBlocks() const {
+		return nameArena.getBlocks();
+	}
+	void setNextIDNumber(int id) {
+		changeLayout();
+		nextIDNumber = id;
+	}
+	void setIDNumber(int index, int id) {
+		changeLayout();
+		idNumbers[index] = id;
+	}
+	int getIDNumber(int index) const {
+		return idNumbers[index];
+	}
+	int getParentIndex(int index) const {
+		return parentIndexes[index];
+	}
+	int getDepth(int index) const {
+		return depths[index];
+	}
+	int getChildCount(int index) const {
+		return childCounts[index];
+	}
+	long long getChildPercentTotal(int index) const {
+		return childPercentTotals[index];
+	}
+	//Returns the balance of the category plus everything below it
+	//Main's own balance already holds the total of the whole budget, so this is only meant for other categories
+	Money getBranchTotal(int index) const {
+		return balances[index] + subcategoryTotals[index];
+	}
+	//The running totals of every category except main
+	Money getCategoryTotal() const {
+		return subcategoryTotals[0];
+	}
+	long long getPercentTotal() const {
+		return childPercentTotals[0];
+	}
+	int getNegativeCount() const {
+		return negativeCount;
+	}
+	//Returns the number of categories that are below a category other than main
+	int getNestedCount() const {
+		return nestedCount;
+	}
+	//Direct access to the columns, for loops that run over every category
+	//Anything written through balanceData must be reported with addToSubcategoryTotal and balancesChanged, and
+	//is not recorded in the history, so stores with a history are changed through applyShares instead
+	Money* balanceData() {
+		return balances.data();
+	}
+	const Money* balanceData() const {
+		return balances.data();
+	}
+	const BasisPoints* percentData() const {
+		return budgetPercentages.data();
+	}
+	//Starts or stops recording balance changes in a history
+	void setHistory(BalanceHistory* newHistory) {
+		history = newHistory;
+	}
+	bool hasHistory() const {
+		return history != nullptr;
+	}
+	//Returns the working space for a command on this store, to be used inside a ScratchScope
+	ScratchArena& scratch() {
+		return scratchArena;
+	}
+	//Adds an amount to the balance of every category other than main, recording each one in the history
+	//Parameters:	const Money* shares - The amount for each slot, including main's which is not read
+	void applyShares(const Money* shares) {
+		for (int i = 1; i < size(); i++)
+		{
+			if (shares[i] == 0)
+				continue;
+			balances[i] += shares[i];
+			history->record(idNumbers[i], shares[i]);
+		}
+	}
+	//Records money written through balanceData to the categories below the index, for a category other than main
+	void addToSubcategoryTotal(int index, Money amount) {
+		subcategoryTotals[index] += amount;
+	}
+	//Updates the running totals after balances were written directly through balanceData
+	//Parameters:	Money totalAdded - The sum of every change made to categories other than main
+	//				bool signsChanged - true if a balance other than main may have crossed zero
+	void balancesChanged(Money totalAdded, bool signsChanged) {
+		valuesRewritten = true;
+		subcategoryTotals[0] += totalAdded;
+		if (!signsChanged)
+			return;
+		negativeCount = 0;
+		for (int i = 1; i < size(); i++)
+			negativeCount += balances[i] < 0;
+	}
+	//Returns true if only the balances and percentages of changedSlots differ from the saved file, so they can be
+	//written over their rows instead of saving the whole budget
+	bool canSaveChangesOnly() const {
+		return !layoutChanged && !valuesRewritten;
+	}
+	const vector<int>& getChangedSlots() const {
+		return changedSlots;
+	}
+	//Returns the balance and percentage the slot at a position in changedSlots had when saved
+	Money getSavedBalance(int position) const {
+		return savedBalances[position];
+	}
+	BasisPoints getSavedPercent(int position) const {
+		return savedPercentages[position];
+	}
+	//Returns the row of the slot in the saved file, only valid while canSaveChangesOnly is true
+	uint32_t getSavedRow(int index) const {
+		return savedRows[index];
+	}
+	//Starts noting changes again from here, once the store has been saved
+	//Parameters:	bool wholeBudget - true if every category was written, in order, leaving out the empty slots
+	void markSaved(bool wholeBudget) {
+		for (int index : changedSlots)
+			changedSinceSave[index] = 0;
+		changedSlots.clear();
+		savedBalances.clear();
+		savedPercentages.clear();
+		valuesRewritten = false;
+		if (!wholeBudget)
+			return;
+		changedSinceSave.assign(size(), 0);
+		savedRows.resize(size());
+		uint32_t row = 0;
+		for (int i = 0; i < size(); i++)
+		{
+			savedRows[i] = row;
+			row += isLive(i);
+		}
+		layoutChanged = false;
+	}
+};
+
+//These are the kernels used for the balance loops. Each works on the raw columns of the store.
+//Each kernel body is written once and compiled for AVX-512, AVX2 and plain x86, and the best version
+//the CPU supports is picked once at runtime. Empty slots have a zero percentage and balance,
+//so the kernels do not skip them.
+void distributeSharesScalar(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign);
+Money sumMoneyScalar(const Money* column, int count);
+long long sumPercentScalar(const BasisPoints* column, int count);
+
+#ifdef BUDGET_X86_KERNELS
+void distributeSharesAVX2(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign);
+Money sumMoneyAVX2(const Money* column, int count);
+long long sumPercentAVX2(const BasisPoints* column, int count);
+void distributeSharesAVX512(Money* balances, const BasisPoints* percentages, int* remainders,
+	int count, Money whole, int part, Money sign);
+Money sumMoneyAVX512(const Money* column, int count);
+long long sumPercentAVX512(const BasisPoints* column, int count);
+#endif
+
+//The kernels picked for this CPU, filled in by selectKernels
+struct BalanceKernels {
+	void (*distributeShares)(Money*, const BasisPoints*, int*, int, Money, int, Money) = distributeSharesScalar;
+	Money (*sumMoney)(const Money*, int) = sumMoneyScalar;
+	long long (*sumPercent)(const BasisPoints*, int) = sumPercentScalar;
+};
+
+extern const BalanceKernels balanceKernels;
+
+const int REPORT_NUMBER_SIZE = 32; //Room for any value written by writeHundredths
+char* writeHundredths(char* out, long long hundredths);
+string toDecimalString(long long hundredths);
+
+//Reports of the categories are formatted straight into a large buffer, which is written out once it fills up
+//rather than once per row or value. The table shown by option 1, the text save format, the lists shown while
+//choosing categories, and the CSV and JSON exports are all made the same way.
+const size_t REPORT_BUFFER_SIZE = 1 << 16;
+
+//Collects formatted text, writing it to a stream a whole buffer at a time
+class ReportWriter {
+	ostream& out;
+	vector<char> buffer;
+	size_t used = 0;
+
+	//Returns where to write a number of characters, writing the buffer out first if they do not fit
+	char* room(size_t count) {
+		if (used + count > buffer.size())
+		{
+			flush();
+			if (count > buffer.size())
+				buffer.resize(count);
+		}
+		return buffer.data() + used;
+	}
+public:
+	explicit ReportWriter(ostream& out) : out(out), buffer(REPORT_BUFFER_SIZE) {
+	}
+	~ReportWriter() {
+		flush();
+	}
+	ReportWriter(const ReportWriter&) = delete;
+	ReportWriter& operator=(const ReportWriter&) = delete;
+
+	void flush() {
+		if (used > 0)
+			out.write(buffer.data(), used);
+		used = 0;
+	}
+	void text(string_view value) {
+		memcpy(room(value.size()), value.data(), value.size());
+		used += value.size();
+	}
+	void character(char value, size_t count = 1) {
+		memset(room(count), value, count);
+		used += count;
+	}
+	//Writes a value with spaces after it to fill the width, or before it when alignRight is true
+	//Parameters:	string_view value - The value
+	//				int width - The least number of characters to take up
+	//				bool alignRight - true to put the spaces first
+	//				int indent - Spaces to put before the value, counted in the width
+	void padded(string_view value, int width, bool alignRight = false, int indent = 0) {
+		int padding = width - indent - (int)value.size();
+		if (alignRight && padding > 0)
+			character(' ', padding);
+		if (indent > 0)
+			character(' ', indent);
+		text(value);
+		if (!alignRight && padding > 0)
+			character(' ', padding);
+	}
+	void number(long long value, int width = 0, bool alignRight = false) {
+		char digits[REPORT_NUMBER_SIZE];
+		padded(string_view(digits, to_chars(digits, digits + sizeof(digits), value).ptr - digits), width, alignRight);
+	}
+	//Writes a value kept in hundredths as a decimal with two places
+	void hundredths(long long value, int width = 0) {
+		char digits[REPORT_NUMBER_SIZE];
+		padded(string_view(digits, writeHundredths(digits, value) - digits), width);
+	}
+	//Writes a value kept in hundredths as a decimal with one place, rounded the same way as printf
+	void tenths(long long value, int width = 0) {
+		char digits[REPORT_NUMBER_SIZE];
+		char* end = to_chars(digits, digits + sizeof(digits), value / 100.0, chars_format::fixed, 1).ptr;
+		padded(string_view(digits, end - digits), width);
+	}
+	//Writes a value as a CSV field, quoted if it holds a comma, quote or line break
+	void csvField(string_view value) {
+		if (value.find_first_of(",\"\r\n") == string_view::npos)
+		{
+			text(value);
+			return;
+		}
+		character('"');
+		for (char c : value)
+			character(c, c == '"' ? 2 : 1);
+		character('"');
+	}
+	//Writes a value as a quoted JSON string
+	void jsonString(string_view value) {
+		character('"');
+		for (char c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				character('\\');
+				character(c);
+			}
+			else if ((unsigned char)c < 0x20)
+			{
+				const char* hex = "0123456789abcdef";
+				text("\\u00");
+				character(hex[(unsigned char)c >> 4]);
+				character(hex[c & 15]);
+			}
+			else
+				character(c);
+		}
+		character('"');
+	}
+};
+
+enum ReportFormat {
+	REPORT_TABLE,		//The table shown by option 1, with branch totals and indented names
+	REPORT_SAVE,		//The text save format, see saveToFile
+	REPORT_ID_LIST,		//IDs and indented names, shown while choosing a category
+	REPORT_PERCENT_LIST,	//Indented names and percentages, shown while setting percentages
+	REPORT_CSV,
+	REPORT_JSON
+};
+
+//Which categories a report includes. With no filter, every category is included in store order, starting
+//with main. Filtered reports leave main out.
+struct ReportOptions {
+	ReportFormat format = REPORT_TABLE;
+	bool onlyNegative = false; //Only categories with their own balance below zero
+	int topCount = 0; //Only this many categories with the largest balances (including sub-categories), largest first
+	int firstRow = 0; //The rows before this one are skipped, for paging
+	int rowLimit = 0; //The most rows to include, 0 for no limit
+};
+
+void renderReport(const CategoryStore& categories, const ReportOptions& options, ReportWriter& writer);
+void displayToScreen(const CategoryStore& categories);
+const char* skipSpaces(const char* first, const char* last);
+bool readWholeFile(const string& fileName, vector<char>& buffer);
+bool parseTextBudget(const vector<char>& buffer, const string& fileName, CategoryStore& categories);
+bool saveSnapshot(const string& fileName, const CategoryStore& categories);
+bool parseSnapshot(const vector<char>& buffer, const string& fileName, CategoryStore& categories,
+	bool* valuesDamaged = nullptr);
+bool saveTextFile(const string& fileName, const CategoryStore& categories);
+bool convertBudgetFile(const string& inputName, const string& outputName);
+
+//The operations on the categories, shared by the menu, batch mode, the server and the schedules
+Money splitAmount(Money amount, Money* shares, const BasisPoints* percentages, int count,
+	long long totalPercent, ScratchArena& scratch);
+void modifyBalance(Money balanceModification, CategoryStore& categories);
+bool applyToCategory(int IDChoice, Money modification, CategoryStore& categories);
+int createCategory(string_view catName, Money startingBalance, CategoryStore& categories, int id = 0,
+	int parentID = 1);
+int deleteCategory(int IDChoice, CategoryStore& categories);
+bool assignPercentage(int IDChoice, BasisPoints percent, CategoryStore& categories);
+int findUnbalancedGroup(const CategoryStore& categories);
+void updateMainPercentage(CategoryStore& categories);
+bool saveBudgetFile(const string& fileName, const CategoryStore& categories, bool snapshot);
+
+//The journal records every change made to a budget as soon as it happens, in a file next to the budget
+//named <budget file>.journal. When the budget is loaded again the journal is replayed on top of it,
+//so nothing is lost if the program is closed or crashes before saving.
+//Entries are collected and written together, with one flush to disk per group (syncBatchSize entries).
+//A save, or compaction once the journal gets long, writes the budget file and empties the journal.
+//Each entry is the length of its contents, the contents (type then values), and a checksum,
+//so an entry cut off by a crash is detected and dropped when replaying.
+const char JOURNAL_MAGIC[8] = { 'B', 'U', 'D', 'G', 'J', 'R', 'N', 'L' };
+const int JOURNAL_COMPACT_ENTRIES = 10000; //Entries allowed before the journal is folded into the budget file
+enum JournalEntryType : uint8_t {
+	JOURNAL_DEPOSIT = 1,			//Money amount
+	JOURNAL_ADD_TO_CATEGORY = 2,	//int32 ID, Money amount
+	JOURNAL_NEW_CATEGORY = 3,		//int32 ID, Money starting balance, then the name
+	JOURNAL_REMOVE_CATEGORY = 4,	//int32 ID
+	JOURNAL_SET_PERCENTAGES = 5,	//int32 ID and int32 percentage for each category
+	JOURNAL_NEW_SUBCATEGORY = 6,	//int32 ID, int32 parent ID, Money starting balance, then the name
+	JOURNAL_RESTORE_CATEGORIES = 7,	//int32 main's percentage, int32 ID the branch goes before, then the rows
+									//of restoreCategories, none if only main's percentage is set
+	JOURNAL_SAVED_VALUES = 8		//int32 ID, Money balance and int32 percentage for each category about to be
+									//written over in the budget file, see saveBudgetChanges
+};
+
+class Journal {
+	int fileDescriptor = -1;
+	string budgetName; //The budget file the journal belongs to
+	bool budgetIsSnapshot = false;
+	vector<char> pending; //Entries waiting for the next group commit
+	int pendingEntries = 0;
+	int syncBatchSize = 1;
+	int entriesSinceCompaction = 0;
+	size_t entryStart = 0;
+	BalanceHistory history; //The long term history of the budget, written along with the journal
+
+	template <typename T>
+	void put(T value) {
+		const char* bytes = (const char*)&value;
+		pending.insert(pending.end(), bytes, bytes + sizeof(T));
+	}
+	//Starts a new entry, leaving room for its length
+	void beginEntry(JournalEntryType type) {
+		entryStart = pending.size();
+		put<uint32_t>(0);
+		put<uint8_t>(type);
+	}
+	//Fills in the length and checksum of the entry, and commits the group if it is full
+	void endEntry() {
+		uint32_t length = (uint32_t)(pending.size() - entryStart - sizeof(uint32_t));
+		memcpy(&pending[entryStart], &length, sizeof(uint32_t));
+		put<uint32_t>((uint32_t)fnv1a(&pending[entryStart + sizeof(uint32_t)], length));
+		pendingEntries++;
+		entriesSinceCompaction++;
+		if (pendingEntries >= syncBatchSize)
+			commit();
+	}
+public:
+	static int syncFile(int descriptor) {
+#ifdef _WIN32
+		return _commit(descriptor);
+#else
+		return fsync(descriptor);
+#endif
+	}
+	~Journal() {
+		close();
+	}
+	bool isOpen() const {
+		return fileDescriptor != -1;
+	}
+	const string& getBudgetName() const {
+		return budgetName;
+	}
+	bool isBudgetSnapshot() const {
+		return budgetIsSnapshot;
+	}
+	BalanceHistory& getHistory() {
+		return history;
+	}
+	//Sets how many entries are grouped into each write and flush to disk, 1 makes every change durable at once
+	void setSyncBatchSize(int entries) {
+		syncBatchSize = entries < 1 ? 1 : entries;
+	}
+	//Returns true once the journal has grown long enough that it should be folded into the budget file
+	bool needsCompaction() const {
+		return entriesSinceCompaction >= JOURNAL_COMPACT_ENTRIES;
+	}
+
+	//Opens the journal of a budget file for appending, creating it if it does not exist
+	//Parameters:	const string& fileName - The budget file the journal belongs to
+	//				bool snapshot - true if the budget file is a binary snapshot, used when compacting
+	//				size_t validLength - The length of the journal that replayed cleanly, anything after is cut off
+	//Returns:		false if the journal could not be opened, after outputting an error
+	bool open(const string& fileName, bool snapshot, size_t validLength = 0) {
+		close();
+		string journalName = fileName + ".journal";
+		int flags = O_WRONLY | O_CREAT;
+#ifdef _WIN32
+		flags |= O_BINARY;
+#endif
+		fileDescriptor = ::open(journalName.c_str(), flags, 0644);
+		if (fileDescriptor == -1)
+		{
+			cout << "Error: Could not open the journal " << journalName << ", changes will not be recorded.\n";
+			return false;
+		}
+		budgetName = fileName;
+		budgetIsSnapshot = snapshot;
+		entriesSinceCompaction = 0;
+		//A budget saved under a new name takes its history with it, unlike the journal which starts empty
+		if (!history.isOpen() || history.getBudgetName() != fileName)
+			history.moveTo(fileName);
+
+		//Drop anything after the last good entry, or write the header for a new journal
+		if (validLength < sizeof(JOURNAL_MAGIC))
+			validLength = 0;
+		error_code resizeError;
+		filesystem::resize_file(journalName, validLength, resizeError);
+		lseek(fileDescriptor, (long)validLength, SEEK_SET);
+		if (validLength == 0)
+		{
+			pending.insert(pending.end(), JOURNAL_MAGIC, JOURNAL_MAGIC + sizeof(JOURNAL_MAGIC));
+			commit();
+		}
+		return true;
+	}
+
+	//Writes every pending entry to the journal and flushes it to disk, along with the history
+	void commit() {
+		METRIC_SCOPE(METRIC_JOURNAL_COMMIT);
+		history.commit();
+		writeGroup(pending);
+		pending.clear();
+		pendingEntries = 0;
+	}
+
+	//Returns the number of entries waiting for the next group commit
+	int getPendingEntries() const {
+		return pendingEntries;
+	}
+	//Moves the entries waiting for the next group commit into a group for writeGroup, and writes the history
+	//Parameters:	vector<char>& group - Receives the entries, replacing what it held
+	void takePending(vector<char>& group) {
+		history.commit();
+		group.clear();
+		group.swap(pending);
+		pendingEntries = 0;
+	}
+	//Writes a group of entries to the journal and flushes it to disk
+	//Only the file is used, so groups taken with takePending can be written by another thread while new changes
+	//are recorded, as long as one thread writes them all in order
+	void writeGroup(const vector<char>& group) const {
+		if (fileDescriptor == -1 || group.empty())
+			return;
+		if (write(fileDescriptor, group.data(), (unsigned int)group.size()) != (long)group.size()
+			|| syncFile(fileDescriptor) != 0)
+			cout << "Error: Could not write to the journal of " << budgetName << ".\n";
+	}
+
+	//Commits anything pending and closes the journal
+	void close() {
+		if (fileDescriptor == -1)
+			return;
+		commit();
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+
+	//Empties the journal, called once the budget file holds every change
+	void reset() {
+		if (fileDescriptor != -1)
+			open(budgetName, budgetIsSnapshot);
+	}
+
+	void recordDeposit(Money amount) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_DEPOSIT);
+		put<int64_t>(amount);
+		endEntry();
+	}
+	void recordAddToCategory(int id, Money amount) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_ADD_TO_CATEGORY);
+		put<int32_t>(id);
+		put<int64_t>(amount);
+		endEntry();
+	}
+	//Categories directly under main are recorded without a parent, the same as before sub-categories existed
+	void recordNewCategory(int id, int parentID, Money startingBalance, string_view name) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(parentID == 1 ? JOURNAL_NEW_CATEGORY : JOURNAL_NEW_SUBCATEGORY);
+		put<int32_t>(id);
+		if (parentID != 1)
+			put<int32_t>(parentID);
+		put<int64_t>(startingBalance);
+		pending.insert(pending.end(), name.begin(), name.end());
+		endEntry();
+	}
+	void recordRemoveCategory(int id) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_REMOVE_CATEGORY);
+		put<int32_t>(id);
+		endEntry();
+	}
+	//Records the percentage of every category other than main
+	void recordPercentages(const CategoryStore& categories) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_SET_PERCENTAGES);
+		for (int i = 1; i < categories.size(); i++)
+		{
+			if (!categories.isLive(i))
+				continue;
+			put<int32_t>(categories.getIDNumber(i));
+			put<int32_t>(categories.getPercentOfBudget(i));
+		}
+		endEntry();
+	}
+	//Records the percentages of some categories, as int32 ID and int32 percentage pairs
+	void recordPercentages(const char* pairs, size_t length) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_SET_PERCENTAGES);
+		pending.insert(pending.end(), pairs, pairs + length);
+		endEntry();
+	}
+	//Records a branch of removed categories being put back, see restoreCategories for the rows
+	void recordRestoreCategories(BasisPoints mainPercent, int beforeID, const char* rows, size_t length) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_RESTORE_CATEGORIES);
+		put<int32_t>(mainPercent);
+		put<int32_t>(beforeID);
+		pending.insert(pending.end(), rows, rows + length);
+		endEntry();
+	}
+	//Records the values of every category changed since the budget file was saved, before they are written over
+	//their rows in the file
+	void recordSavedValues(const CategoryStore& categories) {
+		if (fileDescriptor == -1)
+			return;
+		beginEntry(JOURNAL_SAVED_VALUES);
+		for (int index : categories.getChangedSlots())
+		{
+			put<int32_t>(categories.getIDNumber(index));
+			put<int64_t>(categories.getBalance(index));
+			put<int32_t>(categories.getPercentOfBudget(index));
+		}
+		endEntry();
+	}
+};
+
+bool saveBudgetChanges(const string& fileName, CategoryStore& categories, Journal& journal, bool snapshot);
+void attachHistory(CategoryStore& categories, Journal& journal);
+bool openBudget(const string& fileName, CategoryStore& categories, Journal& journal);
+bool openOrCreateBudget(const string& fileName, CategoryStore& categories, Journal& journal);
+
+//Undo keeps a record of each change made from the menu, holding only what is needed to reverse it: the amount
+//of a deposit or addition, the percentages that changed, or the rows of a removed branch. Undoing or redoing a
+//change is itself a change, so it is written to the journal like any other.
+const size_t UNDO_MEMORY_LIMIT = 64 << 20; //Bytes of undo history kept by default, the oldest changes go first
+
+enum UndoType : uint8_t {
+	UNDO_DEPOSIT,			//amount
+	UNDO_ADD_TO_CATEGORY,	//id, amount
+	UNDO_NEW_CATEGORY,		//id, parentID, amount as the starting balance, mainPercent, the name in data
+	UNDO_REMOVE_CATEGORY,	//id, parentID as the ID the branch went before, mainPercent, the slots and rows in data
+	UNDO_SET_PERCENTAGES	//mainPercent, int32 ID and int32 percentage pairs in data
+};
+
+//One change that can be undone, or redone once it has been undone
+//For percentages, the record holds the values that are not in the store, so undo and redo both swap them in
+struct UndoRecord {
+	Money amount = 0;
+	int id = 0;
+	int parentID = 0;
+	int indexMoves = 0; //The store's count of index moves at removal, the slots are only valid while it matches
+	BasisPoints mainPercent = 0;
+	UndoType type = UNDO_DEPOSIT;
+	vector<char> data;
+};
+
+//The changes that can be undone and redone, kept under a memory limit
+class UndoHistory {
+	deque<UndoRecord> undoRecords; //Oldest first
+	vector<UndoRecord> redoRecords; //Most recently undone last
+	size_t memoryLimit;
+	size_t memoryUsed = 0;
+
+	static size_t recordSize(const UndoRecord& record) {
+		return sizeof(UndoRecord) + record.data.capacity();
+	}
+	//Drops the oldest changes until the history fits in its limit, always keeping the newest
+	void trim() {
+		while (memoryUsed > memoryLimit && undoRecords.size() > 1)
+		{
+			memoryUsed -= recordSize(undoRecords.front());
+			undoRecords.pop_front();
+		}
+	}
+public:
+	explicit UndoHistory(size_t limit = UNDO_MEMORY_LIMIT) : memoryLimit(limit) {
+	}
+	//Adds a new change, which can no longer be followed by redoing anything undone before it
+	void record(UndoRecord&& change) {
+		for (const UndoRecord& undone : redoRecords)
+			memoryUsed -= recordSize(undone);
+		redoRecords.clear();
+		memoryUsed += recordSize(change);
+		undoRecords.push_back(std::move(change));
+		trim();
+	}
+	bool canUndo() const {
+		return !undoRecords.empty();
+	}
+	bool canRedo() const {
+		return !redoRecords.empty();
+	}
+	//The change undo would reverse, only valid if canUndo is true
+	UndoRecord& nextUndo() {
+		return undoRecords.back();
+	}
+	//The change redo would make again, only valid if canRedo is true
+	UndoRecord& nextRedo() {
+		return redoRecords.back();
+	}
+	//Moves the next change to undo over to the changes to redo, once it has been undone
+	void undone() {
+		memoryUsed -= recordSize(undoRecords.back());
+		redoRecords.push_back(std::move(undoRecords.back()));
+		undoRecords.pop_back();
+		memoryUsed += recordSize(redoRecords.back());
+	}
+	//Moves the next change to redo back over to the changes to undo, once it has been redone
+	void redone() {
+		memoryUsed -= recordSize(redoRecords.back());
+		undoRecords.push_back(std::move(redoRecords.back()));
+		redoRecords.pop_back();
+		memoryUsed += recordSize(undoRecords.back());
+		trim();
+	}
+	size_t undoCount() const {
+		return undoRecords.size();
+	}
+	size_t redoCount() const {
+		return redoRecords.size();
+	}
+	size_t getMemoryUsed() const {
+		return memoryUsed;
+	}
+	void setMemoryLimit(size_t limit) {
+		memoryLimit = limit;
+		trim();
+	}
+};
+
+//Adds a value to the end of the data of an undo record
+template <typename T>
+void putUndoValue(vector<char>& data, T value) {
+	const char* bytes = (const char*)&value;
+	data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+int deleteCategoryForUndo(int IDChoice, CategoryStore& categories, UndoRecord& record);
+void undoChange(UndoRecord& record, CategoryStore& categories, Journal& journal);
+void redoChange(UndoRecord& record, CategoryStore& categories, Journal& journal);
+string describeChange(const UndoRecord& record, const CategoryStore& categories);
+int64_t daysFromCivil(int year, int month, int day);
+bool parseDate(const string& text, int64_t& startTime);
+
+//A fixed set of worker threads that run numbered tasks in parallel
+class ThreadPool {
+	vector<thread> workers;
+	mutex poolLock;
+	condition_variable wakeWorkers;
+	condition_variable tasksFinished;
+	const function<void(int)>* task = nullptr;
+	int taskCount = 0;
+	atomic<int> nextTask{ 0 };
+	int tasksLeft = 0;
+	unsigned long long generation = 0; //Goes up each time run is called, so workers know there is new work
+	bool stopping = false;
+
+	void workerLoop() {
+		unsigned long long seenGeneration = 0;
+		while (true)
+		{
+			{
+				unique_lock<mutex> guard(poolLock);
+				wakeWorkers.wait(guard, [&] { return stopping || generation != seenGeneration; });
+				if (stopping)
+					return;
+				seenGeneration = generation;
+			}
+			int finished = 0;
+			for (int i = nextTask++; i < taskCount; i = nextTask++)
+			{
+				(*task)(i);
+				finished++;
+			}
+			unique_lock<mutex> guard(poolLock);
+			tasksLeft -= finished;
+			if (tasksLeft == 0)
+				tasksFinished.notify_all();
+		}
+	}
+public:
+	//Parameters:	int threadCount - The number of workers, 0 uses one per core
+	explicit ThreadPool(int threadCount) {
+		if (threadCount <= 0)
+			threadCount = max(1, (int)thread::hardware_concurrency());
+		for (int i = 0; i < threadCount; i++)
+			workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+	~ThreadPool() {
+		{
+			lock_guard<mutex> guard(poolLock);
+			stopping = true;
+		}
+		wakeWorkers.notify_all();
+		for (thread& worker : workers)
+			worker.join();
+	}
+	int size() const {
+		return (int)workers.size();
+	}
+	//Runs work(0) to work(count - 1) spread over the workers, and waits for all of them to finish
+	void run(int count, const function<void(int)>& work) {
+		if (count <= 0)
+			return;
+		unique_lock<mutex> guard(poolLock);
+		task = &work;
+		taskCount = count;
+		nextTask = 0;
+		tasksLeft = count;
+		generation++;
+		wakeWorkers.notify_all();
+		tasksFinished.wait(guard, [&] { return tasksLeft == 0; });
+	}
+};
+
+//Batch mode applies a file of commands to a budget without any prompts, then saves it
+//Each line is one command, with its values separated by commas or spaces. Blank lines and lines starting with # are skipped.
+//	deposit,<amount>						Splits the amount between the categories, like option 2
+//	add,<ID>,<amount>						Adds the amount to one category, like option 3
+//	create,<name>,<starting balance>[,<parent ID>]	Creates a category, like option 5
+//	remove,<ID>								Removes a category, like option 5
+//	percent,<ID>,<percent>,<ID>,<percent>...	Sets percentages, which must then total 100%, like option 4
+//Any <ID> can also be given as the category's name.
+//Every command is applied on its own, in file order, with the same functions as the menu, so a file gives the same
+//budget as entering its commands one at a time. Only reading the lines is spread over threads: the file is read in
+//chunks on any number of threads, or streamed through a pipeline of four threads that read, parse, apply and
+//journal it, and the result is the same either way.
+const int BATCH_JOURNAL_GROUP = 4096; //Journal entries written and flushed together in batch mode
+const int PIPELINE_STAGES = 4;
+
+//Counts of everything a batch run did, output at the end
+struct BatchSummary {
+	long long records = 0;
+	long long deposits = 0;
+	Money depositTotal = 0;
+	long long adjustments = 0;
+	long long created = 0;
+	long long removed = 0;
+	long long percentageChanges = 0;
+	long long errors = 0;
+};
+
+//The kinds of command in a batch file
+enum BatchRecordType {
+	BATCH_DEPOSIT,
+	BATCH_ADD,
+	BATCH_NAMED_ADD,	//An add to a category given by name, which can only be looked up when it is applied
+	BATCH_COMMAND		//A create, remove or percent command, read again when it is applied
+};
+
+//One command of a batch file, read but not applied yet
+struct BatchRecord {
+	BatchRecordType type;
+	int id; //The category of an add
+	Money amount; //The amount of a deposit or add
+	long long line;
+	const char* text; //The name of a named add, or the whole line of any other command, pointing into the file
+	const char* textEnd;
+};
+
+//Everything one thread found in its chunk of a batch file
+//Line numbers are counted from the start of the chunk until the chunks are put back together
+struct BatchChunk {
+	const char* start = nullptr;
+	const char* end = nullptr;
+	long long lines = 0;
+	long long records = 0;
+	vector<BatchRecord> commands; //In file order
+	vector<pair<long long, const char*>> errors; //Line and reason of each line that could not be read
+};
+
+void splitBatchFields(const char* row, const char* rowEnd, vector<string_view>& fields);
+bool parseBatchID(string_view field, int& id);
+bool resolveBatchID(string_view field, const CategoryStore& categories, int& id);
+bool parseBatchHundredths(string_view field, long long& value);
+const char* applyBatchCommand(const vector<string_view>& fields, CategoryStore& categories, Journal& journal,
+	BatchSummary& summary, vector<pair<int, BasisPoints>>& oldPercentages);
+
+//Applies the commands read from the chunks of a batch file to a budget, one at a time in file order
+class BatchApplier {
+	CategoryStore& categories;
+	Journal& journal;
+	BatchSummary summary;
+	vector<pair<long long, const char*>> errors; //Line and reason of each command that was skipped
+	vector<string_view> fields;
+	vector<pair<int, BasisPoints>> oldPercentages;
+	long long lineOffset = 0; //Lines in the chunks already applied
+
+	//Adds to one category the way option 3 does
+	//Returns:		nullptr if the amount was added, otherwise the reason it was not
+	const char* applyAdd(int id, Money amount) {
+		if (!applyToCategory(id, amount, categories))
+			return "ID not found";
+		journal.recordAddToCategory(id, amount);
+		summary.adjustments++;
+		return nullptr;
+	}
+public:
+	BatchApplier(CategoryStore& categories, Journal& journal) : categories(categories), journal(journal) {
+	}
+	const BatchSummary& getSummary() const {
+		return summary;
+	}
+	//Returns the line and reason of each command that was skipped, in the order they were found
+	vector<pair<long long, const char*>>& getErrors() {
+		return errors;
+	}
+
+	//Applies the next chunk of the file
+	void applyChunk(const BatchChunk& chunk) {
+		METRIC_SCOPE(METRIC_BATCH_APPLY);
+		summary.records += chunk.records;
+		for (const pair<long long, const char*>& error : chunk.errors)
+			errors.emplace_back(lineOffset + error.first, error.second);
+		summary.errors += (long long)chunk.errors.size();
+
+		for (const BatchRecord& record : chunk.commands)
+		{
+			const char* error = nullptr;
+			switch (record.type)
+			{
+			case BATCH_DEPOSIT:
+				modifyBalance(record.amount, categories);
+				journal.recordDeposit(record.amount);
+				summary.deposits++;
+				summary.depositTotal += record.amount;
+				break;
+			case BATCH_ADD:
+				error = applyAdd(record.id, record.amount);
+				break;
+			case BATCH_NAMED_ADD:
+			{
+				int index = categories.indexOfName(string_view(record.text, record.textEnd - record.text));
+				error = index <= 0 ? "category not found" : applyAdd(categories.getIDNumber(index), record.amount);
+				break;
+			}
+			case BATCH_COMMAND:
+				splitBatchFields(record.text, record.textEnd, fields);
+				error = applyBatchCommand(fields, categories, journal, summary, oldPercentages);
+				break;
+			}
+			if (error != nullptr)
+			{
+				summary.errors++;
+				errors.emplace_back(lineOffset + record.line, error);
+			}
+		}
+		lineOffset += chunk.lines;
+	}
+};
+
+size_t applyBatchFile(const string& commandsName, ThreadPool& pool, BatchApplier& applier,
+	const CategoryStore& categories);
+
+//How one stage of the pipeline spent its time, and how much it got through
+struct PipelineStage {
+	const char* name = "";
+	const char* unit = "";
+	long long items = 0;
+	double busySeconds = 0;
+	double waitSeconds = 0; //Waiting for the stage before it, or for room in the queue to the stage after it
+};
+
+//How full a queue between two stages was
+struct PipelineQueue {
+	const char* name = "";
+	double averageOccupancy = 0;
+	size_t mostOccupancy = 0;
+	size_t capacity = 0;
+};
+
+struct PipelineReport {
+	PipelineStage stages[PIPELINE_STAGES];
+	PipelineQueue queues[PIPELINE_STAGES - 1];
+};
+
+bool runBatchPipeline(const string& commandsName, BatchApplier& applier, const CategoryStore& categories,
+	Journal& journal, PipelineReport& report);
+int runBatch(const string& budgetName, const string& commandsName, int threadCount, bool pipelined);
+int runReport(const string& budgetName, const ReportOptions& options, const string& outputName);
+
+//Recurring transactions (schedules) are kept in <budget file>.schedules, along with the day they have been
+//applied through. Each schedule is a deposit split between every category, or an amount added to one category,
+//due on a day and then again every few days or months. Advancing the clock applies everything due up to a day,
+//one day at a time: the deposits due on the same day are split together and the additions to each category are
+//summed, and each is written to the journal.
+//The schedules that come due are found with a hierarchical timer wheel, so advancing costs one step per day
+//plus one per schedule that comes due, however many schedules there are.
+const int WHEEL_LEVELS = 4;
+const int WHEEL_FIRST_BITS = 8; //The first level has a slot for each of the next 256 days
+const int WHEEL_LEVEL_BITS = 6; //Each level above has 64 slots, each as long as the whole level below
+const int WHEEL_SLOTS = (1 << WHEEL_FIRST_BITS) + (WHEEL_LEVELS - 1) * (1 << WHEEL_LEVEL_BITS);
+const char SCHEDULE_HEADER[] = "Target,Amount,Next,Every,Unit,Day";
+
+enum ScheduleUnit : uint8_t {
+	SCHEDULE_ONCE,
+	SCHEDULE_DAYS,
+	SCHEDULE_MONTHS
+};
+
+const char* const SCHEDULE_UNIT_NAMES[] = { "once", "days", "months" };
+
+//A deposit or addition that is due again and again
+struct Schedule {
+	Money amount = 0;
+	int64_t nextDay = 0; //The day it is next due, counted from 1970-01-01
+	int target = 0; //The ID of the category to add to, or 0 for a deposit split between every category
+	int every = 1; //The number of days or months between each time it is due
+	int dayOfMonth = 0; //The day of the month a monthly schedule falls on, moved back in shorter months
+	ScheduleUnit unit = SCHEDULE_ONCE;
+};
+
+//The schedules of a budget, sorted by the day each is next due
+//Level 0 has a slot for each of the next 256 days. Each slot of a level above covers a whole turn of the level
+//below, and is spread back out over the levels below when that turn begins, so a schedule is moved at most once
+//per level however far ahead it is due. The schedules are held in the slots themselves, so the ones due on a
+//day are read straight through.
+class TimerWheel {
+	vector<vector<Schedule>> slots = vector<vector<Schedule>>(WHEEL_SLOTS);
+	int64_t currentDay = 0; //Every schedule due on or before this day has been handed out
+	size_t scheduleCount = 0;
+
+	static int levelShift(int level) {
+		return level == 0 ? 0 : WHEEL_FIRST_BITS + (level - 1) * WHEEL_LEVEL_BITS;
+	}
+	static int slotIndex(int level, int64_t day) {
+		if (level == 0)
+			return (int)(day & ((1 << WHEEL_FIRST_BITS) - 1));
+		return (1 << WHEEL_FIRST_BITS) + (level - 1) * (1 << WHEEL_LEVEL_BITS)
+			+ (int)((day >> levelShift(level)) & ((1 << WHEEL_LEVEL_BITS) - 1));
+	}
+	void place(const Schedule& schedule) {
+		//Anything further out than the top level reaches goes round it again
+		int64_t slotDay = min(schedule.nextDay, currentDay + ((int64_t)1 << levelShift(WHEEL_LEVELS)) - 1);
+		int level = 0;
+		while (level + 1 < WHEEL_LEVELS && slotDay - currentDay >= ((int64_t)1 << levelShift(level + 1)))
+			level++;
+		slots[slotIndex(level, slotDay)].push_back(schedule);
+	}
+public:
+	//Empties the wheel and sets the clock, schedules can only be added for later days
+	void reset(int64_t day) {
+		for (vector<Schedule>& slot : slots)
+			slot.clear();
+		currentDay = day;
+		scheduleCount = 0;
+	}
+	int64_t getCurrentDay() const {
+		return currentDay;
+	}
+	size_t size() const {
+		return scheduleCount;
+	}
+	//Adds a schedule, one due on or before the current day comes due on the next day
+	void insert(Schedule schedule) {
+		schedule.nextDay = max(schedule.nextDay, currentDay + 1);
+		place(schedule);
+		scheduleCount++;
+	}
+	//Moves the clock forward one day
+	//Parameters:	vector<Schedule>& due - Receives the schedules due on the new day, which are taken out of the wheel
+	void tick(vector<Schedule>& due) {
+		due.clear();
+		int64_t day = ++currentDay;
+		for (int level = 1; level < WHEEL_LEVELS && (day & (((int64_t)1 << levelShift(level)) - 1)) == 0; level++)
+		{
+			vector<Schedule> moving;
+			moving.swap(slots[slotIndex(level, day)]);
+			for (const Schedule& moved : moving)
+				place(moved);
+		}
+		due.swap(slots[slotIndex(0, day)]);
+		scheduleCount -= due.size();
+	}
+	//Returns every schedule still in the wheel, sorted by the day each is next due
+	vector<Schedule> list() const {
+		vector<Schedule> all;
+		all.reserve(scheduleCount);
+		for (const vector<Schedule>& slot : slots)
+			all.insert(all.end(), slot.begin(), slot.end());
+		stable_sort(all.begin(), all.end(), [](const Schedule& a, const Schedule& b) {
+			return a.nextDay < b.nextDay;
+		});
+		return all;
+	}
+};
+
+void civilFromDays(int64_t days, int& year, int& month, int& day);
+string formatDay(int64_t days);
+int64_t nextScheduleDay(const Schedule& schedule);
+
+//What advancing the schedules did
+struct ScheduleSummary {
+	long long deposits = 0;
+	Money depositTotal = 0;
+	long long additions = 0;
+	long long skipped = 0; //Additions to categories that no longer exist
+};
+
+//The schedules of a budget and the wheel they come due from
+class ScheduleBook {
+	TimerWheel wheel;
+	vector<Schedule> due;
+	vector<Money> amountByID;
+	vector<long long> countByID;
+	vector<int> touchedIDs;
+public:
+	//Starts an empty book, with everything due up to and including the day already applied
+	explicit ScheduleBook(int64_t appliedThrough = 0) {
+		wheel.reset(appliedThrough);
+	}
+	int64_t getAppliedThrough() const {
+		return wheel.getCurrentDay();
+	}
+	//Returns the number of schedules that are still due in the future
+	size_t size() const {
+		return wheel.size();
+	}
+	void add(const Schedule& schedule) {
+		wheel.insert(schedule);
+	}
+
+	//Applies everything due up to and including a day, one day at a time
+	//Parameters:	int64_t toDay - The day to advance to
+	//				CategoryStore& categories - The store of budget categories
+	//				Journal& journal - The journal the changes are recorded in
+	//				ScheduleSummary& summary - Receives what was applied
+	void advance(int64_t toDay, CategoryStore& categories, Journal& journal, ScheduleSummary& summary) {
+		while (wheel.getCurrentDay() < toDay)
+		{
+			if (wheel.size() == 0)
+			{
+				wheel.reset(toDay); //Nothing left to come due
+				break;
+			}
+			wheel.tick(due);
+			if (due.empty())
+				continue;
+
+			Money depositTotal = 0;
+			long long deposits = 0;
+			for (Schedule& schedule : due)
+			{
+				if (schedule.target == 0)
+				{
+					depositTotal += schedule.amount;
+					deposits++;
+				}
+				else
+				{
+					int id = schedule.target;
+					if (id >= (int)amountByID.size())
+					{
+						amountByID.resize(max((size_t)id + 1, amountByID.size() * 2));
+						countByID.resize(amountByID.size());
+					}
+					if (countByID[id] == 0)
+						touchedIDs.push_back(id);
+					amountByID[id] += schedule.amount;
+					countByID[id]++;
+				}
+				schedule.nextDay = nextScheduleDay(schedule);
+				if (schedule.nextDay != -1)
+					wheel.insert(schedule);
+			}
+
+			if (deposits > 0)
+			{
+				modifyBalance(depositTotal, categories);
+				journal.recordDeposit(depositTotal);
+				summary.deposits += deposits;
+				summary.depositTotal += depositTotal;
+			}
+			for (int id : touchedIDs)
+			{
+				if (applyToCategory(id, amountByID[id], categories))
+				{
+					journal.recordAddToCategory(id, amountByID[id]);
+					summary.additions += countByID[id];
+				}
+				else
+					summary.skipped += countByID[id];
+				amountByID[id] = 0;
+				countByID[id] = 0;
+			}
+			touchedIDs.clear();
+		}
+	}
+
+	//Loads the schedules of a budget from <budget file>.schedules
+	//Parameters:	const string& budgetName - The budget file
+	//				int64_t today - The day a book that does not exist yet starts from, with nothing applied on it
+	//Returns:		false if the file is damaged, after outputting an error
+	bool load(const string& budgetName, int64_t today) {
+		string fileName = budgetName + ".schedules";
+		wheel.reset(today - 1);
+		vector<char> buffer;
+		if (!filesystem::exists(fileName))
+			return true;
+		if (!readWholeFile(fileName, buffer))
+			return false;
+
+		vector<string_view> fields;
+		const char* row = buffer.data();
+		const char* fileEnd = buffer.data() + buffer.size();
+		int line = 0;
+		while (row < fileEnd)
+		{
+			const char* rowEnd = (const char*)memchr(row, '\n', fileEnd - row);
+			if (rowEnd == nullptr)
+				rowEnd = fileEnd;
+			const char* next = rowEnd + (rowEnd < fileEnd);
+			if (rowEnd > row && rowEnd[-1] == '\r')
+				rowEnd--;
+			splitBatchFields(row, rowEnd, fields);
+			row = next;
+			line++;
+			if (line == 2 || fields.empty())
+				continue; //The column headers
+
+			int64_t startTime;
+			if (line == 1)
+			{
+				//Applied through,<date>
+				if (fields.size() != 3 || !parseDate(string(fields[2]), startTime))
+				{
+					cout << "Error: " << fileName << " does not start with the day it was applied through.\n";
+					return false;
+				}
+				wheel.reset(startTime / 86400);
+				continue;
+			}
+			Schedule schedule;
+			long long amount;
+			if (fields.size() != 6 || !parseBatchID(fields[0], schedule.target)
+				|| !parseBatchHundredths(fields[1], amount) || !parseDate(string(fields[2]), startTime)
+				|| !parseBatchID(fields[3], schedule.every) || schedule.every <= 0
+				|| !parseBatchID(fields[5], schedule.dayOfMonth))
+			{
+				cout << "Error: Line " << line << " of " << fileName << " is not a valid schedule.\n";
+				return false;
+			}
+			schedule.amount = amount;
+			schedule.nextDay = startTime / 86400;
+			if (fields[4] == "days")
+				schedule.unit = SCHEDULE_DAYS;
+			else if (fields[4] == "months")
+				schedule.unit = SCHEDULE_MONTHS;
+			else
+				schedule.unit = SCHEDULE_ONCE;
+			add(schedule);
+		}
+		return true;
+	}
+
+	//Saves the schedules that are still due to <budget file>.schedules, without leaving a half written file
+	//Parameters:	const string& budgetName - The budget file
+	//Returns:		false if the file could not be written, after outputting an error
+	bool save(const string& budgetName) {
+		string fileName = budgetName + ".schedules";
+		string temporaryName = fileName + ".tmp";
+		{
+			ofstream file(temporaryName, ios::out | ios::binary | ios::trunc);
+			file << "Applied through," << formatDay(getAppliedThrough()) << "\n" << SCHEDULE_HEADER << "\n";
+			for (const Schedule& schedule : wheel.list())
+				file << schedule.target << "," << toDecimalString(schedule.amount) << ","
+					<< formatDay(schedule.nextDay) << "," << schedule.every << "," << SCHEDULE_UNIT_NAMES[schedule.unit]
+					<< "," << schedule.dayOfMonth << "\n";
+			if (!file)
+			{
+				cout << "Error: Could not write " << temporaryName << ".\n";
+				return false;
+			}
+		}
+		error_code renameError;
+		filesystem::rename(temporaryName, fileName, renameError);
+		if (renameError)
+		{
+			cout << "Error: Could not replace " << fileName << ": " << renameError.message() << "\n";
+			return false;
+		}
+		return true;
+	}
+};
+
+int64_t currentDay();
+bool applyDueSchedules(const string& budgetName, int64_t toDay, CategoryStore& categories, Journal& journal,
+	ScheduleSummary& summary);
+void outputScheduleSummary(const ScheduleSummary& summary, int64_t toDay);
+int runAddSchedule(const string& budgetName, const string& target, const string& amount,
+	const string& firstDate, const string& repeat);
+int runAdvance(const string& budgetName, int64_t toDay);
+
+//The percentage solver works out every category's percentage from rules, instead of asking for each one
+//Each group of categories under the same parent is solved on its own, so its percentages always add up to
+//exactly 100%. A category's rules can be:
+//	amount <money>				It should get this much of each month's income
+//	target <money> <date>		Its balance, including sub-categories, should reach this by the date, spread evenly
+//								over the months left
+//	min <percent>, max <percent>	Its percentage must stay within these
+//	priority <number>			Lower numbers get their amounts first when there is not enough income for all
+//	weight <number>				Its part of what is left for the categories without an amount, 1 by default
+//The money a category gets each month is the expected income split down the tree, so a category's amount is
+//turned into a percentage of its parent's share. A category without an amount of its own asks for the amounts
+//of the categories below it. Each group is filled in this order: every category gets its minimum, then the
+//categories with an amount get what they need in order of priority, and what is left is shared by the
+//categories without an amount by weight. Anything left after that goes to the categories with an amount, again
+//in order of priority. No category is ever taken past its maximum. A group where no category has a rule, or an
+//amount below it, keeps the percentages the budget gave it.
+const int RULE_NO_PRIORITY = numeric_limits<int>::max(); //Categories without a priority come after the others
+
+//The rules of one category
+struct CategoryRule {
+	BasisPoints minPercent = 0;
+	BasisPoints maxPercent = ONE_HUNDRED_PERCENT;
+	Money monthlyAmount = 0; //The amounts and targets together, as money needed each month
+	bool hasAmount = false;
+	int priority = RULE_NO_PRIORITY;
+	int weight = 1;
+};
+
+//Solves the percentages of a budget from the rules of its categories, and solves them again when one rule changes
+//A change only solves the groups on the path from main to the category, where the amounts asked for can change,
+//and the groups below them whose share of the income moved and that have amounts to meet. The solver has to be
+//built again after categories are added or removed.
+class PercentageSolver {
+	Money income; //Expected each month
+	vector<CategoryRule> rules; //By index
+	vector<char> hasRules; //Whether each category has any rule set
+	vector<BasisPoints> solved; //The percentage worked out for each category, by index
+	vector<BasisPoints> original; //The budget's own percentages, kept by groups without rules
+	vector<Money> monthlyShares; //The part of each month's income that reaches each category
+	vector<Money> amountsWanted; //Each category's amount, or else the sum of those below it
+	vector<int> amountRulesBelow; //Categories with an amount anywhere below each category
+	vector<char> mustSolve; //Groups whose amounts changed since they were last solved
+	vector<int> groupStart; //The sub-categories of the category at index i are groups[groupStart[i]] onwards
+	vector<int> groups;
+	vector<int> ordered; //The same groups, each with its categories with an amount first in order of priority
+	vector<int> wantingCounts; //The number of categories with an amount in each group of ordered
+	vector<char> orderStale; //Groups whose order has to be worked out again
+	vector<int> parents;
+	vector<pair<int, BasisPoints>> changes; //Index and old percentage of every category changed by the last solve
+	vector<char> seen; //Working space for keepNetChanges
+	vector<BasisPoints> working; //Working space for solveGroup, the percentages of the group being solved
+	vector<int> wanting;
+	vector<int> flexible;
+	vector<pair<long long, int>> remainders;
+	vector<pair<int, Money>> shareChanges; //Index and old share of every category whose share the last solve moved
+
+	bool wantsAmount(int index) const {
+		return rules[index].hasAmount || amountRulesBelow[index] > 0;
+	}
+	//Sets a category's percentage, remembering what it was
+	void setSolved(int index, BasisPoints percent) {
+		if (solved[index] != percent)
+		{
+			changes.emplace_back(index, solved[index]);
+			solved[index] = percent;
+		}
+	}
+	//Hands out part of a group's percentage to the flexible categories by weight, the points rounded off going to
+	//the largest remainders, without taking any past its maximum
+	//Returns:	The percentage left over because every category reached its maximum
+	long long shareOut(long long room) {
+		while (room > 0 && !flexible.empty())
+		{
+			//If every weight is 0 they share evenly
+			long long totalWeight = 0;
+			for (int child : flexible)
+				totalWeight += rules[child].weight;
+			bool even = totalWeight == 0;
+			if (even)
+				totalWeight = (long long)flexible.size();
+			//Any category that would go past its maximum is filled to it, and the rest share what is left again
+			size_t kept = 0;
+			long long filled = 0;
+			for (int child : flexible)
+			{
+				long long space = rules[child].maxPercent - working[child];
+				if (room * (even ? 1 : rules[child].weight) / totalWeight >= space)
+				{
+					working[child] = rules[child].maxPercent;
+					filled += space;
+				}
+				else
+					flexible[kept++] = child;
+			}
+			if (kept < flexible.size())
+			{
+				flexible.resize(kept);
+				room = max(0LL, room - filled);
+				continue;
+			}
+			long long handed = 0;
+			remainders.clear();
+			for (size_t i = 0; i < flexible.size(); i++)
+			{
+				int child = flexible[i];
+				long long weighted = room * (even ? 1 : rules[child].weight);
+				long long share = weighted / totalWeight;
+				remainders.emplace_back(-(weighted % totalWeight), (int)i); //Larger remainders sort first
+				working[child] += (BasisPoints)share;
+				handed += share;
+			}
+			long long leftover = room - handed;
+			if (leftover > 0 && leftover < (long long)remainders.size())
+				nth_element(remainders.begin(), remainders.begin() + leftover, remainders.end());
+			for (long long i = 0; i < leftover; i++)
+				working[flexible[remainders[i].second]]++;
+			room = 0;
+		}
+		return room;
+	}
+	//Solves the percentages of the categories under a parent
+	//Returns:	false if the group's minimums add to more than 100% or its maximums to less
+	bool solveGroup(int parent) {
+		mustSolve[parent] = false;
+		int first = groupStart[parent];
+		int last = groupStart[parent + 1];
+		bool anyRules = false;
+		long long room = ONE_HUNDRED_PERCENT;
+		for (int i = first; i < last; i++)
+		{
+			anyRules = anyRules || hasRules[groups[i]] || wantsAmount(groups[i]);
+			room -= rules[groups[i]].minPercent;
+		}
+		if (!anyRules)
+		{
+			for (int i = first; i < last; i++)
+				setSolved(groups[i], original[groups[i]]);
+			return true;
+		}
+		if (room < 0)
+			return false;
+
+		//The categories with an amount in order of priority, then the others, are only put in order again when a
+		//priority or a category's amount changes
+		if (orderStale[parent])
+		{
+			wanting.clear();
+			flexible.clear();
+			for (int i = first; i < last; i++)
+				(wantsAmount(groups[i]) ? wanting : flexible).push_back(groups[i]);
+			stable_sort(wanting.begin(), wanting.end(), [this](int a, int b) {
+				return rules[a].priority < rules[b].priority;
+			});
+			copy(wanting.begin(), wanting.end(), ordered.begin() + first);
+			copy(flexible.begin(), flexible.end(), ordered.begin() + first + wanting.size());
+			wantingCounts[parent] = (int)wanting.size();
+			orderStale[parent] = false;
+		}
+		else
+		{
+			wanting.assign(ordered.begin() + first, ordered.begin() + first + wantingCounts[parent]);
+			flexible.assign(ordered.begin() + first + wantingCounts[parent], ordered.begin() + last);
+		}
+		for (int i = first; i < last; i++)
+			working[groups[i]] = rules[groups[i]].minPercent;
+
+		Money share = monthlyShares[parent];
+		for (int child : wanting)
+		{
+			long long needed = share > 0 ? (amountsWanted[child] * ONE_HUNDRED_PERCENT + share - 1) / share : 0;
+			long long wanted = min(max(needed, (long long)rules[child].minPercent), (long long)rules[child].maxPercent);
+			long long given = min(room, wanted - working[child]);
+			working[child] += (BasisPoints)given;
+			room -= given;
+		}
+		room = shareOut(room);
+		for (int child : wanting) //Anything left goes to them one at a time, by priority
+		{
+			long long given = min(room, (long long)rules[child].maxPercent - working[child]);
+			working[child] += (BasisPoints)given;
+			room -= given;
+		}
+		if (room != 0)
+			return false;
+		for (int i = first; i < last; i++)
+			setSolved(groups[i], working[groups[i]]);
+		return true;
+	}
+	//Solves a group, then the groups below it that need it, in tree order
+	//Returns:	The index of a group that could not be solved, or -1
+	int solveFrom(int parent, bool everything) {
+		if (!solveGroup(parent))
+			return parent;
+		for (int i = groupStart[parent]; i < groupStart[parent + 1]; i++)
+		{
+			int child = groups[i];
+			Money share = monthlyShares[parent] * solved[child] / ONE_HUNDRED_PERCENT;
+			bool moved = share != monthlyShares[child];
+			if (moved)
+			{
+				shareChanges.emplace_back(child, monthlyShares[child]);
+				monthlyShares[child] = share;
+			}
+			if (groupStart[child + 1] > groupStart[child]
+				&& (everything || mustSolve[child] || (moved && amountRulesBelow[child] > 0)))
+			{
+				int failed = solveFrom(child, everything);
+				if (failed != -1)
+					return failed;
+			}
+		}
+		return -1;
+	}
+	//Keeps only the first change of each category, and drops the ones that ended up where they started
+	void keepNetChanges() {
+		vector<pair<int, BasisPoints>> net;
+		for (const pair<int, BasisPoints>& change : changes)
+		{
+			if (seen[change.first])
+				continue;
+			seen[change.first] = true;
+			if (change.second != solved[change.first])
+				net.push_back(change);
+		}
+		for (const pair<int, BasisPoints>& change : changes)
+			seen[change.first] = false;
+		changes.swap(net);
+	}
+	//Puts back the percentages and shares changed by a solve that failed
+	void undoChanges() {
+		for (size_t i = changes.size(); i-- > 0;)
+			solved[changes[i].first] = changes[i].second;
+		for (size_t i = shareChanges.size(); i-- > 0;)
+			monthlyShares[shareChanges[i].first] = shareChanges[i].second;
+		changes.clear();
+	}
+	//Changes a category's rules, updating the amounts asked for on the path up to main
+	//Returns:	The highest category on the path whose amount asked for changed, or the category itself
+	int storeRule(int index, const CategoryRule& rule) {
+		int highest = index;
+		int change = (int)rule.hasAmount - (int)rules[index].hasAmount;
+		Money oldWanted = amountsWanted[index];
+		bool wantedBefore = wantsAmount(index);
+		if (rule.priority != rules[index].priority || rule.hasAmount != rules[index].hasAmount)
+			orderStale[parents[index]] = true;
+		rules[index] = rule;
+		hasRules[index] = true;
+		if (rule.hasAmount)
+			amountsWanted[index] = rule.monthlyAmount;
+		else
+		{
+			amountsWanted[index] = 0;
+			for (int i = groupStart[index]; i < groupStart[index + 1]; i++)
+				amountsWanted[index] += wantsAmount(groups[i]) ? amountsWanted[groups[i]] : 0;
+		}
+		Money difference = amountsWanted[index] - oldWanted;
+		if (wantedBefore != wantsAmount(index))
+			orderStale[parents[index]] = true;
+		for (int parent = parents[index]; parent >= 0; parent = parents[parent])
+		{
+			bool parentWantedBefore = wantsAmount(parent);
+			amountRulesBelow[parent] += change;
+			if (parentWantedBefore != wantsAmount(parent) && parents[parent] >= 0)
+				orderStale[parents[parent]] = true;
+			if (difference != 0 || change != 0)
+			{
+				mustSolve[parent] = true;
+				highest = parent;
+			}
+			if (!rules[parent].hasAmount) //A category's own amount stands in for everything below it
+				amountsWanted[parent] += difference;
+			else
+				difference = 0;
+		}
+		return highest;
+	}
+public:
+	//Parameters:	const CategoryStore& categories - The budget, whose percentages the solve starts from
+	//				Money monthlyIncome - The income expected each month
+	PercentageSolver(const CategoryStore& categories, Money monthlyIncome) : income(monthlyIncome) {
+		int numOfCategories = categories.size();
+		rules.resize(numOfCategories);
+		hasRules.assign(numOfCategories, false);
+		solved.assign(categories.percentData(), categories.percentData() + numOfCategories);
+		original = solved;
+		working = solved;
+		monthlyShares.assign(numOfCategories, 0);
+		amountsWanted.assign(numOfCategories, 0);
+		amountRulesBelow.assign(numOfCategories, 0);
+		mustSolve.assign(numOfCategories, false);
+		seen.assign(numOfCategories, false);
+		parents.resize(numOfCategories);
+		groupStart.assign(numOfCategories + 1, 0);
+		for (int i = 0; i < numOfCategories; i++)
+		{
+			parents[i] = categories.getParentIndex(i);
+			if (i > 0 && categories.isLive(i))
+				groupStart[parents[i] + 1]++;
+		}
+		for (int i = 0; i < numOfCategories; i++)
+			groupStart[i + 1] += groupStart[i];
+		groups.resize(groupStart[numOfCategories]);
+		vector<int> nextInGroup(groupStart.begin(), groupStart.end() - 1);
+		for (int i = 1; i < numOfCategories; i++)
+			if (categories.isLive(i))
+				groups[nextInGroup[parents[i]]++] = i;
+		ordered.resize(groups.size());
+		wantingCounts.assign(numOfCategories, 0);
+		orderStale.assign(numOfCategories, true);
+	}
+	const CategoryRule& getRule(int index) const {
+		return rules[index];
+	}
+	//Sets a category's rules without solving, call solveAll once every rule has been set
+	void setRule(int index, const CategoryRule& rule) {
+		storeRule(index, rule);
+	}
+	//Solves every group
+	//Returns:	The index of a category whose sub-categories could not be solved, main being 0, or -1
+	int solveAll() {
+		changes.clear();
+		shareChanges.clear();
+		monthlyShares[0] = income;
+		int failed = solveFrom(0, true);
+		if (failed != -1)
+			undoChanges();
+		else
+			keepNetChanges();
+		return failed;
+	}
+	//Changes one category's rules and solves what depends on them, once solveAll has been called
+	//If the rules cannot be met, they are put back along with every percentage
+	//Returns:	The index of a category whose sub-categories could not be solved, or -1
+	int changeRule(int index, const CategoryRule& rule) {
+		CategoryRule oldRule = rules[index];
+		bool oldHasRules = hasRules[index];
+		int highest = storeRule(index, rule);
+		int start = highest == index ? parents[index] : highest;
+		changes.clear();
+		shareChanges.clear();
+		//The shares along the path are only kept up to date where there are amounts below, so work them out again
+		vector<int> path;
+		for (int parent = start; parent > 0; parent = parents[parent])
+			path.push_back(parent);
+		for (size_t i = path.size(); i-- > 0;)
+		{
+			shareChanges.emplace_back(path[i], monthlyShares[path[i]]);
+			monthlyShares[path[i]] = monthlyShares[parents[path[i]]] * solved[path[i]] / ONE_HUNDRED_PERCENT;
+		}
+		int failed = solveFrom(start, false);
+		if (failed != -1)
+		{
+			undoChanges();
+			storeRule(index, oldRule);
+			hasRules[index] = oldHasRules;
+			for (int parent = parents[index]; parent >= 0; parent = parents[parent])
+				mustSolve[parent] = false;
+		}
+		else
+			keepNetChanges();
+		return failed;
+	}
+	//Returns the index and old percentage of every category the last solve changed
+	const vector<pair<int, BasisPoints>>& getChanges() const {
+		return changes;
+	}
+	BasisPoints getPercent(int index) const {
+		return solved[index];
+	}
+};
+
+int runSolve(const string& budgetName, const string& rulesName, Money monthlyIncome);
+
+//Synthetic budgets are made up from a seed, so the same options always give the same budget and commands on
+//every platform. They are used by benchmark mode, and can be written out for batch mode to run.
+
+//The shape of a synthetic budget and its commands
+struct SyntheticOptions {
+	int categoryCount = 1000;
+	int nestedPercent = 30; //Share of categories placed under another category instead of main
+	long long operationCount = 100000;
+	uint64_t seed = 1;
+	//How often each batch command appears, relative to the others
+	int depositWeight = 50;
+	int addWeight = 40;
+	int createWeight = 5;
+	int removeWeight = 4;
+	int percentWeight = 1;
+};
+
+//A small random number generator (SplitMix64) that gives the same numbers on every platform
+class SyntheticRandom {
+	uint64_t state;
+public:
+	explicit SyntheticRandom(uint64_t seed) : state(seed) {
+	}
+	uint64_t next() {
+		uint64_t value = (state += 0x9E3779B97F4A7C15ULL);
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+		return value ^ (value >> 31);
+	}
+	//Returns a number from low to high, including both
+	long long between(long long low, long long high) {
+		return low + (long long)(next() % (uint64_t)(high - low + 1));
+	}
+};
+
+void balanceSyntheticPercentages(CategoryStore& categories, SyntheticRandom& random);
+void generateSyntheticBudget(CategoryStore& categories, const SyntheticOptions& options,
+	SyntheticRandom& random);
+int pickSyntheticCategory(const CategoryStore& categories, SyntheticRandom& random);
+void writeSyntheticCommands(ostream& out, CategoryStore& categories, const SyntheticOptions& options,
+	SyntheticRandom& random);
+int runGenerate(const string& budgetName, const string& commandsName, const SyntheticOptions& options,
+	bool snapshot);
+int readSyntheticOption(int argc, char* argv[], int& i, SyntheticOptions& options);
+
+//Forecasting runs many simulated futures of a budget at once, to see how its percentages hold up when income
+//and expenses are uncertain. Each run starts from the budget's balances and, once a month, draws an income and
+//an expense from their distributions and splits each between the categories the same way modifyBalance does.
+//Runs are spread over a thread pool. The budget itself is only ever read, every run keeps its own balances.
+//Each run draws from its own stream of random numbers, seeded from the seed and the run's number, so the
+//results are the same for any number of threads.
+
+//How a monthly amount is drawn
+enum DistributionKind {
+	DISTRIBUTION_FIXED,	//Always first
+	DISTRIBUTION_NORMAL,	//A mean of first and a standard deviation of second
+	DISTRIBUTION_UNIFORM	//Anywhere from first to second
+};
+
+struct AmountDistribution {
+	DistributionKind kind = DISTRIBUTION_FIXED;
+	Money first = 0;
+	Money second = 0;
+
+	//Returns an amount drawn from the distribution, never below zero
+	Money draw(SyntheticRandom& random) const {
+		double amount = (double)first;
+		if (kind == DISTRIBUTION_NORMAL)
+		{
+			//Box-Muller, so the draws are the same on every platform
+			double u1 = ((random.next() >> 11) + 1) * 0x1.0p-53;
+			double u2 = (random.next() >> 11) * 0x1.0p-53;
+			amount += (double)second * sqrt(-2 * log(u1)) * cos(6.283185307179586 * u2);
+		}
+		else if (kind == DISTRIBUTION_UNIFORM)
+			return max((Money)0, (Money)random.between(min(first, second), max(first, second)));
+		return max((Money)0, (Money)llround(amount));
+	}
+};
+
+//The shape of a forecast
+struct ForecastOptions {
+	int runs = 10000;
+	int months = 12; //At least one
+	AmountDistribution income;
+	AmountDistribution expenses;
+	uint64_t seed = 1;
+	int threadCount = 0; //0 uses one per core
+};
+
+//How each category fared over every run of a forecast, for the live categories in store order
+struct ForecastResult {
+	vector<int> rows; //Indexes of the categories
+	vector<Money> low; //5th percentile of the final balance, including sub-categories
+	vector<Money> median;
+	vector<Money> high; //95th percentile
+	vector<long long> negativeRuns; //Runs in which the balance was below zero at the end of any month
+};
+
+//The groups of sub-categories of a budget, worked out once and shared by every run of a forecast
+//These are the same groups splitDownTree puts together for each split, with each group's percentages side by side
+//so the runs only read them. The balances and the tree itself are read straight from the store.
+class ForecastModel {
+	const CategoryStore& categories;
+	vector<int> groupStart; //The sub-categories of the category at index i are groups[groupStart[i]] onwards
+	vector<int> groups;
+	vector<BasisPoints> groupPercentages;
+public:
+	explicit ForecastModel(const CategoryStore& budget) : categories(budget) {
+		int numOfCategories = categories.size();
+		groupStart.assign(numOfCategories + 1, 0);
+		for (int i = 1; i < numOfCategories; i++)
+			if (categories.isLive(i))
+				groupStart[categories.getParentIndex(i) + 1]++;
+		for (int i = 0; i < numOfCategories; i++)
+			groupStart[i + 1] += groupStart[i];
+		groups.resize(groupStart[numOfCategories]);
+		groupPercentages.resize(groups.size());
+		vector<int> nextInGroup(groupStart.begin(), groupStart.end() - 1);
+		for (int i = 1; i < numOfCategories; i++)
+			if (categories.isLive(i))
+			{
+				groupPercentages[nextInGroup[categories.getParentIndex(i)]] = categories.getPercentOfBudget(i);
+				groups[nextInGroup[categories.getParentIndex(i)]++] = i;
+			}
+	}
+	const CategoryStore& store() const {
+		return categories;
+	}
+	//Splits an amount down the tree the same way splitDownTree does, without changing the store
+	//Parameters:	Money amount - The amount to split, negative to take money away
+	//				Money* balances - Each category's own balance, its share is added to it
+	//				Money* shares - Working space for a share of every category, cleared first
+	//				ScratchArena& scratch - Working space for splitAmount, one for each thread
+	//Returns:		The amount added to the categories directly under main, including everything below them
+	Money split(Money amount, Money* balances, Money* shares, ScratchArena& scratch) const {
+		int numOfCategories = categories.size();
+		fill(shares, shares + numOfCategories, 0);
+		shares[0] = amount;
+		Money addedUnderMain = 0;
+		for (int parent = 0; parent < numOfCategories; parent++)
+		{
+			int first = groupStart[parent];
+			int count = groupStart[parent + 1] - first;
+			if (count == 0 || shares[parent] == 0)
+				continue;
+
+			ScratchScope scope(scratch);
+			Money* groupShares = scratch.take<Money>(count, 0);
+			Money handedDown = splitAmount(shares[parent], groupShares, &groupPercentages[first], count,
+				categories.getChildPercentTotal(parent), scratch);
+			for (int i = 0; i < count; i++)
+			{
+				int child = groups[first + i];
+				if (groupStart[child + 1] > groupStart[child])
+					shares[child] = groupShares[i];
+				else
+					balances[child] += groupShares[i];
+			}
+			if (parent == 0)
+				addedUnderMain = handedDown;
+			else
+				balances[parent] += shares[parent] - handedDown;
+		}
+		return addedUnderMain;
+	}
+};
+
+void runForecastSimulations(const ForecastModel& model, const ForecastOptions& options, ThreadPool& pool,
+	ForecastResult& result);
+bool parseAmountDistribution(const string& text, AmountDistribution& distribution);
+int runForecast(const string& budgetName, const ForecastOptions& options,
+	const vector<pair<string, string>>& percentages);
+
+//Server mode hosts many budgets for clients on a Unix socket, and load mode times a running server
+int runServer(const string& socketPath, int shardCount);
+
+//The number and mix of requests sent in load mode
+struct LoadOptions {
+	int connections = 8;
+	long long requests = 100000; //Over all connections
+	int ledgers = 4;
+	int readPercent = 50; //The rest are writes
+	uint64_t seed = 1;
+};
+
+int runLoadClient(const string& socketPath, const LoadOptions& options);
+
+#endif
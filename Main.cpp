@@ -5,70 +5,14 @@
 //Version:		v1.1.1
 //Version Date: 11/28/2025
 
-#include <iostream>
-#include <string>
-#include <array>
-#include <fstream>
-#include <cctype>
-#include <iomanip>
-#include <limits>
-
-using namespace std;
-
-//Category of the budget with a balance, name, and percentage of income assigned to budget.
-//I.E. Savings, Wants, Needs
-int numOfCategories = 0; //Counts the number of categories currently in existence
-int nextIDNumber = 0;
-class BudgetCategory {
-	string name = "default";
-	double balance = 0.0;
-	double budgetPercentage = 0.0; // 0-1
-	int idNumber = 0; //Wont change, even if the ID beforehand is removed
-public:
-	BudgetCategory() {
-	}
-	BudgetCategory(string name, double balance, double budgetPercentage) {
-		this->name = name;
-		this->balance = balance;
-		this->budgetPercentage = budgetPercentage;
-		numOfCategories++;
-		idNumber = ++nextIDNumber;
-	}
-	void setName(string name) {
-		this->name = name;
-	}
-	string getName() const {
-		return name;
-	}
-	void setBalance(double balance)	{
-		this->balance = balance;
-	}
-	double getBalance() const {
-		return balance;
-	}
-	void setPercentOfBudget(double budgetPercentage) {
-		this->budgetPercentage = budgetPercentage;
-	}
-	double getPercentOfBudget() const {
-		return budgetPercentage;
-	}
-	void setIDNumber(int id) {
-		idNumber = id;
-	}
-	int getIDNumber() const {
-		return idNumber;
-	}
-	void operator + (double number) {
-		balance += number;
-	}
-	bool operator == (const BudgetCategory& cat2) {
-		if (name == cat2.getName())
-			return true;
-		else
-			return false;
-	}
+#include "Budget.h"
 
-};
+//This function converts an amount typed by the user into cents, rounding to the nearest cent
+//Parameters:	double dollars - The amount in dollars
+//Returns:		The amount in cents
+Money static toCents(double dollars) {
+	return llround(dollars * 100.0);
+}
 
 //The clearBuffer function clears the cin buffer. This will clear bad inputs, or do nothing if there is no bad input.
 static void clearBuffer() {
@@ -76,117 +20,6 @@ static void clearBuffer() {
 	std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); //Clear buffer to allow for new input
 }
 
-//This function clears all of the whitespace from a string
-//This is performed by cutting all characters after the first whitespace, so it also clears anything after a space
-//Parameters: string& word - The string to have its whitespace removed
-void static cutWhiteSpace(string& word) {
-	for (int i = 0; i < word.length(); i++)
-	{
-		if (word.at(i) == ' ')
-		{
-			//If there is a whitespace, erase the rest of the word as spaces are not allowed so
-			//this must be the end of the word
-			word.erase(i, (word.length() - i)); 
-		}
-	}
-}
-
-//This function splits off every character in a string that is not a digit or .
-//This allows the resulting string to be converted into a double or float
-//Parameters: string& word - The input string to be reduced to a double
-void static cutToDouble(string& word) {
-	for (int i = 0; i < word.length(); i++)
-	{
-		if (!isdigit(word.at(i)) && word.at(i) != '.')
-		{
-			word.erase(i);
-			i--; //removed the index, so it must go back by one or it will skip a character
-		}
-	}
-}
-
-//This function displays the budget categories to the screen in a readable format
-//Parameters:	BudgetCategory* catPointer - Pointer to an array that contains all of the budget categories
-//				to be output to the screen.
-void static displayToScreen(BudgetCategory* catPointer) {
-	printf("%2s | %14s %14s %14s\n", "ID", "Category    |", "Balance    |",
-		"Percentage   |");
-	for (int i = 0; i < numOfCategories; i++)
-	{
-		printf("%-2d | %-12s | %-12.2f | %-12.2f |\n", (catPointer + i)->getIDNumber(),
-			(catPointer + i)->getName().data(),
-			(catPointer + i)->getBalance(),
-			(catPointer + i)->getPercentOfBudget() * 100);
-	}
-}
-
-//This function saves all of the categories to a file, in roughly the same format as displayToScreen
-//Ideally this function will be saved as a .txt file
-//Parameters:	fstream& file - A pointer that leads to the output file
-//				BudgetCategory* catPointer - A pointer that leads to the array of all budget categories to be saved
-//				int numOfCategories - Stores the total number of categories, including main, in the array
-void static saveToFile(fstream& file, BudgetCategory* catPointer, int numOfCategories) {
-	//ID |   Category    |     Balance    |     Percentage
-	file << setw(2) << right << "ID | "
-		<< setw(14) << right << "Category     | " << setw(14) 
-		<< right << "Balance    | " << setw(14) << right << "Percentage   |\n";
-	for (int i = 0; i < numOfCategories; i++)
-	{
-		//Name, Balance, Percentage
-		file << setw(2) << left << (catPointer + i)->getIDNumber() << " | "
-			<< setw(12) << left << (catPointer + i)->getName() << " | " <<
-			setw(11) << left << fixed << showpoint << setprecision(2) << (catPointer + i)->getBalance() << " | "
-			<< setw(13) << left << fixed << showpoint << setprecision(2) << (catPointer + i)->getPercentOfBudget() * 100
-			<< "|";
-
-		//Add a newline as long as this is not the final line, as this messes up loading saves
-		if (i != numOfCategories - 1)
-			file << "\n";
-	}
-}
-
-//This function modifies the balance contained within all budget categories
-//The balance is distributed based on the percentageOfBudget variable for each category, all adding up to 100%
-//Parameters:	double balanceModification - Variable that contains the amount of money to be added/removed
-//				BudgetCategory* catPointer - Pointer that leads to the array of budget categories
-void static modifyBalance(double balanceModification, BudgetCategory* catPointer) {
-	for (int i = 0; i < numOfCategories; i++)
-	{
-		//Sets the new balance as currentBalance + (balanceModification * percentOfBudget)
-		//Aka it adds the income, taking account the category percentage, into each category
-		(catPointer + i)->setBalance((catPointer + i)->getBalance() +
-		((catPointer + i)->getPercentOfBudget() * balanceModification));
-	}
-}
-
-//This function gets the accumulated percentage of all budget categories
-//This is useful for ensuring that all of the categories add up to 100%
-//Parameters:	BudgetCategory* catPointer - Pointer that leads to the array of budget categories
-//Returns:	The total accumulated percentage of all categories as a double
-double static getTotalPercentage(BudgetCategory* catPointer) {
-	double totalPercent = 0.0; //Accumulator
-	for (int i = 1; i < numOfCategories; i++)
-	{
-		totalPercent += (catPointer + i)->getPercentOfBudget();
-	}
-
-	return totalPercent;
-}
-
-//This function gets the total balance value of each budget category
-//This is useful for allocating a balance to the total category
-//Parameters:	BudgetCategory* catPointer - Pointer that leads to the array containing the budget categories
-//Returns:		The total accumulated balance in all of the budget categories
-double static getTotalValue(BudgetCategory* catPointer) {
-	double totalBalance = 0.0;
-	for (int i = 1; i < numOfCategories; i++)
-	{
-		totalBalance += (catPointer + i)->getBalance();
-	}
-
-	return totalBalance;
-}
-
 //This function determines if the inputted integer value refers to the main category
 //The main category is defined as being ID 1
 //If the category is main, an error message is sent, and if not then the buffer is cleared
@@ -207,218 +40,554 @@ bool static isMainCat(int i) {
 }
 
 //This function outputs list of all budget categories and their associated IDs
-//Parameters:	BudgetCategory* catPointer - A pointer to the array of budget categories
-void static outputIDAndCats(BudgetCategory* catPointer) {
-	
-	printf("%2s | %-14s\n", "ID", "Category");
-	for (int i = 0; i < numOfCategories; i++)
-	{
-		printf("%2d | %-14s\n", (catPointer + i)->getIDNumber(),
-			(catPointer+i)->getName().data());
-	}
+//Parameters:	const CategoryStore& categories - The store of budget categories
+void static outputIDAndCats(const CategoryStore& categories) {
+	ReportOptions options;
+	options.format = REPORT_ID_LIST;
+	ReportWriter writer(cout);
+	renderReport(categories, options, writer);
 }
 
 //This function prompts the user to select how much balance they wish to add/subtract from a specific category
 //The specific category is decided by the parameters
 //The buffer is cleared after the user input, which prevents an invalid input from crashing the program
-//In order to find the ID, first the index equal to the ID is checked, and then if not found, a manual 
-//search is performed to find the valid ID
+//The category is found through the ID index of the store, so no searching is needed
 //Parameters:	int IDChoice - the ID of the category to be modified
-//				BudgetCategory* catPointer - Pointer that leads to the array of budget categories
-void static addToCategory(int IDChoice, BudgetCategory* catPointer) {
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+//				UndoHistory& undo - The history the change is recorded in, to be undone
+void static addToCategory(int IDChoice, CategoryStore& categories, Journal& journal, UndoHistory& undo) {
 	double modification = 0;
-	bool foundID = false;
 	
 	cout << "Enter the amount to add to the category, enter a negative value to subtract: ";
 	std::cin >> modification;
 	clearBuffer(); //Cut off invalid input
 
-	//If the IDs are in order this avoids searching the entire array
-	//First part of the statement will prevent an out of bounds exception by ensuring that
-	//IDChoice - 1 is a valid index
-	if ((IDChoice <= numOfCategories && IDChoice > 0)
-		&& (catPointer + (IDChoice - 1))->getIDNumber() == IDChoice)
-	{
-		(catPointer + (IDChoice - 1))->operator+(modification);
-		foundID = true;
-	}
-	else //Have to search for the right ID number
-	{
-		//Start at index 1, as index 0 is total which should not be modified
-		for (int i = 1; i < numOfCategories; i++)
-		{
-			if ((catPointer + i)->getIDNumber() == IDChoice)
-			{
-				(catPointer + i)->operator+(modification);
-				foundID = true;
-			}
-		}
-	}
-
-	if (!foundID)
+	if (!applyToCategory(IDChoice, toCents(modification), categories))
 		cout << "ID not found, no addition/subtraction performed";
 	else
-		catPointer->setBalance(getTotalValue(catPointer));
+	{
+		journal.recordAddToCategory(IDChoice, toCents(modification));
+		UndoRecord change;
+		change.type = UNDO_ADD_TO_CATEGORY;
+		change.id = IDChoice;
+		change.amount = toCents(modification);
+		undo.record(std::move(change));
+	}
 }
 
 //This function outputs a list of each category and their current percentage of the budget
-//Parameters:	BudgetCategory* catPointer - Pointer to the array of budget categories
-void static outputCatsAndPercents(BudgetCategory* catPointer) {
-	for (int i = 0; i < numOfCategories; i++)
-	{
-		//Multiply percent by 100 to get the full digit percent (I.E. 45.9%)
-		printf("%-14s | %-4.1f%%\n", (catPointer + i)->getName().data(), 
-			((catPointer + i)->getPercentOfBudget() * 100));
-	}
+//Parameters:	const CategoryStore& categories - The store of budget categories
+void static outputCatsAndPercents(const CategoryStore& categories) {
+	ReportOptions options;
+	options.format = REPORT_PERCENT_LIST; //Percentages to one place (I.E. 45.9%)
+	ReportWriter writer(cout);
+	renderReport(categories, options, writer);
 }
 
-//This function checks if a percentage is not 100%, defined as being a double value == 1.0
-//If the value is not 100%, an error message will be displayed
-//Parameters:		double percent - the double percentage to be checked
-//Returns:			if double != 1.0 true is returned
+//This function checks if the percentages of any group of categories are not 100%, defined as being exactly
+//10000 basis points. Each group is the categories directly under main, or directly under another category
+//If a group is not 100%, an error message will be displayed
+//Parameters:		const CategoryStore& categories - The store of budget categories
+//Returns:			if a group's total != 10000 true is returned
 //					else false is returned
-bool static notOneHundredPercent(double percent) {
-	if (percent != 1.0)
+bool static notOneHundredPercent(const CategoryStore& categories) {
+	int group = findUnbalancedGroup(categories);
+	if (group == 0)
 	{
 		cout << "Error: Total percent does not equal 100%. Please re-enter the values.\n";
 		return true;
 	}
+	else if (group > 0)
+	{
+		cout << "Error: Total percent under " << categories.getName(group)
+			<< " does not equal 100%. Please re-enter the values.\n";
+		return true;
+	}
 	else
 		return false;
 }
 
-//This function prompts the user to enter a new percentage for each individual category within the array
+//This function prompts the user to enter a new percentage for each individual category within the store
 //The buffer is cleared after each input, preventing invalid inputs from crashing the program
 //If the total value is equal to 100%, the function returns, otherwise it loops again until the total percent is 100
-//Parameters:	BudgetCategory* catPointer - Pointer that leads to the list of budget categories
-void static setNewPercentages(BudgetCategory* catPointer) {
+//Only the percentages that changed are kept for undo
+//Parameters:	CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+//				UndoHistory& undo - The history the change is recorded in, to be undone
+void static setNewPercentages(CategoryStore& categories, Journal& journal, UndoHistory& undo) {
 	cout << "List of Categories:\n";
-	outputCatsAndPercents(catPointer);
+	outputCatsAndPercents(categories);
 	cout << "\n";
+	vector<BasisPoints> oldPercentages(categories.percentData(), categories.percentData() + categories.size());
+	UndoRecord change;
+	change.type = UNDO_SET_PERCENTAGES;
+	change.mainPercent = categories.getPercentOfBudget(0);
 
 	double categoryPercent;
 	do {
 		//Start at index 1 to avoid setting total
-		for (int i = 1; i < numOfCategories; i++)
+		for (int i = 1; i < categories.size(); i++)
 		{
-			cout << "Enter the percentage for the " << (catPointer + i)->getName() << 
-				" category in decimal format (ex: 45.2): ";
+			if (!categories.isLive(i))
+				continue;
+			cout << "Enter the percentage for the " << categories.getName(i) << " category";
+			if (categories.getParentIndex(i) > 0)
+				cout << " (of " << categories.getName(categories.getParentIndex(i)) << ")";
+			cout << " in decimal format (ex: 45.2): ";
 			std::cin >> categoryPercent;
 			clearBuffer(); //If an invalid input gets stuck, this will clear it and allow the program to continue.
-			categoryPercent /= 100.0;
-			(catPointer + i)->setPercentOfBudget(categoryPercent);
+			if (categoryPercent < 0.0 || categoryPercent > 100.0)
+			{
+				cout << "Error: A percentage must be between 0 and 100.\n";
+				i--; //Ask for this category again
+				continue;
+			}
+			categories.setPercentOfBudget(i, (BasisPoints)llround(categoryPercent * 100.0)); //45.2% is 4520 basis points
 		}
-	} while (notOneHundredPercent(getTotalPercentage(catPointer)));
+	} while (notOneHundredPercent(categories));
 
-	catPointer->setPercentOfBudget(getTotalPercentage(catPointer));
+	updateMainPercentage(categories);
+	journal.recordPercentages(categories);
+	for (int i = 1; i < categories.size(); i++)
+	{
+		if (!categories.isLive(i) || categories.getPercentOfBudget(i) == oldPercentages[i])
+			continue;
+		putUndoValue<int32_t>(change.data, categories.getIDNumber(i));
+		putUndoValue<int32_t>(change.data, oldPercentages[i]);
+	}
+	change.data.shrink_to_fit();
+	undo.record(std::move(change));
 
 	cout << "\nPercentages set:\n";
-	outputCatsAndPercents(catPointer);
+	outputCatsAndPercents(categories);
 
 }
 
-//This function adds a new category to the list of categories
-//The function prompts the user to enter a name and balance, and will initialize the percentage as
-//100% if it is the first non-main category, otherwise as 0%
+//This function adds a new category to the store of categories
+//The function prompts the user to enter a name, balance, and the category to place it under, and will
+//initialize the percentage as 100% if it is the first category under its parent, otherwise as 0%
 //The buffer is cleared after each input, preventing a bad input from crashing the program
-//Parameters:	BudgetCategory* catPointer - Pointer to the array of budget categories
-void static addNewCategory(BudgetCategory* catPointer) {
+//Parameters:	CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+//				UndoHistory& undo - The history the change is recorded in, to be undone
+void static addNewCategory(CategoryStore& categories, Journal& journal, UndoHistory& undo) {
 	string catName;
 	double startingBalance;
-	double startingPercentage;
 	cout << "Enter a name for the new category (Do not include spaces): ";
 	std::cin >> catName;
 	clearBuffer(); //Clear the buffer just in case user included a space, this prevents it from jamming other inputs
 	cout << "Enter a starting balance for the category: ";
 	std::cin >> startingBalance;
 	clearBuffer(); //Clear buffer in case non-int is inputted, will result to some sort of int in startingBalance
+	outputIDAndCats(categories);
+	cout << "Enter the ID of the category to place it under (1 for main): ";
+	int parentID = 1;
+	std::cin >> parentID;
+	clearBuffer();
 	cout << "Percent of Budget will be initialized as 0 or 100, the ID will be automatically chosen.\n";
 
-	catPointer->operator+(startingBalance); //Add the new balance to main
-
-	catPointer += numOfCategories;
-
-	//If this is the only category besides main, it is 100%
-	if ((numOfCategories - 1) == 0)
-		startingPercentage = 1.0;
+	BasisPoints mainPercent = categories.getPercentOfBudget(0);
+	int id = createCategory(catName, toCents(startingBalance), categories, 0, parentID);
+	if (id == 0)
+		cout << "ID " << parentID << " not found, no category created.\n";
+	else if (id == -1)
+		cout << "A category named " << catName << " already exists, no category created.\n";
 	else
-		startingPercentage = 0.0;
-
-	*catPointer = BudgetCategory(catName, startingBalance, startingPercentage);
+	{
+		journal.recordNewCategory(id, parentID, toCents(startingBalance), catName);
+		UndoRecord change;
+		change.type = UNDO_NEW_CATEGORY;
+		change.id = id;
+		change.parentID = parentID;
+		change.amount = toCents(startingBalance);
+		change.mainPercent = mainPercent;
+		change.data.assign(catName.begin(), catName.end());
+		undo.record(std::move(change));
+	}
 }
 
-//This function erases a budget category from the array, removing the percentages and balances from the total
-//The function also moves every single category after the removed category back by 1, so there are no gaps
-//Parameters:	BudgetCategory* catPointer - Pointer to the array of categories
-//				int index - index (not ID) of the category to be removed
-void static eraseArrayCategory(BudgetCategory* catPointer, int index) {
-	numOfCategories--;
-
-	catPointer->setBalance(catPointer->getBalance() 
-		- ((catPointer + index))->getBalance()); //Remove this cat balance from total
-	catPointer->setPercentOfBudget(catPointer->getPercentOfBudget() 
-		- ((catPointer + index))->getPercentOfBudget()); //Remove this cat percentage from total
-	
-	catPointer += index; //Set the pointer to the index to be erased
+//This function facilitates the removal of a category within the store of categories
+//The category is found through the ID index of the store
+//If the category is found, it is removed, and a message is output confirming the removal
+//If the category is not found, an error message is output
+//Parameters:	int IDChoice - The ID of the category to be removed
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the change is recorded in
+//				UndoHistory& undo - The history the change is recorded in, to be undone
+void static removeCategory(int IDChoice, CategoryStore& categories, Journal& journal, UndoHistory& undo) {
+	int countBefore = categories.liveCount();
+	UndoRecord change;
+	int indexOfRemoval = deleteCategoryForUndo(IDChoice, categories, change);
+
+	if (indexOfRemoval > 0)
+	{
+		journal.recordRemoveCategory(IDChoice);
+		undo.record(std::move(change));
+		cout << "ID " << IDChoice << " found at index " << indexOfRemoval << " and removed";
+		if (countBefore - categories.liveCount() > 1)
+			cout << " along with its " << countBefore - categories.liveCount() - 1 << " sub-categories";
+		cout << ".\n";
+	}
+	else
+		cout << "ID " << IDChoice << " not found.\n";
+}
 
-	//Move everything past the index back by one space
-	for (index; index < numOfCategories; index++)
+//This function undoes the last change made from the menu, or redoes the last change undone
+//Parameters:	UndoHistory& undo - The changes that can be undone and redone
+//				CategoryStore& categories - The store of budget categories
+//				Journal& journal - The journal the changes are recorded in
+void static undoOrRedo(UndoHistory& undo, CategoryStore& categories, Journal& journal) {
+	int choice;
+	cout << "1. Undo";
+	if (undo.canUndo())
+		cout << " " << describeChange(undo.nextUndo(), categories);
+	cout << " (" << undo.undoCount() << " changes can be undone)\n2. Redo";
+	if (undo.canRedo())
+		cout << " " << describeChange(undo.nextRedo(), categories);
+	cout << " (" << undo.redoCount() << " changes can be redone)\nChoice: ";
+	std::cin >> choice;
+	clearBuffer();
+
+	if (choice == 1)
 	{
-		*catPointer = *(catPointer + 1);
-		catPointer++;
+		if (!undo.canUndo())
+		{
+			cout << "Nothing to undo.\n";
+			return;
+		}
+		cout << "Undid " << describeChange(undo.nextUndo(), categories) << ".\n";
+		undoChange(undo.nextUndo(), categories, journal);
+		undo.undone();
 	}
+	else if (choice == 2)
+	{
+		if (!undo.canRedo())
+		{
+			cout << "Nothing to redo.\n";
+			return;
+		}
+		cout << "Redid " << describeChange(undo.nextRedo(), categories) << ".\n";
+		redoChange(undo.nextRedo(), categories, journal);
+		undo.redone();
+	}
+	else
+		cout << "Error, invalid choice\n";
+}
 
-	//Now that everything has been moved back, there is one extra category at the last pointer location
-	//that will be set to default
-	*catPointer = BudgetCategory();
+//This function shows the balance history of a category, either its balance at the end of a day or the money
+//that came in and went out of it in each month of a year
+//Removed categories can still be looked up by their ID
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				const BalanceHistory& history - The history of the budget
+void static showHistory(const CategoryStore& categories, const BalanceHistory& history) {
+	if (!history.isOpen())
+	{
+		cout << "The balance history is recorded once the budget has been loaded or saved.\n";
+		return;
+	}
 
+	int IDChoice;
+	int queryChoice;
+	cout << "List of Categories:\n";
+	outputIDAndCats(categories);
+	cout << "Select a category ID: ";
+	std::cin >> IDChoice;
+	clearBuffer();
+	int index = categories.indexOf(IDChoice);
+	string catName = index >= 0 ? string(categories.getName(index)) : "ID " + to_string(IDChoice);
+	cout << "1. Balance at the end of a day\n2. Money in and out for each month of a year\nChoice: ";
+	std::cin >> queryChoice;
+	clearBuffer();
+
+	if (queryChoice == 1)
+	{
+		string date;
+		int64_t dayStart;
+		cout << "Enter the date (YYYY-MM-DD, UTC): ";
+		std::cin >> date;
+		clearBuffer();
+		if (!parseDate(date, dayStart))
+		{
+			cout << "Error: " << date << " is not a valid date.\n";
+			return;
+		}
+		cout << catName << " on " << date << ": "
+			<< toDecimalString(history.balanceAt(IDChoice, dayStart + 86400 - 1)) << "\n";
+	}
+	else if (queryChoice == 2)
+	{
+		int year;
+		cout << "Enter the year: ";
+		std::cin >> year;
+		clearBuffer();
+		ReportWriter writer(cout);
+		writer.padded("Month", 7);
+		writer.text(" | ");
+		writer.padded("In", 12);
+		writer.text(" | ");
+		writer.padded("Out", 12);
+		writer.text(" | ");
+		writer.padded("Net", 12);
+		writer.text(" |\n");
+		for (int month = 1; month <= 12; month++)
+		{
+			int64_t from = daysFromCivil(year, month, 1) * 86400;
+			int64_t to = daysFromCivil(month == 12 ? year + 1 : year, month == 12 ? 1 : month + 1, 1) * 86400;
+			HistoryFlows flows = history.flowsBetween(IDChoice, from, to);
+			string yearText = to_string(year);
+			writer.character('0', yearText.size() < 4 ? 4 - yearText.size() : 0);
+			writer.text(yearText);
+			writer.text(month < 10 ? "-0" : "-");
+			writer.number(month);
+			writer.text(" | ");
+			writer.hundredths(flows.inflow, 12);
+			writer.text(" | ");
+			writer.hundredths(flows.outflow, 12);
+			writer.text(" | ");
+			writer.hundredths(flows.inflow + flows.outflow, 12);
+			writer.text(" |\n");
+		}
+	}
+	else
+		cout << "Error, invalid choice\n";
 }
 
-//This function facilitates the removal of a category within the array of categories
-//First the category is found by ID, first by checking if the category is at the index = ID, then by checking
-//through the array.
-//If the category is found, eraseArrayCategory is called, and a message is output confirming the removal
-//If the category is not found, an error message is output
-//Parameters:	int IDChoice - The ID of the category to be removed
-//				BudgetCategory* catPointer - Pointer to the array of budget categories
-void static removeCategory(int IDChoice, BudgetCategory* catPointer) {
-	int indexOfRemoval = 0;
-	bool foundID = false;
-
-	//Check the ID in order first, in case the IDs are still ordered in the array
-	if ((catPointer + (IDChoice - 1))->getIDNumber() == IDChoice)
+int main(int argc, char* argv[]) {
+	atexit(writeMetricsFile);
+	//BudgetProgram --convert <input> <output> converts between text saves and binary snapshots
+	if (argc == 4 && string(argv[1]) == "--convert")
+		return convertBudgetFile(argv[2], argv[3]) ? 0 : 1;
+	//BudgetProgram --batch <budget file> [commands file] [--threads N] [--pipeline] applies commands without prompts
+	if (argc >= 3 && string(argv[1]) == "--batch")
 	{
-		foundID = true;
-		indexOfRemoval = IDChoice - 1;
+		string commandsName = "-";
+		int threadCount = 0;
+		bool pipelined = false;
+		for (int i = 3; i < argc; i++)
+		{
+			if (string(argv[i]) == "--threads" && i + 1 < argc)
+				threadCount = atoi(argv[++i]);
+			else if (string(argv[i]) == "--pipeline")
+				pipelined = true;
+			else
+				commandsName = argv[i];
+		}
+		return runBatch(argv[2], commandsName, threadCount, pipelined);
+	}
+	//BudgetProgram --report <budget file> [--format table|text|csv|json] [--negative] [--top N]
+	//[--page N --page-size N] [--output <file>] writes a report of a budget without prompts
+	if (argc >= 3 && string(argv[1]) == "--report")
+	{
+		ReportOptions options;
+		string outputName = "-";
+		int page = 0;
+		int pageSize = 50;
+		for (int i = 3; i < argc; i++)
+		{
+			string option = argv[i];
+			if (option == "--negative")
+				options.onlyNegative = true;
+			else if (i + 1 >= argc)
+			{
+				cout << "Error: " << option << " is missing its value.\n";
+				return 1;
+			}
+			else if (option == "--format")
+			{
+				string format = argv[++i];
+				if (format == "table")
+					options.format = REPORT_TABLE;
+				else if (format == "text")
+					options.format = REPORT_SAVE;
+				else if (format == "csv")
+					options.format = REPORT_CSV;
+				else if (format == "json")
+					options.format = REPORT_JSON;
+				else
+				{
+					cout << "Error: Unknown report format " << format << ".\n";
+					return 1;
+				}
+			}
+			else if (option == "--top")
+				options.topCount = atoi(argv[++i]);
+			else if (option == "--page")
+				page = atoi(argv[++i]);
+			else if (option == "--page-size")
+				pageSize = atoi(argv[++i]);
+			else if (option == "--output")
+				outputName = argv[++i];
+			else
+			{
+				cout << "Error: Unknown report option " << option << ".\n";
+				return 1;
+			}
+		}
+		if (page > 0)
+		{
+			options.firstRow = (page - 1) * max(1, pageSize);
+			options.rowLimit = max(1, pageSize);
+		}
+		return runReport(argv[2], options, outputName);
 	}
-	else //Otherwise it will have to be found manually
+	//BudgetProgram --generate <budget file> [commands file] [--snapshot] [synthetic options] writes a synthetic budget
+	if (argc >= 2 && string(argv[1]) == "--generate")
 	{
-		while (indexOfRemoval < numOfCategories && !foundID)
+		SyntheticOptions options;
+		vector<string> names;
+		bool snapshot = false;
+		for (int i = 2; i < argc; i++)
 		{
-			if ((catPointer + indexOfRemoval)->getIDNumber() == IDChoice)
-				foundID = true;
+			int read = readSyntheticOption(argc, argv, i, options);
+			if (read == -1)
+				return 1;
+			else if (read == 1)
+				continue;
+			string option = argv[i];
+			if (option == "--snapshot")
+				snapshot = true;
+			else if (option.rfind("--", 0) != 0)
+				names.push_back(option);
 			else
-				indexOfRemoval++;
+			{
+				cout << "Error: Unknown option " << option << ".\n";
+				return 1;
+			}
 		}
+		if (names.empty() || names.size() > 2)
+		{
+			cout << "Error: Expected --generate <budget file> [commands file].\n";
+			return 1;
+		}
+		return runGenerate(names[0], names.size() == 2 ? names[1] : "", options, snapshot);
+	}
+	//BudgetProgram --schedule <budget file> <deposit|ID|name> <amount> <first date> <repeat> adds a schedule
+	if (argc == 7 && string(argv[1]) == "--schedule")
+		return runAddSchedule(argv[2], argv[3], argv[4], argv[5], argv[6]);
+	//BudgetProgram --advance <budget file> [--to <date>] applies the schedules due through today, or the date
+	if ((argc == 3 || argc == 5) && string(argv[1]) == "--advance")
+	{
+		int64_t toDay = currentDay();
+		int64_t startTime;
+		if (argc == 5)
+		{
+			if (string(argv[3]) != "--to" || !parseDate(argv[4], startTime))
+			{
+				cout << "Error: Expected --advance <budget file> [--to YYYY-MM-DD].\n";
+				return 1;
+			}
+			toDay = startTime / 86400;
+		}
+		return runAdvance(argv[2], toDay);
+	}
+	//BudgetProgram --solve <budget file> <rules file> [--income <amount>] sets the percentages from rules
+	if ((argc == 4 || argc == 6) && string(argv[1]) == "--solve")
+	{
+		long long income = 0;
+		if (argc == 6 && (string(argv[4]) != "--income" || !parseBatchHundredths(argv[5], income) || income < 0))
+		{
+			cout << "Error: Expected --solve <budget file> <rules file> [--income <amount>].\n";
+			return 1;
+		}
+		return runSolve(argv[2], argv[3], income);
+	}
+	//BudgetProgram --forecast <budget file> [--runs N] [--months N] [--income <distribution>]
+	//[--expenses <distribution>] [--percent <ID|name> <percent>]... [--seed N] [--threads N] simulates the budget
+	if (argc >= 3 && string(argv[1]) == "--forecast")
+	{
+		ForecastOptions options;
+		vector<pair<string, string>> percentages;
+		for (int i = 3; i < argc; i++)
+		{
+			string option = argv[i];
+			if (i + 1 >= argc || (option == "--percent" && i + 2 >= argc))
+			{
+				cout << "Error: " << option << " is missing its value.\n";
+				return 1;
+			}
+			else if (option == "--runs")
+				options.runs = max(1, atoi(argv[++i]));
+			else if (option == "--months")
+				options.months = max(1, atoi(argv[++i]));
+			else if (option == "--seed")
+				options.seed = strtoull(argv[++i], nullptr, 10);
+			else if (option == "--threads")
+				options.threadCount = atoi(argv[++i]);
+			else if (option == "--percent")
+			{
+				percentages.emplace_back(argv[i + 1], argv[i + 2]);
+				i += 2;
+			}
+			else if (option == "--income" || option == "--expenses")
+			{
+				if (!parseAmountDistribution(argv[++i], option == "--income" ? options.income : options.expenses))
+				{
+					cout << "Error: " << argv[i] << " is not an amount, normal:<mean>,<deviation> or "
+						<< "uniform:<low>,<high>.\n";
+					return 1;
+				}
+			}
+			else
+			{
+				cout << "Error: Unknown option " << option << ".\n";
+				return 1;
+			}
+		}
+		return runForecast(argv[2], options, percentages);
+	}
+	//BudgetProgram --serve <socket path> [--workers N] hosts many budgets for clients on a Unix socket
+	if (argc >= 3 && string(argv[1]) == "--serve")
+	{
+		int shardCount = 0;
+		if (argc == 5 && string(argv[3]) == "--workers")
+			shardCount = atoi(argv[4]);
+		return runServer(argv[2], shardCount);
 	}
 
-	if (foundID)
+	//BudgetProgram --load <socket path> [--connections N] [--requests N] [--ledgers N] [--reads <percent>] [--seed N]
+	//sends requests to a running server from many connections at once, timing every reply
+	if (argc >= 3 && string(argv[1]) == "--load")
 	{
-		eraseArrayCategory(catPointer, indexOfRemoval);
-		cout << "ID " << IDChoice << " found at index " << indexOfRemoval << " and removed.\n";
+		LoadOptions options;
+		for (int i = 3; i < argc; i++)
+		{
+			string option = argv[i];
+			if (i + 1 >= argc)
+			{
+				cout << "Error: " << option << " is missing its value.\n";
+				return 1;
+			}
+			else if (option == "--connections")
+				options.connections = max(1, atoi(argv[++i]));
+			else if (option == "--requests")
+				options.requests = max(1LL, atoll(argv[++i]));
+			else if (option == "--ledgers")
+				options.ledgers = max(1, atoi(argv[++i]));
+			else if (option == "--reads")
+				options.readPercent = atoi(argv[++i]);
+			else if (option == "--seed")
+				options.seed = strtoull(argv[++i], nullptr, 10);
+			else
+			{
+				cout << "Error: Unknown option " << option << ".\n";
+				return 1;
+			}
+		}
+		return runLoadClient(argv[2], options);
 	}
-	else
-		cout << "ID " << IDChoice << " not found.\n";
-}
 
-int main() {
+	//BudgetProgram --undo-memory <MiB> sets how much undo history the menu keeps
+	size_t undoMemory = UNDO_MEMORY_LIMIT;
+	if (argc == 3 && string(argv[1]) == "--undo-memory")
+		undoMemory = (size_t)max(0LL, atoll(argv[2])) << 20;
+
 	bool menu1 = true; //Loop menu 1
 	bool menu2 = true; //Loop menu 2
-	const int MAX_CATEGORIES = 10; //Max number of categories by default //In the future this can be dynamically expanded when needed.
-	array<BudgetCategory, MAX_CATEGORIES> categories;
-	fstream file; //The file used for output and input
+	CategoryStore categories; //Grows as categories are added, there is no fixed limit
+	Journal journal; //Records every change once the budget has a file
+	UndoHistory undo(undoMemory); //Changes made from the menu, newest last
 
-	bool fileInput = false;
 	//First menu, for loading file or creating new file
 	while (menu1)
 	{
@@ -430,16 +599,20 @@ int main() {
 		switch (choice)
 		{
 			case 1:
-				categories[0] = BudgetCategory("main", 0.0, 1.0);
+				categories.add("main", 0, ONE_HUNDRED_PERCENT);
 				menu1 = false;
 				break;
 			case 2:
 				cout << "Enter the name of your file: ";
 				std::getline(std::cin, fileName); //Clear previous input
 				std::getline(std::cin, fileName);
-				file.open(fileName, ios::in);
-				menu1 = false;
-				fileInput = true;
+				if (openBudget(fileName, categories, journal))
+				{
+					ScheduleSummary summary;
+					if (applyDueSchedules(fileName, currentDay(), categories, journal, summary))
+						outputScheduleSummary(summary, currentDay());
+					menu1 = false; //Otherwise the error was output, so ask again
+				}
 				break;
 			case 3:
 				menu1 = false;
@@ -453,115 +626,50 @@ int main() {
 
 	}
 
-	if (fileInput)
-	{
-		string output;
-		double totalBalance = 0.0;
-		double totalPercentage = 0.0;
-		//Input file info
-		BudgetCategory* currentCat = categories.data(); //Pointer for array
-		//cout << "CurrentPos = " << file.tellg() << "\n";
-		std::getline(file, output); //Clear the first line, as it is for formatting
-		currentCat->setName("main"); //Add main, which will not be imported and instead re-created
-		currentCat->setIDNumber(1);
-		nextIDNumber = currentCat->getIDNumber() + 1; //Set to the next valid ID after this one
-		numOfCategories++; //Increment the number of categories to include main
-
-		currentCat++; //Start adding to the next category
-		std::getline(file, output); //Clear the second line, as it is for main
-
-		while (!file.eof())
-		{
-			//First category is always main, even if user manually changed the name
-			//main budget percent will be calculated through accumulator, and the balance will be
-			//calculated through accumulator. This prevents manual meddling
-			//ID
-			//cout << "CurrentPos = " << file.tellg() << "\n";
-			std::getline(file, output, '|'); //Extract until | character
-			cutToDouble(output); //Cut to a number, cutToDouble will still work correcly
-			//cout << "DEBUG: cut to double results in " << output << "\n";
-			currentCat->setIDNumber(stoi(output));
-			//cout << "CurrentPos = " << file.tellg() << "\n";
-			//Clear the space character, as the cut functions will delete the entire output if
-			//they detect it.
-			std::getline(file, output, ' ');
-				
-			//name
-			std::getline(file, output, '|'); //Extract until | character
-			//cout << "DEBUG: getline results in " << output << "\n";
-			cutWhiteSpace(output); //Cut off the white space from the string, as this is the name
-			//cout << "DEBUG: name results in " << output << "\n";
-			currentCat->setName(output);
-			std::getline(file, output, ' ');
-
-			//balance
-			std::getline(file, output, '|'); //Extract until | character
-			cutToDouble(output); //Cut all chars that are not digits or .
-			//cout << "DEBUG: cut to double 2 results in " << output << "\n";
-			currentCat->setBalance(stod(output));
-			totalBalance += currentCat->getBalance();
-			std::getline(file, output, ' ');
-
-			//budgetPercentage
-			std::getline(file, output, '|'); //Extract until | character
-			cutToDouble(output); //Cut all chars that are not digits or .
-			//cout << "DEBUG: cut to double 3 results in " << output << "\n";
-			currentCat->setPercentOfBudget(stod(output) / 100.0); //Divide by 100 to get the 0-1 percentage
-			totalPercentage += currentCat->getPercentOfBudget();
-
-			std::getline(file, output); //Clear the rest of the line
-			numOfCategories++;
-			nextIDNumber = currentCat->getIDNumber(); //Whatever this ID is is the most recent valid ID
-			currentCat++;
-			//cout << "DEBUG: End of loop\n";
-		}
-
-		currentCat = categories.data();
-		currentCat->setBalance(totalBalance); //Assign the total balance
-		currentCat->setPercentOfBudget(totalPercentage); //Assign the total percentage
-
-		file.close();
-
-	}
-
-
 	while (menu2) //Second menu for manipulating file
 	{
 		int choice;
 		cout << "\n1. Display\n2. Add/Subtract balance\n3. Add/Subtract from category\n" << 
 			"4. Modify category percentage\n5. Add/Remove category\n" << 
-			"6. Save File\n7. Exit\nChoice: ";
+			"6. Save File\n7. Balance history\n8. Undo/Redo\n9. Exit\nChoice: ";
 		std::cin >> choice;
 
 		char yOrNChoice;
 		double moneyAmount;
 		int IDChoice;
 		string fileName;
-		fstream file2 = fstream();
+		int formatChoice;
 		switch (choice)
 		{
 		case 1: //Display
-			displayToScreen(categories.data());
+			displayToScreen(categories);
 			break;
 		case 2: //Add/Subtract balance
 			cout << "How much balance are you adding? (enter a negative value for subtraction): ";
 			std::cin >> moneyAmount;
 			clearBuffer(); //If the user entered an invalid value, it will get cut off of the input.
-			modifyBalance(moneyAmount, categories.data());
+			modifyBalance(toCents(moneyAmount), categories);
+			journal.recordDeposit(toCents(moneyAmount));
+			{
+				UndoRecord change;
+				change.type = UNDO_DEPOSIT;
+				change.amount = toCents(moneyAmount);
+				undo.record(std::move(change));
+			}
 			break;
 		case 3: //Add/Subtract from category
 			cout << "List of Categories:\n";
-			outputIDAndCats(categories.data());
+			outputIDAndCats(categories);
 			do {
 				cout << "Select a category ID other than main to modify: ";
 				std::cin >> IDChoice;
 			} while (isMainCat(IDChoice)); //Buffer clear is present in this function, invalid IDChoice becomes 0.
-			addToCategory(IDChoice, categories.data());
+			addToCategory(IDChoice, categories, journal, undo);
 			break;
 		case 4: //Modify category percentage
-			if (numOfCategories > 1)
+			if (categories.liveCount() > 1)
 			{
-				setNewPercentages(categories.data());
+				setNewPercentages(categories, journal, undo);
 			}
 			else
 			{
@@ -570,36 +678,45 @@ int main() {
 			break;
 		case 5: //Add/Remove category
 			cout << "List of Categories:\n";
-			outputIDAndCats(categories.data());
+			outputIDAndCats(categories);
 			do {
 				cout << "Select a category ID to remove, or select a negative value to add " << 
 					"a new category (You cannot select main): ";
 				std::cin >> IDChoice;
 			} while (isMainCat(IDChoice)); //Makes sure it is not main, and clears buffer in case of error
-			if (IDChoice <= 0 && numOfCategories < 10)
+			if (IDChoice <= 0)
 			{
-				addNewCategory(categories.data());
-			}
-			else if (IDChoice <= 0 && numOfCategories >= 10)
-			{
-				cout << "ERROR: There is a limit of 10 categories. Please remove a category to add a new one.\n";
+				addNewCategory(categories, journal, undo);
 			}
 			else
 			{
-				removeCategory(IDChoice, categories.data());
+				removeCategory(IDChoice, categories, journal, undo);
 			}
 			break;
 		case 6: //Save File
 			cout << "Enter the name of the new file (This will override a file if it already exists): ";
 			std::getline(std::cin, fileName);
 			std::getline(std::cin, fileName);
-			file2.open(fileName, ios::out); //Deletes any old data then writes to file
-			saveToFile(file2, categories.data(), numOfCategories);
-			file2.close();
+			cout << "Save as 1. Text or 2. Binary snapshot (faster to save and load): ";
+			std::cin >> formatChoice;
+			clearBuffer();
+			//Once saved, the journal of this file holds every later change
+			if (saveBudgetChanges(fileName, categories, journal, formatChoice == 2))
+				attachHistory(categories, journal);
+			break;
+		case 7: //Balance history
+			showHistory(categories, journal.getHistory());
+			break;
+		case 8: //Undo/Redo
+			undoOrRedo(undo, categories, journal);
 			break;
-		case 7: //Exit
-			cout << "Are you sure you wish to exit? If you have not saved a file " <<
-				"your data will be lost (y/n): ";
+		case 9: //Exit
+			if (journal.isOpen())
+				cout << "Are you sure you wish to exit? Unsaved changes are kept in the journal of " <<
+					journal.getBudgetName() << " (y/n): ";
+			else
+				cout << "Are you sure you wish to exit? If you have not saved a file " <<
+					"your data will be lost (y/n): ";
 			std::cin >> yOrNChoice;
 			if (yOrNChoice == 'y' || yOrNChoice == 'Y')
 				menu2 = false;
@@ -610,7 +727,9 @@ int main() {
 			break;
 		}
 
+		if (journal.needsCompaction())
+			saveBudgetChanges(journal.getBudgetName(), categories, journal, journal.isBudgetSnapshot());
 	}
 	
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,698 @@
+//Name:			Budget Server
+//Description:	Server mode, hosting many budgets for clients on a Unix socket, and the load client
+
+#include "Budget.h"
+
+//Server mode hosts many budgets (ledgers) in one process, taking commands over a local Unix socket
+//Each command is one line, the ledger file name followed by the command and its values:
+//	<ledger> display							Replies with OK <count>, then one line per category: ID name balance percentage parent
+//	<ledger> total								Replies with OK <total balance> <total percentage>
+//	<ledger> deposit <amount>					Splits the amount between the categories
+//	<ledger> add <ID> <amount>					Adds the amount to one category
+//	<ledger> create <name> <starting balance> [parent ID]	Creates a category, replying with OK <ID>
+//	<ledger> remove <ID>						Removes a category
+//	<ledger> percent <ID> <percent> ...			Sets percentages, which must then total 100%
+//	<ledger> save								Saves the ledger to its file and empties its journal
+//Every other reply is OK, or ERROR followed by the reason. A ledger that does not exist yet is started as a new budget.
+//Any <ID> can also be given as the category's name.
+//Each ledger belongs to one shard, and each shard has one worker thread that applies every change to its
+//ledgers in order. After each group of changes the worker publishes a new read-only view of the ledger through
+//an atomic pointer. display and total load the latest view and never lock or wait on the worker; a replaced view
+//is freed by the worker once no reader can still be using it, see EpochReclaimer.
+const int SERVER_JOURNAL_GROUP = 1 << 20; //Ledger journals are flushed once per group of changes instead
+
+//Lets readers use objects that a writer replaces, without locks, by freeing a replaced object only once every
+//reader that might have loaded it has finished. Each reader has a slot, and marks it with the current epoch while
+//it reads. The writer moves to the next epoch each time it replaces an object, and keeps the replaced object until
+//every slot that is reading shows a later epoch.
+class EpochReclaimer {
+public:
+	//One reader's slot, kept once made and handed to the next reader once its reader is done with it
+	struct alignas(64) Slot {
+		atomic<uint64_t> epoch{ 0 }; //The epoch the reader started reading in, 0 while it is not reading
+		atomic<bool> taken{ false };
+		Slot* next = nullptr;
+	};
+private:
+	atomic<uint64_t> currentEpoch{ 1 };
+	atomic<Slot*> slots{ nullptr };
+public:
+	EpochReclaimer() = default;
+	EpochReclaimer(const EpochReclaimer&) = delete;
+	EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+	~EpochReclaimer() {
+		for (Slot* slot = slots.load(); slot != nullptr; )
+		{
+			Slot* next = slot->next;
+			delete slot;
+			slot = next;
+		}
+	}
+	//Gives a new reader a slot, reusing one whose reader is done
+	Slot* join() {
+		for (Slot* slot = slots.load(); slot != nullptr; slot = slot->next)
+		{
+			bool free = false;
+			if (slot->taken.compare_exchange_strong(free, true))
+				return slot;
+		}
+		Slot* slot = new Slot();
+		slot->taken = true;
+		slot->next = slots.load();
+		while (!slots.compare_exchange_weak(slot->next, slot))
+			;
+		return slot;
+	}
+	void leave(Slot* slot) {
+		slot->epoch.store(0);
+		slot->taken.store(false);
+	}
+	//Called by a reader before it loads a pointer to a shared object, and after it is done with the object
+	void startReading(Slot* slot) {
+		slot->epoch.store(currentEpoch.load());
+	}
+	void stopReading(Slot* slot) {
+		slot->epoch.store(0, memory_order_release);
+	}
+	//Called by the writer after it has replaced the pointer to an object
+	//Returns:		The epoch the old object was retired in, for canFree
+	uint64_t retire() {
+		return currentEpoch.fetch_add(1);
+	}
+	//Returns true if no reader can still be using an object retired in the epoch
+	bool canFree(uint64_t retiredEpoch) const {
+		for (Slot* slot = slots.load(); slot != nullptr; slot = slot->next)
+		{
+			uint64_t reading = slot->epoch.load();
+			if (reading != 0 && reading <= retiredEpoch)
+				return false;
+		}
+		return true;
+	}
+};
+
+//The categories of a ledger view, which are shared by every view until a category is added, removed, moved or
+//renamed, so that a change to balances only has to copy the balances and percentages
+struct LedgerLayout {
+	long long version; //The store's layout version this was built from
+	vector<int> indexes; //The index of each live category in the store
+	vector<int> ids;
+	vector<string_view> names; //Point into nameBlocks
+	vector<int> parentIDs; //0 for main
+	vector<shared_ptr<const char[]>> nameBlocks; //The store's name blocks, kept alive while the view is in use
+};
+
+//A read-only copy of the live categories of a ledger
+struct LedgerView {
+	shared_ptr<const LedgerLayout> layout;
+	vector<Money> balances; //Including sub-categories
+	vector<BasisPoints> percentages;
+};
+
+//A budget hosted by the server. Only its shard's worker touches categories and journal
+struct Ledger {
+	string fileName;
+	CategoryStore categories;
+	Journal journal;
+	bool snapshot = false;
+	atomic<const LedgerView*> view{ nullptr }; //Replaced only by the shard's worker, see EpochReclaimer
+	int shard = 0;
+	vector<pair<int, BasisPoints>> oldPercentages; //Scratch space for undoing a bad percent command
+	~Ledger() {
+		delete view.load();
+	}
+};
+
+//A change waiting for a shard's worker
+struct LedgerRequest {
+	Ledger* ledger;
+	const vector<string_view>* fields; //The command and its values, in the client's buffer until the reply is sent
+	promise<string> reply;
+};
+
+//This function builds a read-only view of a ledger's categories
+//The IDs, names and parents are shared with the previous view while the store's layout has not changed
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				const LedgerView* previous - The view being replaced, or nullptr
+//Returns:		The new view
+unique_ptr<LedgerView> static buildLedgerView(const CategoryStore& categories, const LedgerView* previous) {
+	unique_ptr<LedgerView> view = make_unique<LedgerView>();
+	if (previous != nullptr && previous->layout->version == categories.getLayoutVersion())
+		view->layout = previous->layout;
+	else
+	{
+		shared_ptr<LedgerLayout> layout = make_shared<LedgerLayout>();
+		layout->version = categories.getLayoutVersion();
+		layout->nameBlocks.assign(categories.getNameBlocks().begin(), categories.getNameBlocks().end());
+		layout->indexes.reserve(categories.liveCount());
+		layout->ids.reserve(categories.liveCount());
+		layout->names.reserve(categories.liveCount());
+		layout->parentIDs.reserve(categories.liveCount());
+		for (int i = 0; i < categories.size(); i++)
+		{
+			if (!categories.isLive(i))
+				continue;
+			layout->indexes.push_back(i);
+			layout->ids.push_back(categories.getIDNumber(i));
+			layout->names.push_back(categories.getName(i));
+			layout->parentIDs.push_back(i == 0 ? 0 : categories.getIDNumber(categories.getParentIndex(i)));
+		}
+		view->layout = std::move(layout);
+	}
+
+	const vector<int>& indexes = view->layout->indexes;
+	view->balances.resize(indexes.size());
+	view->percentages.resize(indexes.size());
+	for (size_t i = 0; i < indexes.size(); i++)
+	{
+		view->balances[i] = indexes[i] == 0 ? categories.getBalance(0) : categories.getBranchTotal(indexes[i]);
+		view->percentages[i] = categories.getPercentOfBudget(indexes[i]);
+	}
+	return view;
+}
+
+//This function applies a change to a ledger, called only by the ledger's shard worker
+//Parameters:	Ledger& ledger - The ledger to change
+//				const vector<string_view>& fields - The command and its values
+//Returns:		The reply to send back
+string static applyServerCommand(Ledger& ledger, const vector<string_view>& fields) {
+	METRIC_SCOPE(METRIC_SERVER_COMMAND);
+	string_view command = fields[0];
+	int id;
+	long long amount;
+	if (command == "deposit")
+	{
+		if (fields.size() != 2 || !parseBatchHundredths(fields[1], amount))
+			return "ERROR expected deposit <amount>";
+		modifyBalance(amount, ledger.categories);
+		ledger.journal.recordDeposit(amount);
+		return "OK";
+	}
+	if (command == "add")
+	{
+		if (fields.size() != 3 || !resolveBatchID(fields[1], ledger.categories, id)
+			|| !parseBatchHundredths(fields[2], amount))
+			return "ERROR expected add <ID> <amount>";
+		if (!applyToCategory(id, amount, ledger.categories))
+			return "ERROR ID not found";
+		ledger.journal.recordAddToCategory(id, amount);
+		return "OK";
+	}
+	if (command == "save")
+	{
+		if (!saveBudgetChanges(ledger.fileName, ledger.categories, ledger.journal, ledger.snapshot))
+			return "ERROR could not save";
+		return "OK";
+	}
+
+	//create, remove and percent work the same as in batch mode
+	BatchSummary summary;
+	const char* error = applyBatchCommand(fields, ledger.categories, ledger.journal, summary, ledger.oldPercentages);
+	if (error != nullptr)
+		return string("ERROR ") + error;
+	if (command == "create")
+		return "OK " + to_string(ledger.categories.getNextIDNumber());
+	return "OK";
+}
+
+//A worker thread that applies every change to the ledgers of one shard
+class LedgerShard {
+	mutex queueLock;
+	condition_variable queueReady;
+	vector<LedgerRequest*> queue;
+	bool stopping = false;
+	EpochReclaimer& viewEpochs;
+	vector<pair<uint64_t, const LedgerView*>> retiredViews; //Replaced views, with the epoch each was retired in
+	thread worker;
+
+	//Publishes a new view of a ledger, and frees the replaced views no reader can still be using
+	void publishView(Ledger& ledger) {
+		const LedgerView* old = ledger.view.load();
+		ledger.view.store(buildLedgerView(ledger.categories, old).release());
+		retiredViews.emplace_back(viewEpochs.retire(), old);
+		size_t kept = 0;
+		for (const pair<uint64_t, const LedgerView*>& retired : retiredViews)
+		{
+			if (viewEpochs.canFree(retired.first))
+				delete retired.second;
+			else
+				retiredViews[kept++] = retired;
+		}
+		retiredViews.resize(kept);
+	}
+
+	void workerLoop() {
+		vector<LedgerRequest*> batch;
+		vector<Ledger*> changed;
+		vector<string> replies;
+		while (true)
+		{
+			{
+				unique_lock<mutex> guard(queueLock);
+				queueReady.wait(guard, [&] { return stopping || !queue.empty(); });
+				if (stopping && queue.empty())
+					return;
+				batch.swap(queue);
+			}
+
+			//Apply the whole group, then flush each journal and publish each view once
+			for (LedgerRequest* request : batch)
+			{
+				replies.push_back(applyServerCommand(*request->ledger, *request->fields));
+				if (find(changed.begin(), changed.end(), request->ledger) == changed.end())
+					changed.push_back(request->ledger);
+			}
+			for (Ledger* ledger : changed)
+			{
+				ledger->journal.commit();
+				//A long journal is folded into the ledger's file, the same as the menu does
+				if (ledger->journal.needsCompaction())
+					saveBudgetChanges(ledger->fileName, ledger->categories, ledger->journal, ledger->snapshot);
+				publishView(*ledger);
+			}
+			for (size_t i = 0; i < batch.size(); i++)
+				batch[i]->reply.set_value(std::move(replies[i]));
+			batch.clear();
+			changed.clear();
+			replies.clear();
+		}
+	}
+public:
+	explicit LedgerShard(EpochReclaimer& viewEpochs) : viewEpochs(viewEpochs), worker(&LedgerShard::workerLoop, this) {
+	}
+	~LedgerShard() {
+		{
+			lock_guard<mutex> guard(queueLock);
+			stopping = true;
+		}
+		queueReady.notify_all();
+		worker.join();
+		for (const pair<uint64_t, const LedgerView*>& retired : retiredViews)
+			delete retired.second;
+	}
+	//Queues a change for the worker, the reply arrives through the request's promise
+	void submit(LedgerRequest* request) {
+		{
+			lock_guard<mutex> guard(queueLock);
+			queue.push_back(request);
+		}
+		queueReady.notify_one();
+	}
+};
+
+//The ledgers hosted by the server and the shards that change them
+class LedgerServer {
+	//A ledger in the server's table, added before its file is loaded. loaded is set once loading has finished, to
+	//the ledger or to nullptr if it could not be loaded, so only the clients of that ledger wait on its file.
+	struct LedgerSlot {
+		unique_ptr<Ledger> ledger;
+		shared_future<Ledger*> loaded;
+	};
+	EpochReclaimer viewEpochs; //Made before the shards and the ledgers, so it outlives them
+	mutex ledgersLock;
+	unordered_map<string, LedgerSlot> ledgers;
+	vector<unique_ptr<LedgerShard>> shards;
+public:
+	//Parameters:	int shardCount - The number of worker threads, 0 uses one per core
+	explicit LedgerServer(int shardCount) {
+		if (shardCount <= 0)
+			shardCount = max(1, (int)thread::hardware_concurrency());
+		for (int i = 0; i < shardCount; i++)
+			shards.push_back(make_unique<LedgerShard>(viewEpochs));
+	}
+
+	//This function finds a ledger, loading it from its file the first time it is used
+	//Clients that ask for the ledger while it is loading wait for that same load
+	//Parameters:	const string& fileName - The ledger's file, which must be in the server's directory
+	//				string& error - Receives the reason if the ledger cannot be used
+	//Returns:		The ledger, or nullptr if it cannot be used
+	Ledger* getLedger(const string& fileName, string& error) {
+		if (fileName.empty() || fileName[0] == '.' || fileName.find_first_of("/\\") != string::npos)
+		{
+			error = "ERROR ledger names cannot contain paths";
+			return nullptr;
+		}
+		promise<Ledger*> loading;
+		shared_future<Ledger*> loaded;
+		{
+			lock_guard<mutex> guard(ledgersLock);
+			auto found = ledgers.find(fileName);
+			if (found != ledgers.end())
+				loaded = found->second.loaded;
+			else
+				ledgers[fileName].loaded = loading.get_future().share();
+		}
+		if (loaded.valid())
+		{
+			Ledger* ledger = loaded.get();
+			if (ledger == nullptr)
+				error = "ERROR could not load " + fileName;
+			return ledger;
+		}
+
+		//The file is loaded without holding the table, so other ledgers can be used meanwhile
+		unique_ptr<Ledger> opened = make_unique<Ledger>();
+		opened->fileName = fileName;
+		bool loadedFile = openOrCreateBudget(fileName, opened->categories, opened->journal);
+		if (loadedFile)
+		{
+			opened->snapshot = opened->journal.isBudgetSnapshot();
+			opened->journal.setSyncBatchSize(SERVER_JOURNAL_GROUP);
+			opened->shard = (int)(hash<string>()(fileName) % shards.size());
+			opened->view.store(buildLedgerView(opened->categories, nullptr).release());
+		}
+		Ledger* ledger = opened.get();
+		{
+			lock_guard<mutex> guard(ledgersLock);
+			if (loadedFile)
+				ledgers[fileName].ledger = std::move(opened);
+			else
+			{
+				ledgers.erase(fileName); //The next client to use it tries again
+				ledger = nullptr;
+			}
+		}
+		loading.set_value(ledger);
+		if (ledger == nullptr)
+			error = "ERROR could not load " + fileName;
+		return ledger;
+	}
+
+	//Returns the readers of the ledger views, each connection joins before its first line
+	EpochReclaimer& getViewEpochs() {
+		return viewEpochs;
+	}
+
+	//This function handles one line from a client
+	//Parameters:	const char* row - The start of the line
+	//				const char* rowEnd - One past the end of the line
+	//				vector<string_view>& fields - Scratch space for the values, reused between lines
+	//				EpochReclaimer::Slot* reader - The connection's slot for reading ledger views
+	//Returns:		The reply, without the final line break
+	string handleLine(const char* row, const char* rowEnd, vector<string_view>& fields, EpochReclaimer::Slot* reader) {
+		splitBatchFields(row, rowEnd, fields);
+		//metrics [json] returns the operation timings of the whole server, which belong to no ledger
+		if (!fields.empty() && fields[0] == "metrics")
+		{
+			string text = formatMetrics(fields.size() > 1 && fields[1] == "json");
+			if (text.empty())
+				return "ERROR metrics are not built in";
+			text.pop_back();
+			return "OK " + to_string(count(text.begin(), text.end(), '\n') + 1) + "\n" + text;
+		}
+		if (fields.size() < 2)
+			return "ERROR expected <ledger> <command>";
+		string error;
+		Ledger* ledger = getLedger(string(fields[0]), error);
+		if (ledger == nullptr)
+			return error;
+
+		//Reads use the latest published view, without waiting on the shard
+		if (fields[1] == "display" || fields[1] == "total")
+		{
+			string reply;
+			viewEpochs.startReading(reader);
+			const LedgerView* view = ledger->view.load();
+			const LedgerLayout& layout = *view->layout;
+			if (fields[1] == "total")
+				reply = "OK " + toDecimalString(view->balances[0]) + " " + toDecimalString(view->percentages[0]);
+			else
+			{
+				reply = "OK " + to_string(layout.ids.size());
+				for (size_t i = 0; i < layout.ids.size(); i++)
+				{
+					reply += "\n" + to_string(layout.ids[i]) + " ";
+					reply += layout.names[i];
+					reply += " " + toDecimalString(view->balances[i]) + " " + toDecimalString(view->percentages[i])
+						+ " " + to_string(layout.parentIDs[i]);
+				}
+			}
+			viewEpochs.stopReading(reader);
+			return reply;
+		}
+
+		//The values stay where they are, as this thread waits for the reply before reading the next line
+		fields.erase(fields.begin());
+		LedgerRequest request;
+		request.ledger = ledger;
+		request.fields = &fields;
+		future<string> reply = request.reply.get_future();
+		shards[ledger->shard]->submit(&request);
+		return reply.get();
+	}
+};
+#ifndef _WIN32
+//This function answers every line sent by one client until it disconnects
+//Parameters:	LedgerServer& server - The server handling the commands
+//				int connection - The client's socket
+void static serveConnection(LedgerServer& server, int connection) {
+	vector<char> buffer(1 << 16);
+	size_t filled = 0;
+	string replies;
+	vector<string_view> fields;
+	EpochReclaimer::Slot* reader = server.getViewEpochs().join();
+	while (true)
+	{
+		if (filled == buffer.size())
+			buffer.resize(buffer.size() * 2);
+		long received = recv(connection, buffer.data() + filled, buffer.size() - filled, 0);
+		if (received <= 0)
+			break;
+		filled += (size_t)received;
+
+		//Answer every complete line, then send the replies together
+		const char* cursor = buffer.data();
+		const char* dataEnd = buffer.data() + filled;
+		const char* lineEnd;
+		while ((lineEnd = (const char*)memchr(cursor, '\n', dataEnd - cursor)) != nullptr)
+		{
+			const char* rowEnd = (lineEnd > cursor && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+			if (skipSpaces(cursor, rowEnd) != rowEnd)
+			{
+				replies += server.handleLine(cursor, rowEnd, fields, reader);
+				replies += '\n';
+			}
+			cursor = lineEnd + 1;
+		}
+		filled = dataEnd - cursor;
+		memmove(buffer.data(), cursor, filled);
+
+		size_t sent = 0;
+		while (sent < replies.size())
+		{
+			long written = send(connection, replies.data() + sent, replies.size() - sent, MSG_NOSIGNAL);
+			if (written <= 0)
+				break;
+			sent += (size_t)written;
+		}
+		replies.clear();
+	}
+	server.getViewEpochs().leave(reader);
+	close(connection);
+}
+#endif
+
+//This function runs server mode, accepting clients on a Unix socket until the program is stopped
+//Parameters:	const string& socketPath - Where to create the socket
+//				int shardCount - The number of worker threads, 0 uses one per core
+//Returns:		1 if the server could not be started
+int runServer(const string& socketPath, int shardCount) {
+#ifdef _WIN32
+	cout << "Error: Server mode is not supported on Windows.\n";
+	return 1;
+#else
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (socketPath.length() >= sizeof(address.sun_path))
+	{
+		cout << "Error: The socket path is too long.\n";
+		return 1;
+	}
+	strcpy(address.sun_path, socketPath.c_str());
+	unlink(socketPath.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener == -1 || ::bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0)
+	{
+		cout << "Error: Could not listen on " << socketPath << ".\n";
+		return 1;
+	}
+
+	LedgerServer server(shardCount);
+	cout << "Serving ledgers on " << socketPath << "\n";
+	while (true)
+	{
+		int connection = accept(listener, nullptr, nullptr);
+		if (connection == -1)
+			continue;
+		thread(serveConnection, ref(server), connection).detach();
+	}
+#endif
+}
+
+//Load mode connects many clients to a running server and times every reply, to see how it holds up under load.
+//Each connection sends one request at a time to a random ledger, a read (total) or a write (deposit or add), and
+//waits for the reply before sending the next. The ledgers are named loadtest1, loadtest2 and so on, and are left
+//in the server's directory afterwards.
+const int LOAD_LEDGER_CATEGORIES = 4; //Categories created in each ledger for the adds, named Load1, Load2 and so on
+#ifndef _WIN32
+//One client connection to the server, sending a line and reading back its reply
+class LoadConnection {
+	int connection = -1;
+	string received;
+public:
+	~LoadConnection() {
+		if (connection != -1)
+			close(connection);
+	}
+	//Returns false if the server could not be reached
+	bool open(const string& socketPath) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (socketPath.length() >= sizeof(address.sun_path))
+			return false;
+		strcpy(address.sun_path, socketPath.c_str());
+		connection = socket(AF_UNIX, SOCK_STREAM, 0);
+		return connection != -1 && connect(connection, (sockaddr*)&address, sizeof(address)) == 0;
+	}
+	//Sends one line and reads the first line of its reply, returning false if the connection was lost
+	bool request(const string& line, string& reply) {
+		size_t sent = 0;
+		while (sent < line.size())
+		{
+			long written = send(connection, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+			if (written <= 0)
+				return false;
+			sent += (size_t)written;
+		}
+		size_t lineEnd;
+		while ((lineEnd = received.find('\n')) == string::npos)
+		{
+			char buffer[4096];
+			long count = recv(connection, buffer, sizeof(buffer), 0);
+			if (count <= 0)
+				return false;
+			received.append(buffer, (size_t)count);
+		}
+		reply.assign(received, 0, lineEnd);
+		received.erase(0, lineEnd + 1);
+		return true;
+	}
+};
+#endif
+
+//This function writes the percentiles of a set of reply times
+//Parameters:	const string& name - What the requests were
+//				vector<long long>& nanoseconds - The time of each reply, which is sorted
+void static outputLatencies(const string& name, vector<long long>& nanoseconds) {
+	sort(nanoseconds.begin(), nanoseconds.end());
+	auto percentile = [&](double fraction) {
+		return nanoseconds[min(nanoseconds.size() - 1, (size_t)(fraction * nanoseconds.size()))] / 1000.0;
+	};
+	cout << "  " << left << setw(8) << name << right << setw(12) << nanoseconds.size();
+	if (!nanoseconds.empty())
+		cout << setw(12) << percentile(0.5) << setw(12) << percentile(0.99) << setw(12) << percentile(0.999);
+	cout << "\n";
+}
+
+//This function runs load mode, sending requests to a server from many connections at once
+//Parameters:	const string& socketPath - The server's socket
+//				const LoadOptions& options - The number and mix of requests
+//Returns:		0 if every request was answered, otherwise 1
+int runLoadClient(const string& socketPath, const LoadOptions& options) {
+#ifdef _WIN32
+	cout << "Error: Load mode is not supported on Windows.\n";
+	return 1;
+#else
+	//Each ledger is given a few categories splitting it evenly, for the writes to use
+	LoadConnection setup;
+	if (!setup.open(socketPath))
+	{
+		cout << "Error: Could not connect to " << socketPath << ".\n";
+		return 1;
+	}
+	string reply;
+	for (int ledger = 0; ledger < options.ledgers; ledger++)
+	{
+		//A ledger kept from an earlier run already has the categories, so those creates are refused
+		string ledgerName = "loadtest" + to_string(ledger + 1);
+		string percentages;
+		for (int i = 0; i < LOAD_LEDGER_CATEGORIES; i++)
+		{
+			if (!setup.request(ledgerName + " create Load" + to_string(i + 1) + " 0\n", reply))
+			{
+				cout << "Error: The connection to " << socketPath << " was lost.\n";
+				return 1;
+			}
+			percentages += " Load" + to_string(i + 1) + " " + toDecimalString(ONE_HUNDRED_PERCENT / LOAD_LEDGER_CATEGORIES);
+		}
+		setup.request(ledgerName + " percent" + percentages + "\n", reply);
+	}
+
+	vector<vector<long long>> readTimes(options.connections);
+	vector<vector<long long>> writeTimes(options.connections);
+	atomic<long long> errors{ 0 };
+	atomic<int> lostConnections{ 0 };
+	ThreadPool pool(options.connections);
+	auto startTime = chrono::steady_clock::now();
+	pool.run(options.connections, [&](int client) {
+		SyntheticRandom random(options.seed + client);
+		LoadConnection connection;
+		if (!connection.open(socketPath))
+		{
+			lostConnections++;
+			return;
+		}
+		long long requests = options.requests / options.connections + (client < options.requests % options.connections);
+		string line;
+		string answer;
+		for (long long i = 0; i < requests; i++)
+		{
+			int ledger = (int)random.between(0, options.ledgers - 1);
+			bool read = random.between(1, 100) <= options.readPercent;
+			line = "loadtest" + to_string(ledger + 1);
+			if (read)
+				line += " total\n";
+			else if (random.between(0, 1) == 0)
+				line += " deposit " + toDecimalString(random.between(-5000, 20000)) + "\n";
+			else
+				line += " add Load" + to_string(random.between(1, LOAD_LEDGER_CATEGORIES)) + " "
+					+ toDecimalString(random.between(-5000, 20000)) + "\n";
+			auto sentTime = chrono::steady_clock::now();
+			if (!connection.request(line, answer))
+			{
+				lostConnections++;
+				return;
+			}
+			long long nanoseconds = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - sentTime).count();
+			(read ? readTimes : writeTimes)[client].push_back(nanoseconds);
+			if (answer.compare(0, 2, "OK") != 0)
+				errors++;
+		}
+	});
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	vector<long long> reads;
+	vector<long long> writes;
+	for (int client = 0; client < options.connections; client++)
+	{
+		reads.insert(reads.end(), readTimes[client].begin(), readTimes[client].end());
+		writes.insert(writes.end(), writeTimes[client].begin(), writeTimes[client].end());
+	}
+	cout << fixed << setprecision(1);
+	cout << "Sent " << reads.size() + writes.size() << " requests over " << options.connections << " connections to "
+		<< options.ledgers << " ledgers in " << setprecision(3) << seconds << " s, " << setprecision(0)
+		<< (reads.size() + writes.size()) / max(seconds, 1e-9) << " requests/s\n" << setprecision(1);
+	cout << "  " << left << setw(8) << "" << right << setw(12) << "Requests" << setw(12) << "p50 us" << setw(12)
+		<< "p99 us" << setw(12) << "p99.9 us" << "\n";
+	outputLatencies("Reads", reads);
+	outputLatencies("Writes", writes);
+	cout << "  Errors: " << errors << "\n";
+	if (lostConnections > 0)
+	{
+		cout << "Error: " << lostConnections << " connections were lost.\n";
+		return 1;
+	}
+	return 0;
+#endif
+}
@@ -0,0 +1,218 @@
+//Name:			Synthetic Budgets
+//Description:	Makes up budgets and batch commands from a seed, for generate mode and the benchmarks
+
+#include "Budget.h"
+
+const int SYNTHETIC_MAX_DEPTH = 4; //The deepest a synthetic category can be below main
+
+//This function gives every group of categories random percentages that add up to exactly 100%
+//Parameters:	CategoryStore& categories - The store of budget categories
+//				SyntheticRandom& random - The random numbers to use
+void balanceSyntheticPercentages(CategoryStore& categories, SyntheticRandom& random) {
+	vector<long long> percentLeft(categories.size(), ONE_HUNDRED_PERCENT);
+	vector<int> childrenLeft(categories.size());
+	for (int i = 0; i < categories.size(); i++)
+		childrenLeft[i] = categories.getChildCount(i);
+	for (int i = 1; i < categories.size(); i++)
+	{
+		if (!categories.isLive(i))
+			continue;
+		int parent = categories.getParentIndex(i);
+		//Each category takes up to twice an even share of what is left, and the last one takes the rest
+		long long percent = percentLeft[parent];
+		if (--childrenLeft[parent] > 0)
+			percent = random.between(0, min(percent, 2 * percent / (childrenLeft[parent] + 1)));
+		percentLeft[parent] -= percent;
+		categories.setPercentOfBudget(i, (BasisPoints)percent);
+	}
+	updateMainPercentage(categories);
+}
+
+//This function fills a store with a synthetic budget
+//The categories are made in tree order, each under main or under a category on the path to the one before it,
+//so every category is added to the end of the store
+//Parameters:	CategoryStore& categories - The store to fill, which is cleared first
+//				const SyntheticOptions& options - The number of categories and how many are nested
+//				SyntheticRandom& random - The random numbers to use
+void generateSyntheticBudget(CategoryStore& categories, const SyntheticOptions& options,
+	SyntheticRandom& random) {
+	categories.clear();
+	categories.reserve(options.categoryCount + 1);
+	categories.add("main", 0, ONE_HUNDRED_PERCENT);
+	vector<int> path = { 1 }; //IDs from main down to the last category made
+	for (int i = 0; i < options.categoryCount; i++)
+	{
+		size_t depth = 1;
+		if (path.size() > 1 && random.between(1, 100) <= options.nestedPercent)
+			depth = (size_t)random.between(2, min((long long)path.size(), (long long)SYNTHETIC_MAX_DEPTH));
+		path.resize(depth);
+		int id = createCategory("Category" + to_string(i + 1), random.between(0, 1000000), categories, 0,
+			path.back());
+		path.push_back(id);
+	}
+	balanceSyntheticPercentages(categories, random);
+}
+
+//This function picks a random category other than main
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				SyntheticRandom& random - The random numbers to use
+//Returns:		The ID of the category, or 0 if only main is left
+int pickSyntheticCategory(const CategoryStore& categories, SyntheticRandom& random) {
+	if (categories.liveCount() <= 1)
+		return 0;
+	while (true)
+	{
+		int index = (int)random.between(1, categories.size() - 1);
+		if (categories.isLive(index))
+			return categories.getIDNumber(index);
+	}
+}
+
+//This function writes a file of synthetic batch commands for a budget
+//The commands are applied to the store as they are written, so every command refers to a category that exists
+//Parameters:	ostream& out - Where to write the commands
+//				CategoryStore& categories - The budget the commands are for, which is changed by them
+//				const SyntheticOptions& options - The number of commands and the mix of them
+//				SyntheticRandom& random - The random numbers to use
+void writeSyntheticCommands(ostream& out, CategoryStore& categories, const SyntheticOptions& options,
+	SyntheticRandom& random) {
+	ReportWriter writer(out);
+	int totalWeight = options.depositWeight + options.addWeight + options.createWeight + options.removeWeight
+		+ options.percentWeight;
+	vector<int> group;
+	for (long long i = 0; i < options.operationCount && totalWeight > 0; i++)
+	{
+		int roll = (int)random.between(1, totalWeight);
+		int id = pickSyntheticCategory(categories, random);
+		Money amount = random.between(-5000, 20000);
+		if ((roll -= options.depositWeight) <= 0)
+		{
+			writer.text("deposit,");
+			writer.hundredths(amount);
+			modifyBalance(amount, categories);
+		}
+		else if ((roll -= options.addWeight) <= 0 && id != 0)
+		{
+			writer.text("add,");
+			writer.number(id);
+			writer.character(',');
+			writer.hundredths(amount);
+			applyToCategory(id, amount, categories);
+		}
+		else if ((roll -= options.createWeight) <= 0 || id == 0)
+		{
+			int parentID = id != 0 && random.between(1, 100) <= options.nestedPercent ? id : 1;
+			string name = "New" + to_string(i + 1);
+			writer.text("create,");
+			writer.text(name);
+			writer.text(",0");
+			if (parentID != 1)
+			{
+				writer.character(',');
+				writer.number(parentID);
+			}
+			createCategory(name, 0, categories, 0, parentID);
+		}
+		else if ((roll -= options.removeWeight) <= 0)
+		{
+			writer.text("remove,");
+			writer.number(id);
+			deleteCategory(id, categories);
+		}
+		else
+		{
+			//Share 100% out again in the picked category's group, and in any group a create or remove has left
+			//unbalanced, as batch mode only accepts percentages that leave every group at 100%
+			int picked = categories.getParentIndex(categories.indexOf(id));
+			writer.text("percent");
+			for (int parent = 0; parent < categories.size(); parent++)
+			{
+				if (!categories.isLive(parent) || categories.getChildCount(parent) == 0 || (parent != picked
+					&& categories.getChildPercentTotal(parent) == ONE_HUNDRED_PERCENT))
+					continue;
+				group.clear();
+				int end = categories.branchEnd(parent);
+				for (int child = parent + 1; child < end; child = categories.branchEnd(child))
+					if (categories.isLive(child))
+						group.push_back(child);
+				long long percentLeft = ONE_HUNDRED_PERCENT;
+				for (size_t member = 0; member < group.size(); member++)
+				{
+					long long percent = member + 1 == group.size() ? percentLeft : random.between(0, percentLeft);
+					percentLeft -= percent;
+					writer.character(',');
+					writer.number(categories.getIDNumber(group[member]));
+					writer.character(',');
+					writer.hundredths(percent);
+					categories.setPercentOfBudget(group[member], (BasisPoints)percent);
+				}
+			}
+			updateMainPercentage(categories);
+		}
+		writer.character('\n');
+	}
+}
+
+//This function runs generate mode, writing a synthetic budget and optionally a file of commands for it
+//Parameters:	const string& budgetName - The budget file to write
+//				const string& commandsName - The commands file to write, or empty for none
+//				const SyntheticOptions& options - The shape of the budget and commands
+//				bool snapshot - true to save the budget as a binary snapshot
+//Returns:		0 if everything was written, otherwise 1
+int runGenerate(const string& budgetName, const string& commandsName, const SyntheticOptions& options,
+	bool snapshot) {
+	SyntheticRandom random(options.seed);
+	CategoryStore categories;
+	generateSyntheticBudget(categories, options, random);
+	if (!saveBudgetFile(budgetName, categories, snapshot))
+		return 1;
+	cout << "Wrote " << budgetName << " with " << categories.liveCount() - 1 << " categories\n";
+	if (commandsName.empty())
+		return 0;
+
+	fstream file(commandsName, ios::out | ios::binary | ios::trunc);
+	writeSyntheticCommands(file, categories, options, random);
+	if (!file)
+	{
+		cout << "Error: Could not write " << commandsName << ".\n";
+		return 1;
+	}
+	cout << "Wrote " << commandsName << " with " << options.operationCount << " commands\n";
+	return 0;
+}
+
+//This function reads one of the synthetic options from the command line, used by generate and benchmark mode
+//The synthetic options are --categories N, --nested <percent>, --operations N, --seed N and
+//--mix <deposit>,<add>,<create>,<remove>,<percent>
+//Parameters:	int argc, char* argv[] - The command line
+//				int& i - The argument to read, moved on to the option's value if it is a synthetic option
+//				SyntheticOptions& options - Receives the option
+//Returns:		1 if the option was read, 0 if it is not a synthetic option, or -1 if its value is missing or
+//				wrong, after writing out the error
+int readSyntheticOption(int argc, char* argv[], int& i, SyntheticOptions& options) {
+	string option = argv[i];
+	if (option != "--categories" && option != "--nested" && option != "--operations" && option != "--seed"
+		&& option != "--mix")
+		return 0;
+	if (i + 1 >= argc)
+	{
+		cout << "Error: " << option << " is missing its value.\n";
+		return -1;
+	}
+	const char* value = argv[++i];
+	if (option == "--categories")
+		options.categoryCount = max(1, atoi(value));
+	else if (option == "--nested")
+		options.nestedPercent = atoi(value);
+	else if (option == "--operations")
+		options.operationCount = atoll(value);
+	else if (option == "--seed")
+		options.seed = strtoull(value, nullptr, 10);
+	else if (sscanf(value, "%d,%d,%d,%d,%d", &options.depositWeight, &options.addWeight, &options.createWeight,
+		&options.removeWeight, &options.percentWeight) != 5)
+	{
+		cout << "Error: --mix expects five weights separated by commas.\n";
+		return -1;
+	}
+	return 1;
+}
@@ -0,0 +1,114 @@
+//Name:			Budget Tests
+//Description:	BudgetTests checks modifyBalance's splits on random budgets
+
+#include "Budget.h"
+
+//Test mode deposits random amounts into random budgets and checks every split against exact arithmetic. Half
+//the budgets are flat and half are nested, some with removed categories, and some nested groups add up to less
+//than 100% so their parent keeps the rest. Each deposit must add exactly its amount, every share must be within
+//a cent of its exact part of what its group was handed, and main must still hold the total of its branches.
+const int TEST_SPLIT_BUDGETS = 200; //Random budgets made, each with its own seed
+const int TEST_SPLIT_DEPOSITS = 50; //Deposits and withdrawals checked on each budget
+const int TEST_MAX_FAILURES = 10; //Failures written out before the rest are only counted
+
+//This function adds up the balance of every branch from the balances alone, without the running totals
+//Parameters:	const CategoryStore& categories - The store of budget categories
+//				vector<Money>& branchTotals - Set to each category's balance plus everything below it
+void static recountBranchTotals(const CategoryStore& categories, vector<Money>& branchTotals) {
+	branchTotals.assign(categories.size(), 0);
+	//The store is in tree order, so going backwards every category is finished before its parent is reached
+	for (int i = categories.size() - 1; i >= 1; i--)
+	{
+		if (!categories.isLive(i))
+			continue;
+		branchTotals[i] += categories.getBalance(i);
+		branchTotals[categories.getParentIndex(i)] += branchTotals[i];
+	}
+}
+
+//This function runs test mode, checking modifyBalance's splits on random budgets
+//Parameters:	uint64_t seed - The seed of the first budget, each budget after it uses the next one
+//Returns:		0 if every split was exact, otherwise 1
+int static runSplitTests(uint64_t seed) {
+	long long deposits = 0;
+	long long failures = 0;
+	auto fail = [&](uint64_t budgetSeed, Money amount, const string& message) {
+		if (++failures <= TEST_MAX_FAILURES)
+			cout << "Error: Budget seed " << budgetSeed << ", deposit " << toDecimalString(amount) << ": "
+				<< message << "\n";
+	};
+	vector<Money> before;
+	vector<Money> after;
+	for (int budget = 0; budget < TEST_SPLIT_BUDGETS; budget++)
+	{
+		uint64_t budgetSeed = seed + budget;
+		SyntheticRandom random(budgetSeed);
+		SyntheticOptions options;
+		options.categoryCount = (int)random.between(1, 500);
+		options.nestedPercent = budget % 2 == 0 ? 0 : (int)random.between(10, 90);
+		CategoryStore categories;
+		generateSyntheticBudget(categories, options, random);
+		if (random.between(0, 2) == 0)
+		{
+			for (int i = options.categoryCount / 10; i > 0; i--)
+				deleteCategory(pickSyntheticCategory(categories, random), categories);
+			balanceSyntheticPercentages(categories, random);
+		}
+		for (int i = 1; i < categories.size(); i++)
+			if (categories.isLive(i) && categories.getDepth(i) >= 2 && random.between(0, 4) == 0)
+				categories.setPercentOfBudget(i, (BasisPoints)random.between(0, categories.getPercentOfBudget(i)));
+
+		for (int deposit = 0; deposit < TEST_SPLIT_DEPOSITS; deposit++)
+		{
+			//Small amounts leave most categories with less than a cent, large ones test the 64-bit arithmetic
+			long long limit = deposit % 3 == 0 ? 100 : deposit % 3 == 1 ? 10000000 : 100000000000LL;
+			Money amount = random.between(-limit, limit);
+			recountBranchTotals(categories, before);
+			modifyBalance(amount, categories);
+			recountBranchTotals(categories, after);
+			deposits++;
+
+			if (categories.liveCount() <= 1)
+				continue; //Main keeps the deposit itself, there is nothing to split
+			if (after[0] - before[0] != amount)
+				fail(budgetSeed, amount, "the shares add up to " + toDecimalString(after[0] - before[0]));
+			if (categories.getBalance(0) != after[0])
+				fail(budgetSeed, amount, "main holds " + toDecimalString(categories.getBalance(0))
+					+ " but its branches add up to " + toDecimalString(after[0]));
+			//What a group is handed is the change in its parent's branch, main is handed the whole amount
+			for (int i = 1; i < categories.size(); i++)
+			{
+				if (!categories.isLive(i))
+					continue;
+				int parent = categories.getParentIndex(i);
+				Money handed = parent == 0 ? amount : after[parent] - before[parent];
+				long long error = (after[i] - before[i]) * ONE_HUNDRED_PERCENT - handed * categories.getPercentOfBudget(i);
+				if (error <= -ONE_HUNDRED_PERCENT || error >= ONE_HUNDRED_PERCENT)
+					fail(budgetSeed, amount, "category " + to_string(categories.getIDNumber(i)) + " was given "
+						+ toDecimalString(after[i] - before[i]) + " of " + toDecimalString(handed) + " at "
+						+ to_string(categories.getPercentOfBudget(i)) + " basis points");
+				if (categories.getBranchTotal(i) != after[i])
+					fail(budgetSeed, amount, "the running total of category " + to_string(categories.getIDNumber(i))
+						+ " does not match its branch");
+			}
+		}
+	}
+
+	if (failures > 0)
+	{
+		cout << failures << " of the checks failed.\n";
+		return 1;
+	}
+	cout << "Checked " << deposits << " deposits over " << TEST_SPLIT_BUDGETS << " budgets, every split was exact\n";
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	//BudgetTests [--seed N] checks modifyBalance's splits on random budgets
+	if ((argc != 1 && argc != 3) || (argc == 3 && string(argv[1]) != "--seed"))
+	{
+		cout << "Error: Expected BudgetTests [--seed N].\n";
+		return 1;
+	}
+	return runSplitTests(argc == 3 ? strtoull(argv[2], nullptr, 10) : 1);
+}